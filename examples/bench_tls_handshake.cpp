@@ -0,0 +1,105 @@
+#include <chrono>
+#include <cstdlib>
+#include <utility>
+
+#include <openssl/bio.h>
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "Client.h"
+#include "TlsContext.h"
+#include "TlsSessionCache.h"
+
+DEFINE_string(cert, "", "Certificate PEM");
+DEFINE_string(key, "", "Key PEM");
+DEFINE_string(ca, "", "Certificate Authority");
+DEFINE_string(ipv4, "127.0.0.1", "IPv4 address of server");
+DEFINE_int32(port, -1, "Port");
+DEFINE_int32(iterations, 50, "Connections per run");
+DEFINE_string(session_cache_file, "", "Optional on-disk TLS session cache");
+
+using organicdump::Client;
+using organicdump::TlsContext;
+using organicdump::TlsSessionCache;
+
+namespace
+{
+
+// Connects |FLAGS_iterations| times and returns the mean time per connect
+// in microseconds, or a negative value on failure.
+double RunConnects(TlsContext *tls_context, TlsSessionCache *session_cache)
+{
+  std::chrono::microseconds total{0};
+  for (int i = 0; i < FLAGS_iterations; ++i)
+  {
+    auto start = std::chrono::steady_clock::now();
+    {
+      Client client;
+      if (!Client::Create(tls_context, session_cache, &client))
+      {
+        LOG(ERROR) << "Failed to connect on iteration " << i;
+        return -1.0;
+      }
+    }
+    total += std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start);
+  }
+
+  return static_cast<double>(total.count()) / FLAGS_iterations;
+}
+
+} // namespace
+
+// Measures connect latency with and without TLS session resumption. Any TLS
+// server that accepts the client certificate works as a stand-in, e.g. this
+// single command:
+//   openssl s_server -accept 4433 -cert server.pem -key server.key
+//       -CAfile ca.pem -Verify 1
+int main(int argc, char **argv)
+{
+  google::ParseCommandLineFlags(&argc, &argv, false);
+  FLAGS_logtostderr = 1;
+  google::InitGoogleLogging(argv[0]);
+
+  SSL_library_init();
+  OpenSSL_add_all_algorithms();
+  SSL_load_error_strings();
+  ERR_load_BIO_strings();
+
+  TlsContext tls_context;
+  if (!TlsContext::Create(
+        FLAGS_ipv4,
+        FLAGS_port,
+        FLAGS_cert,
+        FLAGS_key,
+        FLAGS_ca,
+        &tls_context))
+  {
+    LOG(ERROR) << "Failed to load TLS credentials";
+    return EXIT_FAILURE;
+  }
+
+  double full_us = RunConnects(&tls_context, nullptr);
+  if (full_us < 0)
+  {
+    return EXIT_FAILURE;
+  }
+
+  TlsSessionCache session_cache{FLAGS_session_cache_file};
+  double resumed_us = RunConnects(&tls_context, &session_cache);
+  if (resumed_us < 0)
+  {
+    return EXIT_FAILURE;
+  }
+
+  LOG(INFO) << "Full handshake connect: " << full_us << " us";
+  LOG(INFO) << "Session cache connect: " << resumed_us << " us";
+  LOG(INFO) << "Resumption hit rate: " << session_cache.GetHitRate()
+            << " (" << session_cache.GetResumedHandshakeCount() << "/"
+            << session_cache.GetHandshakeCount() << ")";
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,27 @@
+#ifndef ORGANICDUMP_CLIENT_ADAPTIVESAMPLINGPOLICY_H
+#define ORGANICDUMP_CLIENT_ADAPTIVESAMPLINGPOLICY_H
+
+#include <chrono>
+
+namespace organicdump
+{
+
+/**
+ * Bounds the per-channel sampling period. Each channel's period is chosen so
+ * that, at the rate the reading last changed, about |target_change| passes
+ * between samples. A fast change cuts the period at once; a flat reading
+ * lets it grow, at most doubling per sample. With equal bounds every channel
+ * samples at a fixed period.
+ */
+struct AdaptiveSamplingPolicy
+{
+  std::chrono::seconds min_period;
+  std::chrono::seconds max_period;
+
+  // Change in the filtered reading worth one sample.
+  double target_change;
+};
+
+} // namespace organicdump
+
+#endif // ORGANICDUMP_CLIENT_ADAPTIVESAMPLINGPOLICY_H
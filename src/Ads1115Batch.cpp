@@ -0,0 +1,304 @@
+#include "Ads1115Batch.h"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <thread>
+#include <unordered_map>
+
+#include <glog/logging.h>
+
+#include "Ads1115Registers.h"
+
+namespace organicdump
+{
+
+Ads1115Batch::Ads1115Batch(
+    I2cBus *bus,
+    std::chrono::microseconds conversion_time,
+    Ads1115Policy policy)
+  : bus_{bus},
+    conversion_time_{conversion_time},
+    policy_{policy},
+    conversion_pointer_{ads1115::CONVERSION_REGISTER}
+{
+  assert(bus_);
+}
+
+bool Ads1115Batch::Convert(std::vector<Ads1115Conversion> *conversions)
+{
+  assert(conversions);
+
+  // The n-th conversion for each device goes into round n.
+  for (std::vector<size_t> &round : rounds_)
+  {
+    round.clear();
+  }
+
+  size_t round_count = 0;
+  std::unordered_map<uint8_t, size_t> device_rounds;
+  for (size_t i = 0; i < conversions->size(); ++i)
+  {
+    size_t round = device_rounds[conversions->at(i).address]++;
+    if (round >= rounds_.size())
+    {
+      rounds_.resize(round + 1);
+    }
+    rounds_[round].push_back(i);
+    round_count = std::max(round_count, round + 1);
+  }
+
+  started_.assign(conversions->size(), false);
+  isolated_addresses_.clear();
+  for (size_t round = 0; round <= round_count; ++round)
+  {
+    const std::vector<size_t> &finishing =
+        round > 0 ? rounds_[round - 1] : no_conversions_;
+    const std::vector<size_t> &starting =
+        round < round_count ? rounds_[round] : no_conversions_;
+
+    // Config writes and result reads fill the same slots whichever path
+    // they take, so size them once per round.
+    config_writes_.resize(starting.size());
+    result_reads_.resize(finishing.size());
+
+    // Devices that already NACKed go first, one at a time.
+    TransferEach(finishing, starting, true, conversions);
+
+    // Reads come before writes, so no device starts a conversion before
+    // every result has been read.
+    messages_.clear();
+    AddResultReads(*conversions, finishing);
+    AddConfigWrites(*conversions, starting);
+
+    if (messages_.empty() ||
+        bus_->Transfer(messages_.data(), messages_.size()))
+    {
+      StoreResults(finishing, conversions);
+      for (size_t index : starting)
+      {
+        started_[index] = started_[index] ||
+            !IsIsolated(conversions->at(index).address);
+      }
+    }
+    else
+    {
+      // A NACK from one device aborts the whole transaction, and the read
+      // buffers with it. Redo it one device at a time so the rest of the bus
+      // still reports.
+      DropRestartedResults(finishing, starting, conversions);
+      TransferEach(finishing, starting, false, conversions);
+    }
+
+    bool has_started = false;
+    for (size_t index : starting)
+    {
+      has_started = has_started || started_[index];
+    }
+    if (has_started && conversion_time_.count() > 0)
+    {
+      std::this_thread::sleep_for(conversion_time_);
+    }
+  }
+
+  bool all_valid = true;
+  for (const Ads1115Conversion &conversion : *conversions)
+  {
+    all_valid = all_valid && conversion.is_valid;
+  }
+  return all_valid;
+}
+
+void Ads1115Batch::AddConfigWrites(
+    const std::vector<Ads1115Conversion> &conversions,
+    const std::vector<size_t> &round)
+{
+  for (size_t i = 0; i < round.size(); ++i)
+  {
+    const Ads1115Conversion &conversion = conversions[round[i]];
+    if (IsIsolated(conversion.address))
+    {
+      continue;
+    }
+
+    FillConfigWrite(conversion, i);
+    messages_.push_back(
+        I2cMessage{
+            conversion.address,
+            false,
+            config_writes_[i].data(),
+            static_cast<uint16_t>(config_writes_[i].size())});
+  }
+}
+
+void Ads1115Batch::FillConfigWrite(
+    const Ads1115Conversion &conversion,
+    size_t slot)
+{
+  uint16_t config = ads1115::GetSingleShotConfig(conversion.channel, policy_);
+  config_writes_[slot] = {
+      ads1115::CONFIG_REGISTER,
+      static_cast<uint8_t>(config >> 8),
+      static_cast<uint8_t>(config & 0xff)};
+}
+
+void Ads1115Batch::AddResultReads(
+    const std::vector<Ads1115Conversion> &conversions,
+    const std::vector<size_t> &round)
+{
+  // Point at the conversion register, then read it after a repeated start.
+  for (size_t i = 0; i < round.size(); ++i)
+  {
+    const Ads1115Conversion &conversion = conversions[round[i]];
+    if (!started_[round[i]] || IsIsolated(conversion.address))
+    {
+      continue;
+    }
+
+    messages_.push_back(
+        I2cMessage{conversion.address, false, &conversion_pointer_, 1});
+    messages_.push_back(
+        I2cMessage{
+            conversion.address,
+            true,
+            result_reads_[i].data(),
+            static_cast<uint16_t>(result_reads_[i].size())});
+  }
+}
+
+void Ads1115Batch::StoreResults(
+    const std::vector<size_t> &round,
+    std::vector<Ads1115Conversion> *conversions) const
+{
+  assert(conversions);
+
+  for (size_t i = 0; i < round.size(); ++i)
+  {
+    Ads1115Conversion &conversion = conversions->at(round[i]);
+    if (IsIsolated(conversion.address))
+    {
+      continue;
+    }
+
+    conversion.is_valid = started_[round[i]];
+    conversion.value = conversion.is_valid ?
+        static_cast<uint16_t>((result_reads_[i][0] << 8) | result_reads_[i][1]) :
+        0;
+  }
+}
+
+void Ads1115Batch::TransferEach(
+    const std::vector<size_t> &finishing,
+    const std::vector<size_t> &starting,
+    bool is_isolated,
+    std::vector<Ads1115Conversion> *conversions)
+{
+  assert(conversions);
+
+  // Only devices isolated before this call are handled here. One that fails
+  // below is isolated from the next round on.
+  size_t isolated_count = isolated_addresses_.size();
+  auto was_isolated = [this, isolated_count](uint8_t address)
+  {
+    return std::find(
+        isolated_addresses_.begin(),
+        isolated_addresses_.begin() + isolated_count,
+        address) != isolated_addresses_.begin() + isolated_count;
+  };
+
+  for (size_t i = 0; i < finishing.size(); ++i)
+  {
+    Ads1115Conversion &conversion = conversions->at(finishing[i]);
+    if (was_isolated(conversion.address) != is_isolated)
+    {
+      continue;
+    }
+
+    conversion.is_valid = false;
+    conversion.value = 0;
+    if (!started_[finishing[i]])
+    {
+      continue;
+    }
+
+    I2cMessage read[] = {
+        I2cMessage{conversion.address, false, &conversion_pointer_, 1},
+        I2cMessage{
+            conversion.address,
+            true,
+            result_reads_[i].data(),
+            static_cast<uint16_t>(result_reads_[i].size())}};
+    if (bus_->Transfer(read, 2))
+    {
+      conversion.is_valid = true;
+      conversion.value = static_cast<uint16_t>(
+          (result_reads_[i][0] << 8) | result_reads_[i][1]);
+    }
+    else if (!IsIsolated(conversion.address))
+    {
+      isolated_addresses_.push_back(conversion.address);
+    }
+  }
+
+  for (size_t i = 0; i < starting.size(); ++i)
+  {
+    const Ads1115Conversion &conversion = conversions->at(starting[i]);
+    if (was_isolated(conversion.address) != is_isolated)
+    {
+      continue;
+    }
+
+    FillConfigWrite(conversion, i);
+    I2cMessage write{
+        conversion.address,
+        false,
+        config_writes_[i].data(),
+        static_cast<uint16_t>(config_writes_[i].size())};
+    started_[starting[i]] = bus_->Transfer(&write, 1);
+    if (!started_[starting[i]] && !IsIsolated(conversion.address))
+    {
+      isolated_addresses_.push_back(conversion.address);
+    }
+  }
+}
+
+void Ads1115Batch::DropRestartedResults(
+    const std::vector<size_t> &finishing,
+    const std::vector<size_t> &starting,
+    std::vector<Ads1115Conversion> *conversions)
+{
+  assert(conversions);
+
+  // The failed transaction may have got as far as a device's config write,
+  // starting its next conversion. Once that finishes it replaces the result
+  // still to be read back, so a second read could return the next
+  // conversion under this one's channel. Only devices that weren't written
+  // can be read again.
+  for (size_t index : finishing)
+  {
+    Ads1115Conversion &conversion = conversions->at(index);
+    if (!started_[index] || IsIsolated(conversion.address))
+    {
+      continue;
+    }
+
+    for (size_t next : starting)
+    {
+      if (conversions->at(next).address == conversion.address)
+      {
+        started_[index] = false;
+        break;
+      }
+    }
+  }
+}
+
+bool Ads1115Batch::IsIsolated(uint8_t address) const
+{
+  return std::find(
+      isolated_addresses_.begin(),
+      isolated_addresses_.end(),
+      address) != isolated_addresses_.end();
+}
+
+} // namespace organicdump
@@ -0,0 +1,104 @@
+#ifndef ORGANICDUMP_CLIENT_ADS1115BATCH_H
+#define ORGANICDUMP_CLIENT_ADS1115BATCH_H
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "I2c/Devices/Ads1115AnalogToDigitalConverter/Ads1115Channel.h"
+
+#include "Ads1115Policy.h"
+#include "I2cBus.h"
+
+namespace organicdump
+{
+
+struct Ads1115Conversion
+{
+  uint8_t address;
+  I2c::Ads1115Channel channel;
+  uint16_t value;
+  bool is_valid;
+};
+
+/**
+ * Runs single-shot conversions on any number of ADS1115s sharing a bus with
+ * a few combined I2C transactions. Conversions are grouped into rounds with
+ * at most one per device, so every device converts in parallel. One
+ * transaction reads the results of a round and starts the next, so a sweep
+ * of R rounds takes R + 1 transactions however many devices share the bus.
+ *
+ * If a device NACKs, that transaction is redone one device at a time so the
+ * others still report, and for the rest of the sweep the device gets its own
+ * transactions. A NACK can abort a transaction after some devices have
+ * already started their next conversion, which may overwrite the result
+ * about to be read back, so those devices lose that result.
+ */
+class Ads1115Batch
+{
+public:
+  /**
+   * Converts with the gain and data rate of |policy|, waiting
+   * |conversion_time| after starting a round before reading it back.
+   */
+  Ads1115Batch(
+      I2cBus *bus,
+      std::chrono::microseconds conversion_time,
+      Ads1115Policy policy);
+
+  /**
+   * Converts every entry of |conversions|, setting its value and is_valid.
+   * Returns false if any conversion failed.
+   */
+  bool Convert(std::vector<Ads1115Conversion> *conversions);
+
+private:
+  void AddConfigWrites(
+      const std::vector<Ads1115Conversion> &conversions,
+      const std::vector<size_t> &round);
+  void FillConfigWrite(const Ads1115Conversion &conversion, size_t slot);
+  void AddResultReads(
+      const std::vector<Ads1115Conversion> &conversions,
+      const std::vector<size_t> &round);
+  void StoreResults(
+      const std::vector<size_t> &round,
+      std::vector<Ads1115Conversion> *conversions) const;
+  void TransferEach(
+      const std::vector<size_t> &finishing,
+      const std::vector<size_t> &starting,
+      bool is_isolated,
+      std::vector<Ads1115Conversion> *conversions);
+  void DropRestartedResults(
+      const std::vector<size_t> &finishing,
+      const std::vector<size_t> &starting,
+      std::vector<Ads1115Conversion> *conversions);
+  bool IsIsolated(uint8_t address) const;
+
+private:
+  Ads1115Batch(const Ads1115Batch &other) = delete;
+  Ads1115Batch &operator=(const Ads1115Batch &other) = delete;
+
+private:
+  I2cBus *bus_;
+  std::chrono::microseconds conversion_time_;
+  Ads1115Policy policy_;
+  // Scratch reused across sweeps. Buffers are sized before messages point
+  // into them.
+  std::vector<std::vector<size_t>> rounds_;
+  const std::vector<size_t> no_conversions_;
+  // Whether each conversion's config write went through.
+  std::vector<bool> started_;
+  // Devices that NACKed during this sweep. They are left out of combined
+  // transactions so they can't abort them again.
+  std::vector<uint8_t> isolated_addresses_;
+  std::vector<I2cMessage> messages_;
+  std::vector<std::array<uint8_t, 3>> config_writes_;
+  std::vector<std::array<uint8_t, 2>> result_reads_;
+  uint8_t conversion_pointer_;
+};
+
+} // namespace organicdump
+
+#endif // ORGANICDUMP_CLIENT_ADS1115BATCH_H
@@ -0,0 +1,27 @@
+#ifndef ORGANICDUMP_CLIENT_ADS1115POLICY_H
+#define ORGANICDUMP_CLIENT_ADS1115POLICY_H
+
+#include <cstdint>
+
+namespace organicdump
+{
+
+/**
+ * How each ADS1115 is set up for a single-shot conversion. Readings are raw
+ * ADC codes, so the full-scale range sets what a code means in volts: the
+ * same probe voltage reads half as many codes at twice the range. The data
+ * rate sets how long a conversion takes, and how much noise it averages out.
+ */
+struct Ads1115Policy
+{
+  // Full-scale range of the gain amplifier in millivolts: 6144, 4096, 2048,
+  // 1024, 512 or 256.
+  uint32_t full_scale_mv;
+
+  // Conversions per second: 8, 16, 32, 64, 128, 250, 475 or 860.
+  uint32_t data_rate_sps;
+};
+
+} // namespace organicdump
+
+#endif // ORGANICDUMP_CLIENT_ADS1115POLICY_H
@@ -0,0 +1,122 @@
+#ifndef ORGANICDUMP_CLIENT_ADS1115REGISTERS_H
+#define ORGANICDUMP_CLIENT_ADS1115REGISTERS_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+#include "I2c/Devices/Ads1115AnalogToDigitalConverter/Ads1115Channel.h"
+
+#include "Ads1115Policy.h"
+
+namespace organicdump
+{
+namespace ads1115
+{
+
+// Register pointers.
+constexpr uint8_t CONVERSION_REGISTER = 0x00;
+constexpr uint8_t CONFIG_REGISTER = 0x01;
+
+// Config register fields.
+constexpr uint16_t CONFIG_OS_START = 1u << 15;
+constexpr uint16_t CONFIG_MUX_SHIFT = 12;
+constexpr uint16_t CONFIG_MUX_MASK = 0x7u << CONFIG_MUX_SHIFT;
+// Single-ended AINx against GND is MUX 0b100 + x.
+constexpr uint16_t CONFIG_MUX_SINGLE_ENDED = 0x4;
+constexpr uint16_t CONFIG_PGA_SHIFT = 9;
+constexpr uint16_t CONFIG_MODE_SINGLE_SHOT = 1u << 8;
+constexpr uint16_t CONFIG_DR_SHIFT = 5;
+constexpr uint16_t CONFIG_COMP_DISABLE = 0x3;
+
+// Power-on settings: +/-2.048 V full scale at 128 SPS.
+constexpr uint32_t DEFAULT_FULL_SCALE_MV = 2048;
+constexpr uint32_t DEFAULT_DATA_RATE_SPS = 128;
+constexpr uint16_t DEFAULT_PGA_FIELD = 0x2;
+constexpr uint16_t DEFAULT_DR_FIELD = 0x4;
+
+// PGA and DR settings, indexed by their field values.
+constexpr uint32_t FULL_SCALE_MV[] = {6144, 4096, 2048, 1024, 512, 256};
+constexpr uint32_t DATA_RATE_SPS[] = {8, 16, 32, 64, 128, 250, 475, 860};
+
+template <size_t N>
+inline bool FindField(
+    const uint32_t (&settings)[N],
+    uint32_t setting,
+    uint16_t *out_field)
+{
+  for (uint16_t i = 0; i < N; ++i)
+  {
+    if (settings[i] == setting)
+    {
+      *out_field = i;
+      return true;
+    }
+  }
+  return false;
+}
+
+inline bool IsValidFullScale(uint32_t full_scale_mv)
+{
+  uint16_t field;
+  return FindField(FULL_SCALE_MV, full_scale_mv, &field);
+}
+
+inline bool IsValidDataRate(uint32_t data_rate_sps)
+{
+  uint16_t field;
+  return FindField(DATA_RATE_SPS, data_rate_sps, &field);
+}
+
+/**
+ * How long to wait for one conversion at |data_rate_sps|. The data rate is
+ * only accurate to 10%, so this allows 10% more than the nominal period.
+ */
+inline std::chrono::microseconds GetConversionTime(uint32_t data_rate_sps)
+{
+  return std::chrono::microseconds{
+      (11 * 1000000 + 10 * data_rate_sps - 1) / (10 * data_rate_sps)};
+}
+
+inline uint16_t GetMux(I2c::Ads1115Channel channel)
+{
+  switch (channel)
+  {
+    case I2c::Ads1115Channel::CHANNEL_0:
+      return CONFIG_MUX_SINGLE_ENDED + 0;
+    case I2c::Ads1115Channel::CHANNEL_1:
+      return CONFIG_MUX_SINGLE_ENDED + 1;
+    case I2c::Ads1115Channel::CHANNEL_2:
+      return CONFIG_MUX_SINGLE_ENDED + 2;
+    case I2c::Ads1115Channel::CHANNEL_3:
+    default:
+      return CONFIG_MUX_SINGLE_ENDED + 3;
+  }
+}
+
+/**
+ * Config word that starts one single-shot conversion of |channel| with the
+ * gain and data rate of |policy|.
+ */
+inline uint16_t GetSingleShotConfig(
+    I2c::Ads1115Channel channel,
+    const Ads1115Policy &policy)
+{
+  // Settings the ADS1115 doesn't have fall back to the power-on ones.
+  uint16_t pga = DEFAULT_PGA_FIELD;
+  FindField(FULL_SCALE_MV, policy.full_scale_mv, &pga);
+  uint16_t data_rate = DEFAULT_DR_FIELD;
+  FindField(DATA_RATE_SPS, policy.data_rate_sps, &data_rate);
+
+  return CONFIG_OS_START |
+         static_cast<uint16_t>(GetMux(channel) << CONFIG_MUX_SHIFT) |
+         static_cast<uint16_t>(pga << CONFIG_PGA_SHIFT) |
+         CONFIG_MODE_SINGLE_SHOT |
+         static_cast<uint16_t>(data_rate << CONFIG_DR_SHIFT) |
+         CONFIG_COMP_DISABLE;
+}
+
+} // namespace ads1115
+} // namespace organicdump
+
+#endif // ORGANICDUMP_CLIENT_ADS1115REGISTERS_H
@@ -0,0 +1,471 @@
+#include "BacklogDrainer.h"
+
+#include <sys/epoll.h>
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <random>
+#include <utility>
+
+#include <glog/logging.h>
+
+namespace
+{
+constexpr uint32_t SERVER_EVENTS = EPOLLIN | EPOLLRDHUP;
+
+// Drain sessions are topped up, and failed ones reconnected, on this tick.
+constexpr std::chrono::milliseconds DRAIN_TICK_PERIOD{100};
+} // namespace
+
+namespace organicdump
+{
+
+BacklogDrainer::BacklogDrainer(
+    EventLoop *event_loop,
+    TlsContext *tls_context,
+    TlsSessionCache *session_cache,
+    const MeasurementSpool *spool,
+    DrainPolicy policy,
+    size_t pipeline_window,
+    ReconnectPolicy reconnect_policy,
+    CompletionCallback on_completed)
+  : event_loop_{event_loop},
+    tls_context_{tls_context},
+    session_cache_{session_cache},
+    spool_{spool},
+    policy_{policy},
+    pipeline_window_{pipeline_window},
+    on_completed_{std::move(on_completed)},
+    tick_timer_{-1},
+    streams_(policy.stream_count),
+    is_active_{false},
+    next_seq_{0},
+    end_seq_{0},
+    tokens_{0},
+    drained_count_{0}
+{
+  std::random_device seed;
+  for (Stream &stream : streams_)
+  {
+    stream.backoff = ReconnectBackoff{reconnect_policy, seed()};
+  }
+}
+
+BacklogDrainer::~BacklogDrainer()
+{
+  Stop();
+  if (tick_timer_ >= 0)
+  {
+    event_loop_->RemoveTimer(tick_timer_);
+  }
+}
+
+bool BacklogDrainer::Start(uint64_t begin_seq, uint64_t end_seq)
+{
+  assert(!is_active_);
+  assert(begin_seq <= end_seq);
+
+  if (streams_.empty())
+  {
+    return false;
+  }
+
+  if (tick_timer_ < 0 &&
+      !event_loop_->AddTimer([this]() { Pump(); }, &tick_timer_))
+  {
+    LOG(ERROR) << "Failed to create backlog drain timer";
+    return false;
+  }
+
+  if (!event_loop_->ArmTimer(tick_timer_, DRAIN_TICK_PERIOD, DRAIN_TICK_PERIOD))
+  {
+    LOG(ERROR) << "Failed to arm backlog drain timer";
+    return false;
+  }
+
+  is_active_ = true;
+  next_seq_ = begin_seq;
+  end_seq_ = end_seq;
+  requeued_ranges_.clear();
+  tokens_ = 0;
+  start_time_ = std::chrono::steady_clock::now();
+  last_refill_ = start_time_;
+  drained_count_ = 0;
+
+  LOG(INFO) << "Draining backlog of " << end_seq - begin_seq
+            << " readings over " << streams_.size() << " sessions";
+
+  Pump();
+  return true;
+}
+
+void BacklogDrainer::Stop()
+{
+  for (size_t i = 0; i < streams_.size(); ++i)
+  {
+    CloseStream(i);
+  }
+
+  if (tick_timer_ >= 0)
+  {
+    event_loop_->DisarmTimer(tick_timer_);
+  }
+
+  requeued_ranges_.clear();
+  is_active_ = false;
+}
+
+bool BacklogDrainer::IsActive() const
+{
+  return is_active_;
+}
+
+size_t BacklogDrainer::GetDrainedCount() const
+{
+  return drained_count_;
+}
+
+void BacklogDrainer::Pump()
+{
+  if (!is_active_)
+  {
+    return;
+  }
+
+  RefillTokens();
+  auto now = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < streams_.size(); ++i)
+  {
+    Stream &stream = streams_[i];
+    if (!stream.client.IsConnected())
+    {
+      // A session posts once its handshake completes.
+      if (!stream.connector.IsConnecting() && HasUnassignedReadings() &&
+          now >= stream.retry_at)
+      {
+        ConnectStream(i);
+      }
+      continue;
+    }
+
+    PostChunks(i);
+  }
+
+  MaybeFinish();
+}
+
+void BacklogDrainer::PostChunks(size_t stream_index)
+{
+  Stream &stream = streams_[stream_index];
+  bool is_rate_limited = policy_.max_rate > 0;
+
+  SoilMoistureMeasurement measurement;
+  while (stream.client.CanPostRequest() && (!is_rate_limited || tokens_ >= 1))
+  {
+    if (stream.chunk_next_seq == stream.chunk_end_seq && !TakeChunk(&stream))
+    {
+      break;
+    }
+
+    spool_->Get(stream.chunk_next_seq, &measurement);
+    if (!stream.client.PostSoilMoistureMeasurement(measurement))
+    {
+      LOG(ERROR) << "Failed to upload backlog reading for sensor "
+                 << measurement.sensor_id;
+      HandleStreamFailure(stream_index, ClientError::NETWORK);
+      return;
+    }
+
+    stream.in_flight_seqs.push_back(stream.chunk_next_seq);
+    ++stream.chunk_next_seq;
+    if (is_rate_limited)
+    {
+      tokens_ -= 1;
+    }
+  }
+
+  ClientError error;
+  if (!stream.client.Flush(&error))
+  {
+    HandleStreamFailure(stream_index, error);
+    return;
+  }
+
+  WatchStreamWrites(stream_index);
+}
+
+void BacklogDrainer::WatchStreamWrites(size_t stream_index)
+{
+  // Only while a flush is part done, since EPOLLOUT is level-triggered.
+  Stream &stream = streams_[stream_index];
+  bool wants_write = stream.client.WantsWrite();
+  if (wants_write == stream.is_watching_writes)
+  {
+    return;
+  }
+
+  if (!event_loop_->ModifyFd(
+        stream.client.GetFd(),
+        wants_write ? SERVER_EVENTS | EPOLLOUT : SERVER_EVENTS))
+  {
+    LOG(ERROR) << "Failed to update events on drain session " << stream_index;
+    HandleStreamFailure(stream_index, ClientError::NETWORK);
+    return;
+  }
+  stream.is_watching_writes = wants_write;
+}
+
+void BacklogDrainer::OnStreamEvent(size_t stream_index, uint32_t events)
+{
+  Stream &stream = streams_[stream_index];
+  // Writable counts as readable here: TLS may have stalled a read on a
+  // write, and TryCompleteRequest() flushes first anyway.
+  if ((events & (EPOLLIN | EPOLLOUT)) &&
+      stream.client.GetPendingRequestCount() > 0)
+  {
+    bool may_read_socket = true;
+    while (stream.client.GetPendingRequestCount() > 0 &&
+           (may_read_socket || stream.client.HasBufferedResponse()))
+    {
+      may_read_socket = false;
+
+      size_t measurement_id;
+      bool completed = false;
+      ClientError error;
+      if (!stream.client.TryCompleteRequest(&measurement_id, &completed, &error))
+      {
+        LOG(ERROR) << "Failed to read BASIC_RESPONSE on drain session "
+                   << stream_index << ": " << GetClientErrorName(error);
+        HandleStreamFailure(stream_index, error);
+        return;
+      }
+
+      if (!completed)
+      {
+        break;
+      }
+
+      if (!stream.has_responded)
+      {
+        stream.has_responded = true;
+        stream.backoff.OnSuccess();
+      }
+
+      // A reading the server refuses would be refused again, so it's dropped
+      // like an acknowledged one.
+      uint64_t seq = stream.in_flight_seqs.front();
+      stream.in_flight_seqs.pop_front();
+      if (error == ClientError::REJECTED)
+      {
+        LOG(WARNING) << "Server rejected backlog reading " << seq
+                     << ". Dropping it";
+      }
+      else
+      {
+        ++drained_count_;
+      }
+      on_completed_(seq);
+    }
+
+    Pump();
+    return;
+  }
+
+  if (events == EPOLLOUT)
+  {
+    // Nothing outstanding, so only the HELLO can be left to flush.
+    Pump();
+    return;
+  }
+
+  LOG(INFO) << "Server closed drain session " << stream_index;
+  HandleStreamFailure(
+      stream_index,
+      (events & EPOLLERR) ? ClientError::NETWORK : ClientError::CONNECTION_CLOSED);
+}
+
+void BacklogDrainer::ConnectStream(size_t stream_index)
+{
+  Stream &stream = streams_[stream_index];
+  assert(!stream.client.IsConnected());
+
+  if (!stream.connector.Start(
+        event_loop_,
+        tls_context_,
+        session_cache_,
+        &stream.client,
+        [this, stream_index](ClientError error)
+        {
+          OnStreamConnected(stream_index, error);
+        }))
+  {
+    OnStreamConnected(stream_index, ClientError::NETWORK);
+  }
+}
+
+void BacklogDrainer::OnStreamConnected(size_t stream_index, ClientError error)
+{
+  Stream &stream = streams_[stream_index];
+  if (error != ClientError::NONE)
+  {
+    LOG(WARNING) << "Failed to open drain session " << stream_index;
+    stream.retry_at =
+        std::chrono::steady_clock::now() + stream.backoff.OnFailure(error);
+    return;
+  }
+
+  stream.has_responded = false;
+  stream.is_watching_writes = false;
+  stream.client.SetPipelineWindow(pipeline_window_);
+  if (!event_loop_->AddFd(
+        stream.client.GetFd(),
+        SERVER_EVENTS,
+        [this, stream_index](uint32_t events)
+        {
+          OnStreamEvent(stream_index, events);
+        }))
+  {
+    LOG(ERROR) << "Failed to watch drain session " << stream_index;
+    stream.client.Close();
+    stream.retry_at = std::chrono::steady_clock::now() +
+                      stream.backoff.OnFailure(ClientError::NETWORK);
+    return;
+  }
+
+  RefillTokens();
+  PostChunks(stream_index);
+}
+
+void BacklogDrainer::CloseStream(size_t stream_index)
+{
+  Stream &stream = streams_[stream_index];
+  stream.connector.Cancel();
+  if (stream.client.IsConnected())
+  {
+    event_loop_->RemoveFd(stream.client.GetFd());
+    stream.client.Close();
+  }
+
+  stream.chunk_next_seq = 0;
+  stream.chunk_end_seq = 0;
+  stream.in_flight_seqs.clear();
+}
+
+void BacklogDrainer::HandleStreamFailure(size_t stream_index, ClientError error)
+{
+  Stream &stream = streams_[stream_index];
+
+  // Give back every reading the session hadn't had acknowledged, as
+  // contiguous ranges.
+  std::deque<uint64_t> &seqs = stream.in_flight_seqs;
+  size_t i = 0;
+  while (i < seqs.size())
+  {
+    size_t run_end = i + 1;
+    while (run_end < seqs.size() && seqs[run_end] == seqs[run_end - 1] + 1)
+    {
+      ++run_end;
+    }
+    requeued_ranges_[seqs[i]] = seqs[run_end - 1] + 1;
+    i = run_end;
+  }
+
+  if (stream.chunk_next_seq < stream.chunk_end_seq)
+  {
+    requeued_ranges_[stream.chunk_next_seq] = stream.chunk_end_seq;
+  }
+
+  // A session that served until the server closed it comes back straight
+  // away, with a little jitter so the streams don't return together.
+  // Anything else backs off.
+  bool was_closed = error == ClientError::CONNECTION_CLOSED && stream.has_responded;
+  CloseStream(stream_index);
+  stream.retry_at = std::chrono::steady_clock::now() +
+                    (was_closed ?
+                        stream.backoff.OnSessionClosed() :
+                        stream.backoff.OnFailure(error));
+}
+
+bool BacklogDrainer::TakeChunk(Stream *stream)
+{
+  assert(stream);
+
+  // Ranges from failed sessions go first; they hold the oldest readings.
+  if (!requeued_ranges_.empty())
+  {
+    auto range = requeued_ranges_.begin();
+    uint64_t begin_seq = range->first;
+    uint64_t end_seq = range->second;
+    requeued_ranges_.erase(range);
+
+    uint64_t chunk_end_seq = std::min(end_seq, begin_seq + policy_.chunk_size);
+    if (chunk_end_seq < end_seq)
+    {
+      requeued_ranges_[chunk_end_seq] = end_seq;
+    }
+
+    stream->chunk_next_seq = begin_seq;
+    stream->chunk_end_seq = chunk_end_seq;
+    return true;
+  }
+
+  if (next_seq_ == end_seq_)
+  {
+    return false;
+  }
+
+  stream->chunk_next_seq = next_seq_;
+  stream->chunk_end_seq = std::min(end_seq_, next_seq_ + policy_.chunk_size);
+  next_seq_ = stream->chunk_end_seq;
+  return true;
+}
+
+bool BacklogDrainer::HasUnassignedReadings() const
+{
+  return next_seq_ < end_seq_ || !requeued_ranges_.empty();
+}
+
+void BacklogDrainer::RefillTokens()
+{
+  if (policy_.max_rate == 0)
+  {
+    return;
+  }
+
+  // At most one second's worth of uploads may burst.
+  auto now = std::chrono::steady_clock::now();
+  std::chrono::duration<double> elapsed = now - last_refill_;
+  last_refill_ = now;
+  double max_tokens = static_cast<double>(policy_.max_rate);
+  tokens_ = std::min(max_tokens, tokens_ + elapsed.count() * max_tokens);
+}
+
+void BacklogDrainer::MaybeFinish()
+{
+  if (HasUnassignedReadings())
+  {
+    return;
+  }
+
+  for (const Stream &stream : streams_)
+  {
+    if (stream.chunk_next_seq < stream.chunk_end_seq ||
+        !stream.in_flight_seqs.empty())
+    {
+      return;
+    }
+  }
+
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start_time_;
+  double seconds = std::max(elapsed.count(), 1e-3);
+  LOG(INFO) << "Drained " << drained_count_ << " backlog readings in "
+            << seconds << " seconds ("
+            << static_cast<double>(drained_count_) / seconds
+            << " readings/s)";
+
+  Stop();
+}
+
+} // namespace organicdump
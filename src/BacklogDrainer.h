@@ -0,0 +1,125 @@
+#ifndef ORGANICDUMP_CLIENT_BACKLOGDRAINER_H
+#define ORGANICDUMP_CLIENT_BACKLOGDRAINER_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <vector>
+
+#include "Client.h"
+#include "ClientConnector.h"
+#include "ClientError.h"
+#include "DrainPolicy.h"
+#include "EventLoop.h"
+#include "MeasurementSpool.h"
+#include "ReconnectBackoff.h"
+#include "ReconnectPolicy.h"
+#include "TlsContext.h"
+#include "TlsSessionCache.h"
+
+namespace organicdump
+{
+
+/**
+ * Uploads a range of spooled readings over several parallel server sessions.
+ * The range is split into contiguous chunks; each session uploads its chunk
+ * in order before taking the next one. Chunks of a failed session go back to
+ * be taken again by any session. Uploads are rate limited by a token bucket
+ * topped up on a periodic timer.
+ *
+ * Completions are reported per reading through |on_completed| and may arrive
+ * out of order across sessions. Each session backs off on its own per the
+ * ReconnectPolicy.
+ */
+class BacklogDrainer
+{
+public:
+  using CompletionCallback = std::function<void(uint64_t seq)>;
+
+public:
+  BacklogDrainer(
+      EventLoop *event_loop,
+      TlsContext *tls_context,
+      TlsSessionCache *session_cache,
+      const MeasurementSpool *spool,
+      DrainPolicy policy,
+      size_t pipeline_window,
+      ReconnectPolicy reconnect_policy,
+      CompletionCallback on_completed);
+  ~BacklogDrainer();
+
+  /**
+   * Starts uploading readings [begin_seq, end_seq). The drainer must be
+   * inactive.
+   */
+  bool Start(uint64_t begin_seq, uint64_t end_seq);
+
+  /**
+   * Closes every drain session. Readings not yet acknowledged stay in the
+   * spool.
+   */
+  void Stop();
+
+  bool IsActive() const;
+  size_t GetDrainedCount() const;
+
+private:
+  struct Stream
+  {
+    Client client;
+    ClientConnector connector;
+    uint64_t chunk_next_seq = 0;
+    uint64_t chunk_end_seq = 0;
+    std::deque<uint64_t> in_flight_seqs;
+    std::chrono::steady_clock::time_point retry_at;
+    ReconnectBackoff backoff;
+    bool has_responded = false;
+    bool is_watching_writes = false;
+  };
+
+private:
+  void Pump();
+  void PostChunks(size_t stream_index);
+  void WatchStreamWrites(size_t stream_index);
+  void OnStreamEvent(size_t stream_index, uint32_t events);
+  void ConnectStream(size_t stream_index);
+  void OnStreamConnected(size_t stream_index, ClientError error);
+  void CloseStream(size_t stream_index);
+  void HandleStreamFailure(size_t stream_index, ClientError error);
+  bool TakeChunk(Stream *stream);
+  bool HasUnassignedReadings() const;
+  void RefillTokens();
+  void MaybeFinish();
+
+private:
+  BacklogDrainer(const BacklogDrainer &other) = delete;
+  BacklogDrainer &operator=(const BacklogDrainer &other) = delete;
+
+private:
+  EventLoop *event_loop_;
+  TlsContext *tls_context_;
+  TlsSessionCache *session_cache_;
+  const MeasurementSpool *spool_;
+  DrainPolicy policy_;
+  size_t pipeline_window_;
+  CompletionCallback on_completed_;
+  EventLoop::TimerId tick_timer_;
+  std::vector<Stream> streams_;
+
+  bool is_active_;
+  uint64_t next_seq_;
+  uint64_t end_seq_;
+  // Ranges taken back from failed sessions, keyed by first sequence number.
+  std::map<uint64_t, uint64_t> requeued_ranges_;
+  double tokens_;
+  std::chrono::steady_clock::time_point last_refill_;
+  std::chrono::steady_clock::time_point start_time_;
+  size_t drained_count_;
+};
+
+} // namespace organicdump
+
+#endif // ORGANICDUMP_CLIENT_BACKLOGDRAINER_H
@@ -0,0 +1,30 @@
+#ifndef ORGANICDUMP_CLIENT_BUSRECOVERYPOLICY_H
+#define ORGANICDUMP_CLIENT_BUSRECOVERYPOLICY_H
+
+#include <chrono>
+#include <cstddef>
+
+namespace organicdump
+{
+
+/**
+ * When the sampler gives up on an I2C bus handle and reopens it. A bus whose
+ * sweeps fail on every device |reopen_threshold| times in a row is taken to
+ * be wedged rather than to have bad probes, and is reopened. Reopens are
+ * spaced by the reopen period, doubling while the bus stays dead up to the
+ * maximum. This is separate from server reconnects: losing the network
+ * never touches the buses.
+ */
+struct BusRecoveryPolicy
+{
+  // Sweeps in a row with no good reading before the bus is reopened. 0
+  // disables reopening.
+  size_t reopen_threshold;
+
+  std::chrono::seconds reopen_period;
+  std::chrono::seconds max_reopen_period;
+};
+
+} // namespace organicdump
+
+#endif // ORGANICDUMP_CLIENT_BUSRECOVERYPOLICY_H
@@ -0,0 +1,76 @@
+#ifndef ORGANICDUMP_CLIENT_BYTESTREAM_H
+#define ORGANICDUMP_CLIENT_BYTESTREAM_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include <openssl/ssl.h>
+
+namespace organicdump
+{
+
+/**
+ * A connected, ordered byte stream to the server. ProtobufServer frames
+ * messages over one of these, which lets the protocol code run against an
+ * in-memory stream as well as a TLS socket.
+ */
+class ByteStream
+{
+public:
+  virtual ~ByteStream() = default;
+
+  /**
+   * Reads up to |size| bytes without blocking. |out_bytes_read| is 0 if
+   * nothing has arrived yet. A clean shutdown by the peer sets
+   * |out_cxn_closed| and returns false.
+   */
+  virtual bool Read(
+      uint8_t *buffer,
+      size_t size,
+      size_t *out_bytes_read,
+      bool *out_cxn_closed) = 0;
+
+  /**
+   * Writes as much of |data| as the transport takes without blocking.
+   * Whatever is past |out_bytes_written| has to be offered again, starting
+   * with the same bytes, once the fd is ready.
+   */
+  virtual bool Write(
+      const uint8_t *data,
+      size_t size,
+      size_t *out_bytes_written,
+      bool *out_cxn_closed) = 0;
+
+  /**
+   * True if the last Read() or Write() stopped because the transport has to
+   * write before it can go on, so the fd should be polled for writability
+   * rather than readability.
+   */
+  virtual bool WantsWrite() const = 0;
+
+  /**
+   * True if bytes are buffered above the socket, so that a Read() won't
+   * block even though the fd doesn't poll readable.
+   */
+  virtual bool HasPendingData() const = 0;
+
+  /**
+   * The socket to poll for readability, or -1 if there is none.
+   */
+  virtual int GetFd() const = 0;
+
+  /**
+   * The TLS session state, or nullptr for a stream that isn't TLS.
+   */
+  virtual SSL *GetSsl() const = 0;
+
+  /**
+   * Write calls issued on the underlying transport so far. Frames queued
+   * together should cost one.
+   */
+  virtual size_t GetWriteCallCount() const = 0;
+};
+
+} // namespace organicdump
+
+#endif // ORGANICDUMP_CLIENT_BYTESTREAM_H
@@ -0,0 +1,36 @@
+#ifndef ORGANICDUMP_CLIENT_CHANNELFAULTPOLICY_H
+#define ORGANICDUMP_CLIENT_CHANNELFAULTPOLICY_H
+
+#include <chrono>
+#include <cstddef>
+
+namespace organicdump
+{
+
+/**
+ * How the sampler copes with a probe that fails to read. Failed conversions
+ * are retried within the sweep. A channel that still fails on
+ * |quarantine_threshold| sweeps in a row is quarantined: it's only probed
+ * once per quarantine period, which doubles on every failed probe up to the
+ * maximum, so it stops costing the healthy channels bus time.
+ */
+struct ChannelFaultPolicy
+{
+  // Longest a single I2C transaction may stall the bus, e.g. on a slave
+  // holding SCL low.
+  std::chrono::milliseconds i2c_timeout;
+
+  // Extra attempts at a failed conversion within one sweep.
+  size_t retry_count;
+
+  // Failed sweeps in a row before a channel is quarantined. 0 disables
+  // quarantine.
+  size_t quarantine_threshold;
+
+  std::chrono::seconds quarantine_period;
+  std::chrono::seconds max_quarantine_period;
+};
+
+} // namespace organicdump
+
+#endif // ORGANICDUMP_CLIENT_CHANNELFAULTPOLICY_H
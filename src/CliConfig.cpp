@@ -8,16 +8,53 @@
 #include <gflags/gflags.h>
 #include <glog/logging.h>
 
+#include "Ads1115Registers.h"
+
 namespace
 {
 
+using organicdump::SampleFilterType;
+using organicdump::SimulatedWaveform;
 using organicdump_proto::MessageType;
 
+// Not a single server message: registers a whole rig from a manifest.
+constexpr const char *PROVISION_ACTION = "provision";
+
 constexpr int UNSET_CLI_INT = -1;
 constexpr double UNSET_CLI_DOUBLE = -1E6;
 constexpr size_t UNSET_MEASUREMENT_PERIOD = 0;
 constexpr size_t DEFAULT_MEASUREMENT_PERIOD = 600;
 constexpr size_t DEFAULT_RETRY_CONNECT_SERVER_PERIOD = 60;
+constexpr size_t DEFAULT_RECONNECT_BASE_DELAY_MS = 500;
+constexpr size_t DEFAULT_BREAKER_THRESHOLD = 5;
+constexpr size_t DEFAULT_BREAKER_COOLDOWN = 300;
+constexpr size_t DEFAULT_PIPELINE_WINDOW = 8;
+constexpr size_t DEFAULT_KEEPALIVE_PERIOD = 60;
+constexpr size_t DEFAULT_IDLE_CLOSE_THRESHOLD = 900;
+constexpr size_t DEFAULT_SPOOL_CAPACITY = 65536;
+constexpr size_t DEFAULT_DRAIN_STREAMS = 2;
+constexpr size_t DEFAULT_DRAIN_CHUNK_SIZE = 256;
+constexpr size_t DEFAULT_DRAIN_BACKLOG_THRESHOLD = 512;
+constexpr size_t DEFAULT_DRAIN_MAX_RATE = 200;
+constexpr size_t DEFAULT_OVERSAMPLE_COUNT = 1;
+constexpr double DEFAULT_TRIM_FRACTION = 0.2;
+constexpr double DEFAULT_EWMA_ALPHA = 0.3;
+constexpr size_t DEFAULT_HEARTBEAT_PERIOD = 3600;
+constexpr size_t UNSET_PERIOD_BOUND = 0;
+constexpr double DEFAULT_TARGET_CHANGE = 100;
+constexpr size_t DEFAULT_I2C_TIMEOUT_MS = 100;
+constexpr size_t DEFAULT_READ_RETRIES = 2;
+constexpr size_t DEFAULT_QUARANTINE_THRESHOLD = 3;
+constexpr size_t DEFAULT_QUARANTINE_PERIOD = 60;
+constexpr size_t DEFAULT_MAX_QUARANTINE_PERIOD = 3600;
+constexpr size_t DEFAULT_BUS_REOPEN_THRESHOLD = 5;
+constexpr size_t DEFAULT_BUS_REOPEN_PERIOD = 30;
+constexpr size_t DEFAULT_MAX_BUS_REOPEN_PERIOD = 600;
+constexpr double DEFAULT_SIM_BASE_VALUE = 16000;
+constexpr double DEFAULT_SIM_AMPLITUDE = 4000;
+constexpr size_t DEFAULT_SIM_WAVEFORM_PERIOD = 86400;
+constexpr double DEFAULT_SIM_NOISE = 20;
+constexpr size_t DEFAULT_SIM_CONVERSION_TIME_US = 9000;
 
 const std::unordered_map<std::string, MessageType> SERVER_ACTION_MAP =
 {
@@ -27,6 +64,21 @@ const std::unordered_map<std::string, MessageType> SERVER_ACTION_MAP =
   {"send_soil_moisture_measurement", MessageType::SEND_SOIL_MOISTURE_MEASUREMENT},
 };
 
+const std::unordered_map<std::string, SampleFilterType> SAMPLE_FILTER_MAP =
+{
+  {"mean", SampleFilterType::MEAN},
+  {"median", SampleFilterType::MEDIAN},
+  {"trimmed_mean", SampleFilterType::TRIMMED_MEAN},
+  {"ewma", SampleFilterType::EWMA},
+};
+
+const std::unordered_map<std::string, SimulatedWaveform> SIM_WAVEFORM_MAP =
+{
+  {"constant", SimulatedWaveform::CONSTANT},
+  {"sine", SimulatedWaveform::SINE},
+  {"drying", SimulatedWaveform::DRYING},
+};
+
 bool FailUnsetCliInt(const char *param, int32_t port)
 {
     if (port == UNSET_CLI_INT)
@@ -57,6 +109,16 @@ bool CheckNonEmptyString(const char *param, const std::string &value) {
   return true;
 }
 
+bool CheckPositive(const char *param, uint64_t value)
+{
+  if (value == 0)
+  {
+    LOG(ERROR) << "--" << param << " must be positive";
+    return false;
+  }
+  return true;
+}
+
 bool IsCliIntSet(int value)
 {
   return value != UNSET_CLI_INT;
@@ -81,6 +143,98 @@ bool ParseAction(const std::string &action_str, MessageType *out_action)
   return true;
 }
 
+bool CheckSampleFilter(const char *param, const std::string &value)
+{
+  if (SAMPLE_FILTER_MAP.count(value) == 0)
+  {
+    LOG(ERROR) << "--" << param << " must be mean, median, trimmed_mean or ewma";
+    return false;
+  }
+  return true;
+}
+
+bool CheckTrimFraction(const char *param, double value)
+{
+  if (value < 0 || value >= 0.5)
+  {
+    LOG(ERROR) << "--" << param << " must be in [0, 0.5)";
+    return false;
+  }
+  return true;
+}
+
+bool CheckEwmaAlpha(const char *param, double value)
+{
+  if (value <= 0 || value > 1)
+  {
+    LOG(ERROR) << "--" << param << " must be in (0, 1]";
+    return false;
+  }
+  return true;
+}
+
+bool CheckSimWaveform(const char *param, const std::string &value)
+{
+  if (SIM_WAVEFORM_MAP.count(value) == 0)
+  {
+    LOG(ERROR) << "--" << param << " must be constant, sine or drying";
+    return false;
+  }
+  return true;
+}
+
+bool CheckProbability(const char *param, double value)
+{
+  if (value < 0 || value > 1)
+  {
+    LOG(ERROR) << "--" << param << " must be in [0, 1]";
+    return false;
+  }
+  return true;
+}
+
+bool CheckAdcFullScale(const char *param, uint32_t value)
+{
+  if (!organicdump::ads1115::IsValidFullScale(value))
+  {
+    LOG(ERROR) << "--" << param << " must be 6144, 4096, 2048, 1024, 512 or "
+               << "256";
+    return false;
+  }
+  return true;
+}
+
+bool CheckAdcDataRate(const char *param, uint32_t value)
+{
+  if (!organicdump::ads1115::IsValidDataRate(value))
+  {
+    LOG(ERROR) << "--" << param << " must be 8, 16, 32, 64, 128, 250, 475 or "
+               << "860";
+    return false;
+  }
+  return true;
+}
+
+bool CheckPositiveDouble(const char *param, double value)
+{
+  if (value <= 0)
+  {
+    LOG(ERROR) << "--" << param << " must be positive";
+    return false;
+  }
+  return true;
+}
+
+bool CheckNonNegative(const char *param, double value)
+{
+  if (value < 0)
+  {
+    LOG(ERROR) << "--" << param << " cannot be negative";
+    return false;
+  }
+  return true;
+}
+
 DEFINE_string(ipv4, "", "Ipv4 address");
 DEFINE_int32(port, UNSET_CLI_INT, "Port");
 DEFINE_string(cert, "", "Certificate file");
@@ -95,17 +249,241 @@ DEFINE_double(floor, UNSET_CLI_DOUBLE, "Floor of sensor");
 DEFINE_double(ceiling, UNSET_CLI_DOUBLE, "Ceiling of sensor");
 DEFINE_double(measurement, UNSET_CLI_DOUBLE, "Measurement for sensors");
 DEFINE_string(config_file, "", "Config file path");
+DEFINE_string(
+    manifest,
+    "",
+    "Rig manifest for --action=provision, which writes the resulting monitor "
+    "config to --config_file");
 DEFINE_uint64(measurement_period, DEFAULT_MEASUREMENT_PERIOD, "Measurement period");
 DEFINE_uint64(
     retry_connect_server_period,
     DEFAULT_RETRY_CONNECT_SERVER_PERIOD,
-    "Retry connect server period");
+    "Longest backoff in seconds between server connection attempts");
+DEFINE_uint64(
+    reconnect_base_delay_ms,
+    DEFAULT_RECONNECT_BASE_DELAY_MS,
+    "Shortest backoff between server connection attempts. Reconnects after "
+    "the server closes a session wait at most this long");
+DEFINE_uint64(
+    breaker_threshold,
+    DEFAULT_BREAKER_THRESHOLD,
+    "Server errors in a row before reconnects pause for the breaker "
+    "cooldown. 0 disables");
+DEFINE_uint64(
+    breaker_cooldown,
+    DEFAULT_BREAKER_COOLDOWN,
+    "Seconds to hold off reconnecting while the breaker is open");
+DEFINE_uint64(
+    pipeline_window,
+    DEFAULT_PIPELINE_WINDOW,
+    "Max requests in flight on the server connection");
+DEFINE_bool(
+    persistent_connection,
+    true,
+    "Keep the server session open across measurement periods");
+DEFINE_uint64(
+    keepalive_period,
+    DEFAULT_KEEPALIVE_PERIOD,
+    "TCP keepalive period for persistent sessions. 0 disables keepalive");
+DEFINE_uint64(
+    idle_close_threshold,
+    DEFAULT_IDLE_CLOSE_THRESHOLD,
+    "Close idle persistent sessions when no reading is due within this many "
+    "seconds");
+DEFINE_string(
+    tls_session_cache_file,
+    "",
+    "File that persists the TLS session for resumption across restarts");
+DEFINE_string(
+    spool_file,
+    "",
+    "Store-and-forward spool for unacknowledged readings. Memory only if unset");
+DEFINE_uint64(
+    spool_capacity,
+    DEFAULT_SPOOL_CAPACITY,
+    "Max readings held in the spool");
+DEFINE_string(
+    control_socket,
+    "",
+    "Unix socket that answers local connections with the daemon's counters. "
+    "Disabled if unset");
+
+DEFINE_uint64(
+    drain_streams,
+    DEFAULT_DRAIN_STREAMS,
+    "Extra server sessions used to catch up on a backlog. 0 disables");
+DEFINE_uint64(
+    drain_chunk_size,
+    DEFAULT_DRAIN_CHUNK_SIZE,
+    "Backlog readings handed to a drain session at a time");
+DEFINE_uint64(
+    drain_backlog_threshold,
+    DEFAULT_DRAIN_BACKLOG_THRESHOLD,
+    "Unsent readings needed to start catching up on drain sessions");
+DEFINE_uint64(
+    drain_max_rate,
+    DEFAULT_DRAIN_MAX_RATE,
+    "Max backlog readings uploaded per second. 0 leaves it uncapped");
+
+DEFINE_uint64(
+    oversample_count,
+    DEFAULT_OVERSAMPLE_COUNT,
+    "ADC conversions per channel per measurement period");
+DEFINE_string(
+    sample_filter,
+    "median",
+    "Reduces oversampled conversions: mean, median, trimmed_mean or ewma");
+DEFINE_double(
+    trim_fraction,
+    DEFAULT_TRIM_FRACTION,
+    "Fraction of conversions dropped from each end by trimmed_mean");
+DEFINE_double(
+    ewma_alpha,
+    DEFAULT_EWMA_ALPHA,
+    "Weight of each new conversion for ewma");
+
+DEFINE_double(
+    deadband_absolute,
+    0,
+    "Upload a reading only if it moved more than this since the last upload");
+DEFINE_double(
+    deadband_relative,
+    0,
+    "Upload a reading only if it moved more than this fraction since the last "
+    "upload");
+DEFINE_uint64(
+    heartbeat_period,
+    DEFAULT_HEARTBEAT_PERIOD,
+    "Upload a reading inside the deadband if a sensor has been quiet this long");
+
+DEFINE_uint64(
+    min_measurement_period,
+    UNSET_PERIOD_BOUND,
+    "Shortest adaptive sampling period. Defaults to --measurement_period");
+DEFINE_uint64(
+    max_measurement_period,
+    UNSET_PERIOD_BOUND,
+    "Longest adaptive sampling period. Defaults to --measurement_period");
+DEFINE_double(
+    target_change,
+    DEFAULT_TARGET_CHANGE,
+    "Change in a filtered reading that adaptive sampling aims to see per "
+    "sample");
+
+DEFINE_uint64(
+    i2c_timeout_ms,
+    DEFAULT_I2C_TIMEOUT_MS,
+    "Longest an I2C transaction may stall before it fails");
+DEFINE_uint64(
+    read_retries,
+    DEFAULT_READ_RETRIES,
+    "Extra attempts at a failed ADC conversion within one sweep");
+DEFINE_uint64(
+    quarantine_threshold,
+    DEFAULT_QUARANTINE_THRESHOLD,
+    "Failed sweeps in a row before a sensor is quarantined. 0 disables");
+DEFINE_uint64(
+    quarantine_period,
+    DEFAULT_QUARANTINE_PERIOD,
+    "Seconds between probes of a quarantined sensor, doubling while it fails");
+DEFINE_uint64(
+    max_quarantine_period,
+    DEFAULT_MAX_QUARANTINE_PERIOD,
+    "Longest time between probes of a quarantined sensor");
+DEFINE_uint64(
+    bus_reopen_threshold,
+    DEFAULT_BUS_REOPEN_THRESHOLD,
+    "Sweeps in a row without any good reading before an I2C bus is "
+    "reopened. 0 disables");
+DEFINE_uint64(
+    bus_reopen_period,
+    DEFAULT_BUS_REOPEN_PERIOD,
+    "Seconds between reopens of a dead I2C bus, doubling while it stays dead");
+DEFINE_uint64(
+    max_bus_reopen_period,
+    DEFAULT_MAX_BUS_REOPEN_PERIOD,
+    "Longest time between reopens of a dead I2C bus");
+
+DEFINE_uint32(
+    adc_full_scale_mv,
+    organicdump::ads1115::DEFAULT_FULL_SCALE_MV,
+    "ADS1115 full-scale range in millivolts. Readings are raw codes, so this "
+    "sets their scale. Defaults to the chip's power-on range");
+DEFINE_uint32(
+    adc_data_rate,
+    organicdump::ads1115::DEFAULT_DATA_RATE_SPS,
+    "ADS1115 conversions per second. Sets each conversion's duration. "
+    "Defaults to the chip's power-on rate");
+
+DEFINE_bool(
+    simulate_hardware,
+    false,
+    "Sample simulated ADS1115s instead of the Pi's I2C buses");
+DEFINE_string(
+    sim_waveform,
+    "drying",
+    "Signal played by simulated sensors: constant, sine or drying");
+DEFINE_double(
+    sim_base_value,
+    DEFAULT_SIM_BASE_VALUE,
+    "Centre of the simulated signal, in ADC codes");
+DEFINE_double(
+    sim_amplitude,
+    DEFAULT_SIM_AMPLITUDE,
+    "Amplitude of the simulated signal, in ADC codes");
+DEFINE_uint64(
+    sim_waveform_period,
+    DEFAULT_SIM_WAVEFORM_PERIOD,
+    "Period of the simulated signal in simulated seconds");
+DEFINE_double(
+    sim_time_scale,
+    1,
+    "How many times faster than real time the simulated signal plays");
+DEFINE_double(
+    sim_noise,
+    DEFAULT_SIM_NOISE,
+    "Standard deviation of simulated conversion noise, in ADC codes");
+DEFINE_uint64(
+    sim_conversion_time_us,
+    DEFAULT_SIM_CONVERSION_TIME_US,
+    "Simulated ADS1115 conversion time. 0 makes conversions instant");
+DEFINE_double(
+    sim_nack_probability,
+    0,
+    "Chance that a simulated device NACKs any one I2C message");
+DEFINE_uint32(sim_seed, 1, "Seed for simulated noise and faults");
+DEFINE_bool(
+    sim_upload,
+    false,
+    "Upload simulated readings to the configured server. Without it they "
+    "are only logged");
 
 DEFINE_validator(ipv4, CheckNonEmptyString);
 DEFINE_validator(port, FailUnsetCliInt);
 DEFINE_validator(cert, CheckFileExists);
 DEFINE_validator(key, CheckFileExists);
 DEFINE_validator(ca, CheckFileExists);
+DEFINE_validator(reconnect_base_delay_ms, CheckPositive);
+DEFINE_validator(pipeline_window, CheckPositive);
+DEFINE_validator(spool_capacity, CheckPositive);
+DEFINE_validator(drain_chunk_size, CheckPositive);
+DEFINE_validator(oversample_count, CheckPositive);
+DEFINE_validator(sample_filter, CheckSampleFilter);
+DEFINE_validator(trim_fraction, CheckTrimFraction);
+DEFINE_validator(ewma_alpha, CheckEwmaAlpha);
+DEFINE_validator(deadband_absolute, CheckNonNegative);
+DEFINE_validator(deadband_relative, CheckNonNegative);
+DEFINE_validator(target_change, CheckNonNegative);
+DEFINE_validator(i2c_timeout_ms, CheckPositive);
+DEFINE_validator(quarantine_period, CheckPositive);
+DEFINE_validator(bus_reopen_period, CheckPositive);
+DEFINE_validator(adc_full_scale_mv, CheckAdcFullScale);
+DEFINE_validator(adc_data_rate, CheckAdcDataRate);
+DEFINE_validator(sim_waveform, CheckSimWaveform);
+DEFINE_validator(sim_waveform_period, CheckPositive);
+DEFINE_validator(sim_time_scale, CheckPositiveDouble);
+DEFINE_validator(sim_noise, CheckNonNegative);
+DEFINE_validator(sim_nack_probability, CheckProbability);
 } // namespace
 
 namespace organicdump
@@ -118,13 +496,47 @@ bool CliConfig::Parse(int argc, char **argv, CliConfig *out_config)
   google::ParseCommandLineFlags(&argc, &argv, false);
 
   MessageType action;
-  bool has_action = FLAGS_action != "";
+  bool should_provision = FLAGS_action == PROVISION_ACTION;
+  bool has_action = FLAGS_action != "" && !should_provision;
   if (has_action && !ParseAction(FLAGS_action, &action))
   {
     LOG(ERROR) << "Failed to parse action";
     return false;
   }
 
+  if (should_provision && (FLAGS_manifest.empty() || FLAGS_config_file.empty()))
+  {
+    LOG(ERROR) << "--action=" << PROVISION_ACTION << " needs --manifest and "
+               << "--config_file";
+    return false;
+  }
+
+  // Unset bounds pin the period, which keeps sampling fixed.
+  std::chrono::seconds min_measurement_period{
+      FLAGS_min_measurement_period == UNSET_PERIOD_BOUND ?
+          FLAGS_measurement_period : FLAGS_min_measurement_period};
+  std::chrono::seconds max_measurement_period{
+      FLAGS_max_measurement_period == UNSET_PERIOD_BOUND ?
+          FLAGS_measurement_period : FLAGS_max_measurement_period};
+  if (min_measurement_period > max_measurement_period)
+  {
+    LOG(ERROR) << "--min_measurement_period cannot exceed "
+               << "--max_measurement_period";
+    return false;
+  }
+
+  if (FLAGS_quarantine_period > FLAGS_max_quarantine_period)
+  {
+    LOG(ERROR) << "--quarantine_period cannot exceed --max_quarantine_period";
+    return false;
+  }
+
+  if (FLAGS_bus_reopen_period > FLAGS_max_bus_reopen_period)
+  {
+    LOG(ERROR) << "--bus_reopen_period cannot exceed --max_bus_reopen_period";
+    return false;
+  }
+
   *out_config = CliConfig{
       FLAGS_ipv4,
       FLAGS_port,
@@ -141,8 +553,65 @@ bool CliConfig::Parse(int argc, char **argv, CliConfig *out_config)
       FLAGS_ceiling,
       FLAGS_measurement,
       FLAGS_config_file,
+      should_provision,
+      FLAGS_manifest,
       std::chrono::seconds{FLAGS_measurement_period},
-      std::chrono::seconds{FLAGS_retry_connect_server_period}};
+      std::chrono::seconds{FLAGS_retry_connect_server_period},
+      static_cast<size_t>(FLAGS_pipeline_window),
+      ConnectionPolicy{
+          !FLAGS_simulate_hardware || FLAGS_sim_upload,
+          FLAGS_persistent_connection,
+          std::chrono::seconds{FLAGS_keepalive_period},
+          std::chrono::seconds{FLAGS_idle_close_threshold}},
+      DrainPolicy{
+          static_cast<size_t>(FLAGS_drain_streams),
+          static_cast<size_t>(FLAGS_drain_chunk_size),
+          static_cast<size_t>(FLAGS_drain_backlog_threshold),
+          static_cast<size_t>(FLAGS_drain_max_rate)},
+      AdaptiveSamplingPolicy{
+          min_measurement_period,
+          max_measurement_period,
+          FLAGS_target_change},
+      OversamplingPolicy{
+          static_cast<size_t>(FLAGS_oversample_count),
+          SAMPLE_FILTER_MAP.at(FLAGS_sample_filter),
+          FLAGS_trim_fraction,
+          FLAGS_ewma_alpha},
+      DeadbandPolicy{
+          FLAGS_deadband_absolute,
+          FLAGS_deadband_relative,
+          std::chrono::seconds{FLAGS_heartbeat_period}},
+      ChannelFaultPolicy{
+          std::chrono::milliseconds{FLAGS_i2c_timeout_ms},
+          static_cast<size_t>(FLAGS_read_retries),
+          static_cast<size_t>(FLAGS_quarantine_threshold),
+          std::chrono::seconds{FLAGS_quarantine_period},
+          std::chrono::seconds{FLAGS_max_quarantine_period}},
+      BusRecoveryPolicy{
+          static_cast<size_t>(FLAGS_bus_reopen_threshold),
+          std::chrono::seconds{FLAGS_bus_reopen_period},
+          std::chrono::seconds{FLAGS_max_bus_reopen_period}},
+      Ads1115Policy{FLAGS_adc_full_scale_mv, FLAGS_adc_data_rate},
+      ReconnectPolicy{
+          std::chrono::milliseconds{FLAGS_reconnect_base_delay_ms},
+          std::chrono::seconds{FLAGS_retry_connect_server_period},
+          static_cast<size_t>(FLAGS_breaker_threshold),
+          std::chrono::seconds{FLAGS_breaker_cooldown}},
+      FLAGS_tls_session_cache_file,
+      FLAGS_spool_file,
+      static_cast<size_t>(FLAGS_spool_capacity),
+      FLAGS_control_socket,
+      FLAGS_simulate_hardware,
+      SimulationProfile{
+          SIM_WAVEFORM_MAP.at(FLAGS_sim_waveform),
+          FLAGS_sim_base_value,
+          FLAGS_sim_amplitude,
+          std::chrono::seconds{FLAGS_sim_waveform_period},
+          FLAGS_sim_time_scale,
+          FLAGS_sim_noise,
+          std::chrono::microseconds{FLAGS_sim_conversion_time_us},
+          FLAGS_sim_nack_probability,
+          FLAGS_sim_seed}};
 
   return true; 
 }
@@ -165,8 +634,26 @@ CliConfig::CliConfig(
     double ceiling,
     double measurement,
     std::string config_file,
+    bool should_provision,
+    std::string manifest_file,
     std::chrono::seconds measurement_period,
-    std::chrono::seconds retry_connect_server_period)
+    std::chrono::seconds retry_connect_server_period,
+    size_t pipeline_window,
+    ConnectionPolicy connection_policy,
+    DrainPolicy drain_policy,
+    AdaptiveSamplingPolicy sampling_policy,
+    OversamplingPolicy oversampling_policy,
+    DeadbandPolicy deadband_policy,
+    ChannelFaultPolicy fault_policy,
+    BusRecoveryPolicy bus_recovery_policy,
+    Ads1115Policy adc_policy,
+    ReconnectPolicy reconnect_policy,
+    std::string tls_session_cache_file,
+    std::string spool_file,
+    size_t spool_capacity,
+    std::string control_socket,
+    bool simulate_hardware,
+    SimulationProfile simulation_profile)
   : ipv4_{std::move(ipv4)},
     port_{port},
     cert_file_{std::move(cert_file)},
@@ -182,8 +669,26 @@ CliConfig::CliConfig(
     ceiling_{ceiling},
     measurement_{measurement},
     config_file_{std::move(config_file)},
+    should_provision_{should_provision},
+    manifest_file_{std::move(manifest_file)},
     measurement_period_{measurement_period},
-    retry_connect_server_period_{retry_connect_server_period} {}
+    retry_connect_server_period_{retry_connect_server_period},
+    pipeline_window_{pipeline_window},
+    connection_policy_{connection_policy},
+    drain_policy_{drain_policy},
+    sampling_policy_{sampling_policy},
+    oversampling_policy_{oversampling_policy},
+    deadband_policy_{deadband_policy},
+    fault_policy_{fault_policy},
+    bus_recovery_policy_{bus_recovery_policy},
+    adc_policy_{adc_policy},
+    reconnect_policy_{reconnect_policy},
+    tls_session_cache_file_{std::move(tls_session_cache_file)},
+    spool_file_{std::move(spool_file)},
+    spool_capacity_{spool_capacity},
+    control_socket_{std::move(control_socket)},
+    simulate_hardware_{simulate_hardware},
+    simulation_profile_{simulation_profile} {}
 
 const std::string& CliConfig::GetIpv4() const
 {
@@ -302,6 +807,16 @@ const std::string &CliConfig::GetConfigFile() const
   return config_file_;
 }
 
+bool CliConfig::ShouldProvision() const
+{
+  return should_provision_;
+}
+
+const std::string &CliConfig::GetManifestFile() const
+{
+  return manifest_file_;
+}
+
 std::chrono::seconds CliConfig::GetMeasurementPeriod() const
 {
   return measurement_period_;
@@ -312,4 +827,84 @@ std::chrono::seconds CliConfig::GetRetryConnectServerPeriod() const
   return retry_connect_server_period_;
 }
 
+size_t CliConfig::GetPipelineWindow() const
+{
+  return pipeline_window_;
+}
+
+const ConnectionPolicy &CliConfig::GetConnectionPolicy() const
+{
+  return connection_policy_;
+}
+
+const DrainPolicy &CliConfig::GetDrainPolicy() const
+{
+  return drain_policy_;
+}
+
+const AdaptiveSamplingPolicy &CliConfig::GetSamplingPolicy() const
+{
+  return sampling_policy_;
+}
+
+const OversamplingPolicy &CliConfig::GetOversamplingPolicy() const
+{
+  return oversampling_policy_;
+}
+
+const DeadbandPolicy &CliConfig::GetDeadbandPolicy() const
+{
+  return deadband_policy_;
+}
+
+const ChannelFaultPolicy &CliConfig::GetFaultPolicy() const
+{
+  return fault_policy_;
+}
+
+const BusRecoveryPolicy &CliConfig::GetBusRecoveryPolicy() const
+{
+  return bus_recovery_policy_;
+}
+
+const Ads1115Policy &CliConfig::GetAdcPolicy() const
+{
+  return adc_policy_;
+}
+
+const ReconnectPolicy &CliConfig::GetReconnectPolicy() const
+{
+  return reconnect_policy_;
+}
+
+const std::string &CliConfig::GetTlsSessionCacheFile() const
+{
+  return tls_session_cache_file_;
+}
+
+const std::string &CliConfig::GetSpoolFile() const
+{
+  return spool_file_;
+}
+
+size_t CliConfig::GetSpoolCapacity() const
+{
+  return spool_capacity_;
+}
+
+const std::string &CliConfig::GetControlSocket() const
+{
+  return control_socket_;
+}
+
+bool CliConfig::ShouldSimulateHardware() const
+{
+  return simulate_hardware_;
+}
+
+const SimulationProfile &CliConfig::GetSimulationProfile() const
+{
+  return simulation_profile_;
+}
+
 }; // namespace organicdump
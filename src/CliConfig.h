@@ -8,6 +8,17 @@
 
 #include "organic_dump.pb.h"
 
+#include "AdaptiveSamplingPolicy.h"
+#include "Ads1115Policy.h"
+#include "BusRecoveryPolicy.h"
+#include "ChannelFaultPolicy.h"
+#include "ConnectionPolicy.h"
+#include "DeadbandPolicy.h"
+#include "DrainPolicy.h"
+#include "OversamplingPolicy.h"
+#include "ReconnectPolicy.h"
+#include "SimulationProfile.h"
+
 namespace organicdump
 {
 
@@ -34,8 +45,26 @@ public:
       double ceiling,
       double measurement,
       std::string config_file,
+      bool should_provision,
+      std::string manifest_file,
       std::chrono::seconds retry_connect_server_period,
-      std::chrono::seconds measurement_period);
+      std::chrono::seconds measurement_period,
+      size_t pipeline_window,
+      ConnectionPolicy connection_policy,
+      DrainPolicy drain_policy,
+      AdaptiveSamplingPolicy sampling_policy,
+      OversamplingPolicy oversampling_policy,
+      DeadbandPolicy deadband_policy,
+      ChannelFaultPolicy fault_policy,
+      BusRecoveryPolicy bus_recovery_policy,
+      Ads1115Policy adc_policy,
+      ReconnectPolicy reconnect_policy,
+      std::string tls_session_cache_file,
+      std::string spool_file,
+      size_t spool_capacity,
+      std::string control_socket,
+      bool simulate_hardware,
+      SimulationProfile simulation_profile);
 
   const std::string& GetIpv4() const;
   int32_t GetPort() const;
@@ -60,8 +89,26 @@ public:
   double GetMeasurement() const;
   bool HasConfigFile() const;
   const std::string &GetConfigFile() const;
+  bool ShouldProvision() const;
+  const std::string &GetManifestFile() const;
   std::chrono::seconds GetMeasurementPeriod() const;
   std::chrono::seconds GetRetryConnectServerPeriod() const;
+  size_t GetPipelineWindow() const;
+  const ConnectionPolicy &GetConnectionPolicy() const;
+  const DrainPolicy &GetDrainPolicy() const;
+  const AdaptiveSamplingPolicy &GetSamplingPolicy() const;
+  const OversamplingPolicy &GetOversamplingPolicy() const;
+  const DeadbandPolicy &GetDeadbandPolicy() const;
+  const ChannelFaultPolicy &GetFaultPolicy() const;
+  const BusRecoveryPolicy &GetBusRecoveryPolicy() const;
+  const Ads1115Policy &GetAdcPolicy() const;
+  const ReconnectPolicy &GetReconnectPolicy() const;
+  const std::string &GetTlsSessionCacheFile() const;
+  const std::string &GetSpoolFile() const;
+  size_t GetSpoolCapacity() const;
+  const std::string &GetControlSocket() const;
+  bool ShouldSimulateHardware() const;
+  const SimulationProfile &GetSimulationProfile() const;
 
 private:
   std::string ipv4_;
@@ -79,8 +126,26 @@ private:
   double ceiling_;
   double measurement_;
   std::string config_file_;
+  bool should_provision_;
+  std::string manifest_file_;
   std::chrono::seconds measurement_period_;
   std::chrono::seconds retry_connect_server_period_;
+  size_t pipeline_window_;
+  ConnectionPolicy connection_policy_;
+  DrainPolicy drain_policy_;
+  AdaptiveSamplingPolicy sampling_policy_;
+  OversamplingPolicy oversampling_policy_;
+  DeadbandPolicy deadband_policy_;
+  ChannelFaultPolicy fault_policy_;
+  BusRecoveryPolicy bus_recovery_policy_;
+  Ads1115Policy adc_policy_;
+  ReconnectPolicy reconnect_policy_;
+  std::string tls_session_cache_file_;
+  std::string spool_file_;
+  size_t spool_capacity_;
+  std::string control_socket_;
+  bool simulate_hardware_;
+  SimulationProfile simulation_profile_;
 };
 
 }; // namespace organicdump
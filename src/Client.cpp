@@ -1,16 +1,16 @@
 #include "Client.h"
 
 #include <cassert>
+#include <chrono>
 #include <cstdint>
 #include <memory>
 #include <string>
 
-#include "NetworkUtilities.h"
+#include "ByteStream.h"
 #include "OrganicDumpProtoMessage.h"
 #include "ProtobufServer.h"
-#include "TlsClient.h"
-#include "TlsClientFactory.h"
-#include "TlsConnection.h"
+#include "TlsContext.h"
+#include "TlsStream.h"
 
 namespace
 {
@@ -23,10 +23,17 @@ using organicdump_proto::PeripheralMeta;
 using organicdump_proto::RegisterRpi;
 using organicdump_proto::RegisterSoilMoistureSensor;
 using organicdump_proto::UpdatePeripheralOwnership;
-using network::WaitPolicy;
-using network::TlsClient;
-using network::TlsClientFactory;
-using network::TlsConnection;
+
+// Lockstep request/response unless the caller asks for a deeper pipeline.
+constexpr size_t DEFAULT_PIPELINE_WINDOW = 1;
+
+void SetError(organicdump::ClientError error, organicdump::ClientError *out_error)
+{
+  if (out_error)
+  {
+    *out_error = error;
+  }
+}
 } // namespace
 
 namespace organicdump
@@ -38,36 +45,100 @@ bool Client::Create(
     std::string cert_file,
     std::string key_file,
     std::string ca_file,
-    Client *out_client)
+    Client *out_client,
+    ClientError *out_error)
+{
+  return Create(
+      std::move(ipv4),
+      port,
+      std::move(cert_file),
+      std::move(key_file),
+      std::move(ca_file),
+      nullptr,
+      out_client,
+      out_error);
+}
+
+bool Client::Create(
+    std::string ipv4,
+    int32_t port,
+    std::string cert_file,
+    std::string key_file,
+    std::string ca_file,
+    TlsSessionCache *session_cache,
+    Client *out_client,
+    ClientError *out_error)
 {
   assert(out_client);
 
-  TlsClientFactory client_factory;
-  TlsClient tls_client;
-  if (!client_factory.Create(
+  // Credentials that don't load are a local problem. Leave the error at NONE
+  // rather than blame the network or the server.
+  SetError(ClientError::NONE, out_error);
+  TlsContext tls_context;
+  if (!TlsContext::Create(
           std::move(ipv4),
           port,
           std::move(cert_file),
           std::move(key_file),
           std::move(ca_file),
-          WaitPolicy::BLOCKING,
-          &tls_client))
+          &tls_context))
   {
     LOG(ERROR) << "Failed to initialize TLS client";
     return false;
   }
 
-  TlsConnection cxn;
-  if (!tls_client.Connect(&cxn))
+  return Create(&tls_context, session_cache, out_client, out_error);
+}
+
+bool Client::Create(
+    TlsContext *tls_context,
+    TlsSessionCache *session_cache,
+    Client *out_client,
+    ClientError *out_error)
+{
+  assert(tls_context);
+  assert(out_client);
+
+  SetError(ClientError::NONE, out_error);
+  SSL_SESSION *session = session_cache ? session_cache->Lookup() : nullptr;
+  std::unique_ptr<TlsStream> stream{new TlsStream};
+  if (!tls_context->Connect(stream.get(), session))
   {
     LOG(ERROR) << "Failed to connect to server";
+    if (session && stream->IsHandshakeRejected())
+    {
+      // Don't keep offering a session that may be what the server choked on.
+      // A transport failure says nothing about the session, so it's kept.
+      session_cache->Invalidate();
+    }
+    SetError(ClientError::NETWORK, out_error);
     return false;
   }
 
-  ProtobufServer server_proxy{std::move(cxn)};
-  Client client{std::move(server_proxy)};
+  return Create(std::move(stream), session_cache, out_client, out_error);
+}
 
-  if (!client.SendHello())
+bool Client::Create(
+    std::unique_ptr<ByteStream> stream,
+    TlsSessionCache *session_cache,
+    Client *out_client,
+    ClientError *out_error)
+{
+  assert(stream);
+  assert(out_client);
+
+  SetError(ClientError::NONE, out_error);
+  if (session_cache && stream->GetSsl())
+  {
+    session_cache->RecordHandshake(SSL_session_reused(stream->GetSsl()) == 1);
+  }
+
+  ProtobufServer server_proxy{std::move(stream)};
+  Client client{std::move(server_proxy), session_cache};
+
+  // A server that refuses the session shows up here rather than on the
+  // first request.
+  if (!client.SendHello(out_error))
   {
     LOG(ERROR) << "Failed to send hello to server";
     return false;
@@ -78,11 +149,18 @@ bool Client::Create(
   return true;
 }
 
-Client::Client() : is_initialized_{false} {}
+Client::Client()
+  : is_initialized_{false},
+    session_cache_{nullptr},
+    pipeline_window_{DEFAULT_PIPELINE_WINDOW},
+    pending_request_count_{0} {}
 
-Client::Client(ProtobufServer server)
+Client::Client(ProtobufServer server, TlsSessionCache *session_cache)
   : is_initialized_{true},
-    server_{std::move(server)} {}
+    server_{std::move(server)},
+    session_cache_{session_cache},
+    pipeline_window_{DEFAULT_PIPELINE_WINDOW},
+    pending_request_count_{0} {}
 
 Client::Client(Client &&other)
 {
@@ -105,23 +183,13 @@ Client::~Client()
 bool Client::SendRegisterRpi(
     std::string name,
     std::string location,
-    size_t *out_rpi_id)
+    size_t *out_rpi_id,
+    ClientError *out_error)
 {
   assert(out_rpi_id);
 
-  organicdump_proto::RegisterRpi register_rpi_msg;
-  register_rpi_msg.set_name(std::move(name));
-  register_rpi_msg.set_location(std::move(location));
-
-  OrganicDumpProtoMessage msg{std::move(register_rpi_msg)};
-
-  if (!server_.Write(&msg))
-  {
-    LOG(ERROR) << "Failed to send RegisterRpi message to server";
-    return false;
-  }
-
-  if (!HandleBasicResponse(out_rpi_id))
+  if (!PostRegisterRpi(std::move(name), std::move(location)) ||
+      !CompleteRequest(out_rpi_id, out_error))
   {
     LOG(ERROR) << "Failed on BASIC_RESPONSE for REGISTER_RPI";
     return false;
@@ -135,142 +203,402 @@ bool Client::SendRegisterSoilMoistureSensor(
     std::string location,
     double floor,
     double ceiling,
-    size_t *out_peripheral_id)
+    size_t *out_peripheral_id,
+    ClientError *out_error)
 {
   assert(out_peripheral_id);
 
   LOG(INFO) << "Register soil moisture sensor: name=" << name;
 
-  PeripheralMeta meta;
-  meta.set_name(name);
-  meta.set_location(location);
-
-  RegisterSoilMoistureSensor register_sensor_req;
-  register_sensor_req.set_allocated_meta(&meta);
-  register_sensor_req.set_floor(floor);
-  register_sensor_req.set_ceil(ceiling);
-  OrganicDumpProtoMessage req_msg{std::move(register_sensor_req)};
-
-  if (!server_.Write(&req_msg))
+  if (!PostRegisterSoilMoistureSensor(
+        std::move(name),
+        std::move(location),
+        floor,
+        ceiling) ||
+      !CompleteRequest(out_peripheral_id, out_error))
   {
-    LOG(ERROR) << "Failed to send REGISTER_SOIL_MOISTURE_SENSOR  message to server";
+    LOG(ERROR) << "Failed on BASIC_RESPONSE for REGISTER_SOIL_MOISTURE_SENSOR";
     return false;
   }
 
-  if (!HandleBasicResponse(out_peripheral_id))
+  return true;
+}
+
+bool Client::SetPeripheralParent(
+    size_t peripheral_id,
+    size_t rpi_id,
+    ClientError *out_error)
+{
+  if (!PostPeripheralParent(peripheral_id, rpi_id) ||
+      !CompleteRequest(nullptr, out_error))
   {
-    LOG(ERROR) << "Failed on BASIC_RESPONSE for REGISTER_SOIL_MOISTURE_SENSOR";
+    LOG(ERROR) << "Failed to read BASIC_RESPONSE for UPDATE_PERIPHERAL_OWNERSHIP";
     return false;
   }
 
   return true;
 }
 
-bool Client::SetPeripheralParent(size_t peripheral_id, size_t rpi_id)
+bool Client::PostRegisterRpi(std::string name, std::string location)
 {
+  assert(CanPostRequest());
+
+  RegisterRpi register_rpi_msg;
+  register_rpi_msg.set_name(std::move(name));
+  register_rpi_msg.set_location(std::move(location));
+  server_.Queue(MessageType::REGISTER_RPI, register_rpi_msg);
+  ++pending_request_count_;
+  return true;
+}
+
+bool Client::PostRegisterSoilMoistureSensor(
+    std::string name,
+    std::string location,
+    double floor,
+    double ceiling)
+{
+  assert(CanPostRequest());
+
+  RegisterSoilMoistureSensor register_sensor_req;
+  PeripheralMeta *meta = register_sensor_req.mutable_meta();
+  meta->set_name(std::move(name));
+  meta->set_location(std::move(location));
+  register_sensor_req.set_floor(floor);
+  register_sensor_req.set_ceil(ceiling);
+  server_.Queue(
+      MessageType::REGISTER_SOIL_MOISTURE_SENSOR,
+      register_sensor_req);
+  ++pending_request_count_;
+  return true;
+}
+
+bool Client::PostPeripheralParent(size_t peripheral_id, size_t rpi_id)
+{
+  assert(CanPostRequest());
+
   UpdatePeripheralOwnership update_req;
   update_req.set_peripheral_id(peripheral_id);
   update_req.set_rpi_id(rpi_id);
   update_req.set_orphan_peripheral(false);
-  OrganicDumpProtoMessage msg{std::move(update_req)};
+  server_.Queue(MessageType::UPDATE_PERIPHERAL_OWNERSHIP, update_req);
+  ++pending_request_count_;
+  return true;
+}
 
-  if (!server_.Write(&msg))
+bool Client::SendSoilMoistureMeasurement(
+    size_t sensor_id,
+    double measurement,
+    ClientError *out_error)
+{
+  LOG(INFO) << "Soil Moisture Measurement: sensor_id="
+            << sensor_id << ", measurement=" << measurement;
+
+  auto now = std::chrono::steady_clock::now();
+  QueueSoilMoistureMeasurement(
+      SoilMoistureMeasurement{
+          sensor_id,
+          measurement,
+          now,
+          std::chrono::system_clock::now(),
+          std::chrono::microseconds{0}});
+
+  size_t measurement_id;
+  if (!HandleBasicResponse(&measurement_id, nullptr, nullptr, out_error))
   {
-    LOG(ERROR) << "Failed to send UPDATE_PERIPHERAL_OWNERSHIP message";
+    LOG(ERROR) << "Failed to read BASIC_RESPONSE for SEND_SOIL_MOISTURE_MEASUREMENT";
     return false;
   }
 
-  if (!HandleBasicResponse())
+  LOG(INFO) << "Id of soil moisture measurement is " << measurement_id;
+  return true;
+}
+
+bool Client::SendSoilMoistureMeasurements(
+    const std::vector<SoilMoistureMeasurement> &measurements,
+    std::vector<size_t> *out_measurement_ids,
+    ClientError *out_error)
+{
+  assert(out_measurement_ids);
+  assert(pending_request_count_ == 0);
+
+  SetError(ClientError::NONE, out_error);
+  out_measurement_ids->clear();
+  out_measurement_ids->reserve(measurements.size());
+  size_t next_request = 0;
+
+  while (out_measurement_ids->size() < measurements.size())
+  {
+    // Top up the pipeline before blocking on the oldest outstanding response.
+    while (next_request < measurements.size() && CanPostRequest())
+    {
+      if (!PostSoilMoistureMeasurement(measurements[next_request]))
+      {
+        return false;
+      }
+      ++next_request;
+    }
+
+    size_t measurement_id;
+    if (!CompleteRequest(&measurement_id, out_error))
+    {
+      LOG(ERROR) << "Failed to read BASIC_RESPONSE for pipelined "
+                 << "SEND_SOIL_MOISTURE_MEASUREMENT for sensor "
+                 << measurements[out_measurement_ids->size()].sensor_id;
+      return false;
+    }
+    out_measurement_ids->push_back(measurement_id);
+  }
+
+  return true;
+}
+
+void Client::SetPipelineWindow(size_t window)
+{
+  assert(window > 0);
+  pipeline_window_ = window;
+}
+
+size_t Client::GetPipelineWindow() const
+{
+  return pipeline_window_;
+}
+
+bool Client::PostSoilMoistureMeasurement(
+    const SoilMoistureMeasurement &measurement)
+{
+  assert(CanPostRequest());
+
+  QueueSoilMoistureMeasurement(measurement);
+  ++pending_request_count_;
+  return true;
+}
+
+bool Client::CompleteRequest(size_t *out_id, ClientError *out_error)
+{
+  assert(pending_request_count_ > 0);
+
+  if (!HandleBasicResponse(out_id, nullptr, nullptr, out_error))
   {
-    LOG(ERROR) << "Failed to read BASIC_RESPONSE for UPDATE_PERIPHERAL_OWNERSHIP";
     return false;
   }
 
+  --pending_request_count_;
   return true;
 }
 
-bool Client::SendSoilMoistureMeasurement(size_t sensor_id, double measurement)
+bool Client::TryCompleteRequest(
+    size_t *out_id,
+    bool *out_completed,
+    ClientError *out_error)
 {
-  LOG(INFO) << "Soil Moisture Measurement: sensor_id="
-            << sensor_id << ", measurement=" << measurement;
+  assert(out_completed);
+  assert(pending_request_count_ > 0);
 
-  organicdump_proto::SendSoilMoistureMeasurement req;
-  req.set_sensor_id(sensor_id);
-  req.set_value(measurement);
-  OrganicDumpProtoMessage msg{std::move(req)};
+  *out_completed = false;
 
-  if (!server_.Write(&msg))
+  if (!Flush(out_error))
   {
-    LOG(ERROR) << "Failed to send SEND_SOIL_MOISTURE_MEASUREMENT message";
     return false;
   }
 
-  size_t measurement_id;
-  if (!HandleBasicResponse(&measurement_id))
+  bool has_message = false;
+  bool cxn_closed = false;
+  if (!server_.TryRead(&response_, &has_message, &cxn_closed))
   {
-    LOG(ERROR) << "Failed to read BASIC_RESPONSE for UPDATE_PERIPHERAL_OWNERSHIP";
+    LOG(ERROR) << "Failed to read message from server. Expecting BASIC_RESPONSE";
+    SetError(
+        cxn_closed ? ClientError::CONNECTION_CLOSED : ClientError::NETWORK,
+        out_error);
     return false;
   }
 
-  LOG(INFO) << "Id of soil moisture measurement is " << measurement_id;
+  if (!has_message)
+  {
+    return true;
+  }
+
+  // A refused request is answered and done with; only its result is bad.
+  ClientError error = ClientError::NONE;
+  if (!ProcessBasicResponse(response_, out_id, nullptr, nullptr, &error) &&
+      error != ClientError::REJECTED)
+  {
+    SetError(error, out_error);
+    return false;
+  }
+
+  --pending_request_count_;
+  *out_completed = true;
+  SetError(error, out_error);
   return true;
 }
 
-bool Client::SendHello()
+bool Client::Flush(ClientError *out_error)
 {
-  Hello hello_msg;
-  hello_msg.set_type(ClientType::CONTROL);
-  OrganicDumpProtoMessage msg{std::move(hello_msg)};
+  SetError(ClientError::NONE, out_error);
 
-  if (!server_.Write(&msg)) {
-    LOG(ERROR) << "Failed to send HELLO message to server";
+  bool cxn_closed = false;
+  if (!server_.Flush(&cxn_closed))
+  {
+    LOG(ERROR) << "Failed to flush queued requests to server";
+    SetError(
+        cxn_closed ? ClientError::CONNECTION_CLOSED : ClientError::NETWORK,
+        out_error);
     return false;
   }
-
   return true;
 }
 
+size_t Client::GetWrittenFrameCount() const
+{
+  return server_.GetWrittenFrameCount();
+}
+
+size_t Client::GetWriteCallCount() const
+{
+  return server_.GetWriteCallCount();
+}
+
+size_t Client::GetPendingRequestCount() const
+{
+  return pending_request_count_;
+}
+
+bool Client::CanPostRequest() const
+{
+  return is_initialized_ && pending_request_count_ < pipeline_window_;
+}
+
+bool Client::HasBufferedResponse() const
+{
+  return is_initialized_ && server_.HasBufferedMessage();
+}
+
+bool Client::WantsWrite() const
+{
+  return is_initialized_ && server_.WantsWrite();
+}
+
+int Client::GetFd() const
+{
+  return server_.GetFd();
+}
+
+bool Client::EnableKeepalive(std::chrono::seconds period)
+{
+  assert(is_initialized_);
+  return server_.EnableKeepalive(period);
+}
+
+bool Client::IsConnected() const
+{
+  return is_initialized_;
+}
+
+void Client::Close()
+{
+  CloseResources();
+}
+
+bool Client::SendHello(ClientError *out_error)
+{
+  Hello hello_msg;
+  hello_msg.set_type(ClientType::CONTROL);
+  server_.Queue(MessageType::HELLO, hello_msg);
+  return Flush(out_error);
+}
+
+void Client::QueueSoilMoistureMeasurement(
+    const SoilMoistureMeasurement &measurement)
+{
+  // SendSoilMoistureMeasurement has no time fields yet, so capture times stop
+  // here until the protocol grows them. See SENDS_CAPTURE_TIMES.
+  measurement_request_.set_sensor_id(measurement.sensor_id);
+  measurement_request_.set_value(measurement.value);
+  server_.Queue(MessageType::SEND_SOIL_MOISTURE_MEASUREMENT, measurement_request_);
+}
+
 bool Client::HandleBasicResponse(
     size_t *out_id,
     organicdump_proto::ErrorCode *out_error_code,
-    std::string *out_error_string)
+    std::string *out_error_string,
+    ClientError *out_error)
 {
-  OrganicDumpProtoMessage resp;
-  if (!server_.Read(&resp))
+  if (!Flush(out_error))
+  {
+    return false;
+  }
+
+  bool cxn_closed = false;
+  if (!server_.Read(&response_, &cxn_closed))
   {
     LOG(ERROR) << "Failed to read message from server. Expecting BASIC_RESPONSE";
+    SetError(
+        cxn_closed ? ClientError::CONNECTION_CLOSED : ClientError::NETWORK,
+        out_error);
     return false;
   }
 
+  return ProcessBasicResponse(
+      response_,
+      out_id,
+      out_error_code,
+      out_error_string,
+      out_error);
+}
+
+bool Client::ProcessBasicResponse(
+    const OrganicDumpProtoMessage &resp,
+    size_t *out_id,
+    organicdump_proto::ErrorCode *out_error_code,
+    std::string *out_error_string,
+    ClientError *out_error)
+{
+  SetError(ClientError::NONE, out_error);
+
   if (resp.type != MessageType::BASIC_RESPONSE)
   {
     LOG(ERROR) << "Received unexpected message type "
                << organicdump_proto::MessageType_Name(resp.type);
+    SetError(ClientError::PROTOCOL, out_error);
     return false;
   }
 
   const BasicResponse &basic_response = resp.basic_response;
-  if (out_id && !basic_response.has_id())
+  if (out_error_code)
   {
-    LOG(ERROR) << "BASIC_RESPONSE message is missing its |id| field";
-    return false;
+    *out_error_code = basic_response.code();
   }
 
-  LOG(INFO) << "Received basic response with ID: " << basic_response.id();
+  if (out_error_string && basic_response.has_message())
+  {
+    *out_error_string = basic_response.message();
+  }
 
-  if (out_id)
+  if (basic_response.has_code() && basic_response.code() != ErrorCode::OK)
   {
-    *out_id = basic_response.id();
+    LOG(ERROR) << "Server answered "
+               << organicdump_proto::ErrorCode_Name(basic_response.code())
+               << ": " << basic_response.message();
+    SetError(
+        basic_response.code() == ErrorCode::INVALID_ARGUMENT ?
+            ClientError::REJECTED :
+            ClientError::SERVER,
+        out_error);
+    return false;
   }
 
-  if (out_error_code)
+  if (out_id && !basic_response.has_id())
   {
-    *out_error_code = basic_response.code();
+    LOG(ERROR) << "BASIC_RESPONSE message is missing its |id| field";
+    SetError(ClientError::PROTOCOL, out_error);
+    return false;
   }
 
-  if (out_error_string && basic_response.has_message())
+  VLOG(1) << "Received basic response with ID: " << basic_response.id();
+
+  if (out_id)
   {
-    *out_error_string = basic_response.message();
+    *out_id = basic_response.id();
   }
 
   return true;
@@ -278,7 +606,14 @@ bool Client::HandleBasicResponse(
 
 void Client::CloseResources()
 {
+  if (is_initialized_ && session_cache_ && server_.GetSsl())
+  {
+    // By now the server has sent any post-handshake session tickets.
+    session_cache_->Store(server_.GetSsl());
+  }
+
   is_initialized_ = false;
+  pending_request_count_ = 0;
   server_ = ProtobufServer{};
 }
 
@@ -288,6 +623,12 @@ void Client::StealResources(Client *other)
   is_initialized_ = other->is_initialized_;
   other->is_initialized_ = false;
   server_ = std::move(other->server_);
+  session_cache_ = other->session_cache_;
+  pipeline_window_ = other->pipeline_window_;
+  pending_request_count_ = other->pending_request_count_;
+  other->pending_request_count_ = 0;
+  measurement_request_.Swap(&other->measurement_request_);
+  response_ = std::move(other->response_);
 }
 
 } // namespace organicdump
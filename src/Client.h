@@ -1,12 +1,21 @@
 #ifndef ORGANICDUMP_CLIENT_CLIENT_H
 #define ORGANICDUMP_CLIENT_CLIENT_H
 
+#include <chrono>
 #include <cstdint>
 #include <memory>
 #include <string>
+#include <vector>
 
+#include "organic_dump.pb.h"
+
+#include "ByteStream.h"
+#include "ClientError.h"
+#include "OrganicDumpProtoMessage.h"
 #include "ProtobufServer.h"
-#include "TlsClient.h"
+#include "SoilMoistureMeasurement.h"
+#include "TlsContext.h"
+#include "TlsSessionCache.h"
 
 namespace organicdump
 {
@@ -14,40 +23,164 @@ namespace organicdump
 class Client
 {
 public:
+  /**
+   * False while SendSoilMoistureMeasurement has no fields for capture times.
+   * The server then stamps each reading with its arrival time, so only
+   * readings uploaded soon after they're taken land in the right place.
+   */
+  static constexpr bool SENDS_CAPTURE_TIMES = false;
+
   static bool Create(
       std::string ipv4,
       int32_t port,
       std::string cert_file,
       std::string key_file,
       std::string ca_file,
-      Client *out_client);
+      Client *out_client,
+      ClientError *out_error=nullptr);
+
+  /**
+   * Same as above, but offers the session held in |session_cache| for
+   * resumption and refreshes the cache when the connection closes.
+   * |session_cache| must outlive the client.
+   */
+  static bool Create(
+      std::string ipv4,
+      int32_t port,
+      std::string cert_file,
+      std::string key_file,
+      std::string ca_file,
+      TlsSessionCache *session_cache,
+      Client *out_client,
+      ClientError *out_error=nullptr);
+
+  /**
+   * Connects through a prebuilt |tls_context| so that the credentials aren't
+   * reloaded for every connection. |session_cache| may be null.
+   */
+  static bool Create(
+      TlsContext *tls_context,
+      TlsSessionCache *session_cache,
+      Client *out_client,
+      ClientError *out_error=nullptr);
+
+  /**
+   * Starts a session on a |stream| that is already connected, e.g. one
+   * whose handshake ClientConnector ran without blocking. HELLO has been
+   * written by the time this returns.
+   */
+  static bool Create(
+      std::unique_ptr<ByteStream> stream,
+      TlsSessionCache *session_cache,
+      Client *out_client,
+      ClientError *out_error=nullptr);
 
 public:
   Client();
-  Client(ProtobufServer server);
+  Client(ProtobufServer server, TlsSessionCache *session_cache=nullptr);
   Client(Client &&other);
   Client &operator=(Client &&other);
   ~Client();
 
+  /**
+   * Blocking request/response calls. On failure, |out_error| says what went
+   * wrong, as for the split interface below.
+   */
   bool SendRegisterRpi(
       std::string name,
       std::string location,
-      size_t *out_rpi_id);
+      size_t *out_rpi_id,
+      ClientError *out_error=nullptr);
   bool SendRegisterSoilMoistureSensor(
       std::string name,
       std::string location,
       double floor,
       double ceiling,
-      size_t *out_peripheral_id);
-  bool SetPeripheralParent(size_t peripheral_id, size_t rpi_id);
-  bool SendSoilMoistureMeasurement(size_t sensor_id, double measurement);
+      size_t *out_peripheral_id,
+      ClientError *out_error=nullptr);
+  bool SetPeripheralParent(
+      size_t peripheral_id,
+      size_t rpi_id,
+      ClientError *out_error=nullptr);
+  bool SendSoilMoistureMeasurement(
+      size_t sensor_id,
+      double measurement,
+      ClientError *out_error=nullptr);
+
+  /**
+   * Uploads |measurements| with up to |pipeline_window_| requests in flight.
+   * The server answers requests in order, so responses are matched to
+   * requests first-in-first-out. On success, |out_measurement_ids| holds the
+   * assigned ids in the same order as |measurements|.
+   */
+  bool SendSoilMoistureMeasurements(
+      const std::vector<SoilMoistureMeasurement> &measurements,
+      std::vector<size_t> *out_measurement_ids,
+      ClientError *out_error=nullptr);
+  void SetPipelineWindow(size_t window);
+  size_t GetPipelineWindow() const;
+
+  /**
+   * Split request/response interface for event loops. PostSoilMoistureMeasurement()
+   * queues a request without waiting for its response. Flush() writes the
+   * queued requests as far as the socket takes them without blocking. While
+   * WantsWrite(), flush again once the server fd is writable. Once the
+   * server fd is readable, CompleteRequest() consumes the response to the
+   * oldest posted request, flushing first if needed.
+   *
+   * On failure, |out_error| says what went wrong, so the caller can tell a
+   * clean close from a network fault or a server error.
+   *
+   * Registrations and ownership updates can be posted the same way, which
+   * lets provisioning pipeline a whole rig over one connection.
+   */
+  bool PostRegisterRpi(std::string name, std::string location);
+  bool PostRegisterSoilMoistureSensor(
+      std::string name,
+      std::string location,
+      double floor,
+      double ceiling);
+  bool PostPeripheralParent(size_t peripheral_id, size_t rpi_id);
+  bool PostSoilMoistureMeasurement(const SoilMoistureMeasurement &measurement);
+  bool Flush(ClientError *out_error=nullptr);
+  bool CompleteRequest(size_t *out_id=nullptr, ClientError *out_error=nullptr);
+
+  /**
+   * Non-blocking form of CompleteRequest() for use once the server fd is
+   * readable. |out_completed| is false if the response hasn't fully arrived.
+   * A request the server refused as invalid still completes, with
+   * |out_error| set to REJECTED and no id.
+   */
+  bool TryCompleteRequest(
+      size_t *out_id,
+      bool *out_completed,
+      ClientError *out_error=nullptr);
+  size_t GetPendingRequestCount() const;
+  bool CanPostRequest() const;
+  bool HasBufferedResponse() const;
+  bool WantsWrite() const;
+  int GetFd() const;
+  size_t GetWrittenFrameCount() const;
+  size_t GetWriteCallCount() const;
+
+  bool EnableKeepalive(std::chrono::seconds period);
+  bool IsConnected() const;
+  void Close();
 
 private:
-  bool SendHello();
+  bool SendHello(ClientError *out_error);
+  void QueueSoilMoistureMeasurement(const SoilMoistureMeasurement &measurement);
   bool HandleBasicResponse(
       size_t *out_id=nullptr,
       organicdump_proto::ErrorCode *out_error_code=nullptr,
-      std::string *out_error_string=nullptr);
+      std::string *out_error_string=nullptr,
+      ClientError *out_error=nullptr);
+  bool ProcessBasicResponse(
+      const OrganicDumpProtoMessage &resp,
+      size_t *out_id,
+      organicdump_proto::ErrorCode *out_error_code,
+      std::string *out_error_string,
+      ClientError *out_error);
   void CloseResources();
   void StealResources(Client *other);
 
@@ -58,6 +191,14 @@ private:
 private:
   bool is_initialized_;
   ProtobufServer server_;
+  TlsSessionCache *session_cache_;
+  size_t pipeline_window_;
+  size_t pending_request_count_;
+
+  // Reused on every upload and response so the warm upload path doesn't
+  // allocate.
+  organicdump_proto::SendSoilMoistureMeasurement measurement_request_;
+  OrganicDumpProtoMessage response_;
 };
 
 } // namespace organicdump
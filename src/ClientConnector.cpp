@@ -0,0 +1,161 @@
+#include "ClientConnector.h"
+
+#include <sys/epoll.h>
+
+#include <cassert>
+#include <chrono>
+#include <memory>
+#include <utility>
+
+#include <glog/logging.h>
+
+namespace
+{
+// A connect still unfinished after this long is abandoned. The kernel alone
+// would keep retrying SYNs for minutes, and a server can accept the TCP
+// connection and then never answer the handshake.
+constexpr std::chrono::seconds CONNECT_TIMEOUT{15};
+
+uint32_t GetConnectEvents(const organicdump::TlsStream &stream)
+{
+  return stream.WantsWrite() ? EPOLLOUT : EPOLLIN;
+}
+} // namespace
+
+namespace organicdump
+{
+
+ClientConnector::ClientConnector()
+  : event_loop_{nullptr},
+    session_cache_{nullptr},
+    out_client_{nullptr},
+    deadline_timer_{-1},
+    offered_session_{false} {}
+
+ClientConnector::~ClientConnector()
+{
+  Cancel();
+}
+
+bool ClientConnector::Start(
+    EventLoop *event_loop,
+    TlsContext *tls_context,
+    TlsSessionCache *session_cache,
+    Client *out_client,
+    DoneCallback on_done)
+{
+  assert(event_loop);
+  assert(tls_context);
+  assert(out_client);
+  assert(!IsConnecting());
+
+  SSL_SESSION *session = session_cache ? session_cache->Lookup() : nullptr;
+  std::unique_ptr<TlsStream> stream{new TlsStream};
+  if (!tls_context->StartConnect(stream.get(), session))
+  {
+    LOG(ERROR) << "Failed to start connecting to server";
+    return false;
+  }
+
+  if (!event_loop->AddTimer([this]()
+        {
+          LOG(ERROR) << "Timed out connecting to server";
+          Finish(ClientError::NETWORK);
+        },
+        &deadline_timer_))
+  {
+    return false;
+  }
+
+  int fd = stream->GetFd();
+  if (!event_loop->AddFd(
+        fd,
+        GetConnectEvents(*stream),
+        [this](uint32_t) { OnSocketEvent(); }))
+  {
+    event_loop->RemoveTimer(deadline_timer_);
+    deadline_timer_ = -1;
+    return false;
+  }
+
+  event_loop->ArmTimer(deadline_timer_, CONNECT_TIMEOUT);
+
+  event_loop_ = event_loop;
+  session_cache_ = session_cache;
+  out_client_ = out_client;
+  on_done_ = std::move(on_done);
+  stream_ = std::move(stream);
+  offered_session_ = session != nullptr;
+  return true;
+}
+
+void ClientConnector::Cancel()
+{
+  if (!IsConnecting())
+  {
+    return;
+  }
+
+  event_loop_->RemoveFd(stream_->GetFd());
+  event_loop_->RemoveTimer(deadline_timer_);
+  deadline_timer_ = -1;
+  stream_.reset();
+  on_done_ = nullptr;
+}
+
+bool ClientConnector::IsConnecting() const
+{
+  return stream_ != nullptr;
+}
+
+void ClientConnector::OnSocketEvent()
+{
+  // Errors and hangups are left for the handshake to report, since it knows
+  // which step failed.
+  bool connected = false;
+  if (!stream_->ContinueConnect(&connected))
+  {
+    if (offered_session_ && stream_->IsHandshakeRejected())
+    {
+      // Don't keep offering a session that may be what the server choked on.
+      // A refused connect or a timeout says nothing about the session.
+      session_cache_->Invalidate();
+    }
+    Finish(ClientError::NETWORK);
+    return;
+  }
+
+  if (connected)
+  {
+    Finish(ClientError::NONE);
+    return;
+  }
+
+  if (!event_loop_->ModifyFd(stream_->GetFd(), GetConnectEvents(*stream_)))
+  {
+    Finish(ClientError::NETWORK);
+  }
+}
+
+void ClientConnector::Finish(ClientError error)
+{
+  assert(IsConnecting());
+
+  event_loop_->RemoveFd(stream_->GetFd());
+  event_loop_->RemoveTimer(deadline_timer_);
+  deadline_timer_ = -1;
+
+  std::unique_ptr<TlsStream> stream = std::move(stream_);
+  DoneCallback on_done = std::move(on_done_);
+  on_done_ = nullptr;
+
+  if (error == ClientError::NONE)
+  {
+    Client::Create(std::move(stream), session_cache_, out_client_, &error);
+  }
+
+  // Last, since the callback may start the next connect.
+  on_done(error);
+}
+
+} // namespace organicdump
@@ -0,0 +1,74 @@
+#ifndef ORGANICDUMP_CLIENT_CLIENTCONNECTOR_H
+#define ORGANICDUMP_CLIENT_CLIENTCONNECTOR_H
+
+#include <functional>
+#include <memory>
+
+#include "Client.h"
+#include "ClientError.h"
+#include "EventLoop.h"
+#include "TlsContext.h"
+#include "TlsSessionCache.h"
+#include "TlsStream.h"
+
+namespace organicdump
+{
+
+/**
+ * Opens a Client session from an event loop. The TCP connect and TLS
+ * handshake advance as the socket becomes ready, so the loop keeps serving
+ * other sessions, samplers and timers while a server is slow to answer.
+ */
+class ClientConnector
+{
+public:
+  /**
+   * Called from the loop when the connect ends. On ClientError::NONE the
+   * client passed to Start() is connected.
+   */
+  using DoneCallback = std::function<void(ClientError error)>;
+
+public:
+  ClientConnector();
+  ~ClientConnector();
+
+  /**
+   * Starts connecting |out_client|. Returns false, without calling
+   * |on_done|, if the connect couldn't be started. |out_client| must stay
+   * put until |on_done| runs or Cancel() is called.
+   */
+  bool Start(
+      EventLoop *event_loop,
+      TlsContext *tls_context,
+      TlsSessionCache *session_cache,
+      Client *out_client,
+      DoneCallback on_done);
+
+  /**
+   * Abandons a connect in progress. |on_done| isn't called.
+   */
+  void Cancel();
+
+  bool IsConnecting() const;
+
+private:
+  void OnSocketEvent();
+  void Finish(ClientError error);
+
+private:
+  ClientConnector(const ClientConnector &other) = delete;
+  ClientConnector &operator=(const ClientConnector &other) = delete;
+
+private:
+  EventLoop *event_loop_;
+  TlsSessionCache *session_cache_;
+  Client *out_client_;
+  DoneCallback on_done_;
+  std::unique_ptr<TlsStream> stream_;
+  EventLoop::TimerId deadline_timer_;
+  bool offered_session_;
+};
+
+} // namespace organicdump
+
+#endif // ORGANICDUMP_CLIENT_CLIENTCONNECTOR_H
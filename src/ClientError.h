@@ -0,0 +1,49 @@
+#ifndef ORGANICDUMP_CLIENT_CLIENTERROR_H
+#define ORGANICDUMP_CLIENT_CLIENTERROR_H
+
+namespace organicdump
+{
+
+/**
+ * Why a client call failed, so callers can pick a recovery that fits instead
+ * of treating every failure alike.
+ */
+enum class ClientError
+{
+  NONE,
+  // The server closed the session cleanly. Usually a restart or idle timeout.
+  CONNECTION_CLOSED,
+  // Connecting, reading or writing failed.
+  NETWORK,
+  // The server sent something the client doesn't understand.
+  PROTOCOL,
+  // The server answered with SERVER_ERROR.
+  SERVER,
+  // The server refused the request as invalid. Resending it won't help, but
+  // the session is still good.
+  REJECTED,
+};
+
+inline const char *GetClientErrorName(ClientError error)
+{
+  switch (error)
+  {
+    case ClientError::NONE:
+      return "none";
+    case ClientError::CONNECTION_CLOSED:
+      return "connection closed";
+    case ClientError::NETWORK:
+      return "network error";
+    case ClientError::PROTOCOL:
+      return "protocol error";
+    case ClientError::SERVER:
+      return "server error";
+    case ClientError::REJECTED:
+    default:
+      return "rejected";
+  }
+}
+
+} // namespace organicdump
+
+#endif // ORGANICDUMP_CLIENT_CLIENTERROR_H
@@ -0,0 +1,32 @@
+#ifndef ORGANICDUMP_CLIENT_CONNECTIONPOLICY_H
+#define ORGANICDUMP_CLIENT_CONNECTIONPOLICY_H
+
+#include <chrono>
+
+namespace organicdump
+{
+
+/**
+ * Controls how long the monitoring daemon holds its server session open.
+ */
+struct ConnectionPolicy
+{
+  // Connect to the server and upload readings. Without it readings are only
+  // logged, which keeps a simulation away from the real server's data.
+  bool upload;
+
+  // Keep one session open across measurement cycles instead of reconnecting
+  // for every upload.
+  bool persistent;
+
+  // TCP keepalive probe interval for idle sessions. Zero disables keepalive.
+  std::chrono::seconds keepalive_period;
+
+  // A persistent session is closed once it goes idle if no sensor reading is
+  // due within this. The next reading then reconnects lazily.
+  std::chrono::seconds idle_close_threshold;
+};
+
+} // namespace organicdump
+
+#endif // ORGANICDUMP_CLIENT_CONNECTIONPOLICY_H
@@ -0,0 +1,144 @@
+#include "ControlSocket.h"
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <utility>
+
+#include <glog/logging.h>
+
+namespace
+{
+constexpr int LISTEN_BACKLOG = 8;
+} // namespace
+
+namespace organicdump
+{
+
+bool ControlSocket::Open(const std::string &path, ControlSocket *out_socket)
+{
+  assert(out_socket);
+
+  sockaddr_un address;
+  std::memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  if (path.empty() || path.size() >= sizeof(address.sun_path))
+  {
+    LOG(ERROR) << "Invalid control socket path: " << path;
+    return false;
+  }
+  std::memcpy(address.sun_path, path.c_str(), path.size());
+
+  ControlSocket control_socket;
+  control_socket.fd_ =
+      socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (control_socket.fd_ < 0)
+  {
+    LOG(ERROR) << "Failed to create control socket: " << strerror(errno);
+    return false;
+  }
+
+  unlink(path.c_str());
+  if (bind(
+          control_socket.fd_,
+          reinterpret_cast<const sockaddr *>(&address),
+          sizeof(address)) != 0 ||
+      listen(control_socket.fd_, LISTEN_BACKLOG) != 0)
+  {
+    LOG(ERROR) << "Failed to listen on " << path << ": " << strerror(errno);
+    return false;
+  }
+
+  control_socket.path_ = path;
+  *out_socket = std::move(control_socket);
+  return true;
+}
+
+ControlSocket::ControlSocket() : fd_{-1} {}
+
+ControlSocket::ControlSocket(ControlSocket &&other) : fd_{-1}
+{
+  StealResources(&other);
+}
+
+ControlSocket &ControlSocket::operator=(ControlSocket &&other)
+{
+  if (this != &other)
+  {
+    CloseResources();
+    StealResources(&other);
+  }
+  return *this;
+}
+
+ControlSocket::~ControlSocket()
+{
+  CloseResources();
+}
+
+bool ControlSocket::IsOpen() const
+{
+  return fd_ >= 0;
+}
+
+int ControlSocket::GetFd() const
+{
+  return fd_;
+}
+
+void ControlSocket::ServeConnections(const StatusCallback &get_status)
+{
+  assert(IsOpen());
+
+  std::string status;
+  while (true)
+  {
+    int peer_fd = accept4(fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (peer_fd < 0)
+    {
+      if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+      {
+        LOG(WARNING) << "Failed to accept control connection: "
+                     << strerror(errno);
+      }
+      return;
+    }
+
+    if (status.empty())
+    {
+      status = get_status() + "\n";
+    }
+
+    // One line fits in an empty socket buffer, so this doesn't block. A peer
+    // that has already gone just misses it.
+    send(peer_fd, status.data(), status.size(), MSG_NOSIGNAL);
+    close(peer_fd);
+  }
+}
+
+void ControlSocket::CloseResources()
+{
+  if (fd_ < 0)
+  {
+    return;
+  }
+
+  close(fd_);
+  fd_ = -1;
+  unlink(path_.c_str());
+}
+
+void ControlSocket::StealResources(ControlSocket *other)
+{
+  assert(other);
+  fd_ = other->fd_;
+  other->fd_ = -1;
+  path_ = std::move(other->path_);
+}
+
+} // namespace organicdump
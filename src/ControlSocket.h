@@ -0,0 +1,57 @@
+#ifndef ORGANICDUMP_CLIENT_CONTROLSOCKET_H
+#define ORGANICDUMP_CLIENT_CONTROLSOCKET_H
+
+#include <functional>
+#include <string>
+
+namespace organicdump
+{
+
+/**
+ * Local status endpoint on a Unix stream socket, served from the daemon's
+ * event loop. Every peer that connects is sent one line of counters and
+ * disconnected. Nothing is read from peers, so a stuck local client can't
+ * hold up uploads.
+ */
+class ControlSocket
+{
+public:
+  using StatusCallback = std::function<std::string()>;
+
+public:
+  /**
+   * Listens on |path|, replacing a socket left behind by an earlier run.
+   */
+  static bool Open(const std::string &path, ControlSocket *out_socket);
+
+public:
+  ControlSocket();
+  ControlSocket(ControlSocket &&other);
+  ControlSocket &operator=(ControlSocket &&other);
+  ~ControlSocket();
+
+  bool IsOpen() const;
+  int GetFd() const;
+
+  /**
+   * Accepts every pending connection and answers each with |get_status|.
+   * Call when the fd is readable.
+   */
+  void ServeConnections(const StatusCallback &get_status);
+
+private:
+  void CloseResources();
+  void StealResources(ControlSocket *other);
+
+private:
+  ControlSocket(const ControlSocket &other) = delete;
+  ControlSocket &operator=(const ControlSocket &other) = delete;
+
+private:
+  int fd_;
+  std::string path_;
+};
+
+} // namespace organicdump
+
+#endif // ORGANICDUMP_CLIENT_CONTROLSOCKET_H
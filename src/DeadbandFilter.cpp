@@ -0,0 +1,90 @@
+#include "DeadbandFilter.h"
+
+#include <chrono>
+#include <cmath>
+
+namespace organicdump
+{
+
+DeadbandFilter::DeadbandFilter()
+  : DeadbandFilter{DeadbandPolicy{0, 0, std::chrono::seconds{0}}} {}
+
+DeadbandFilter::DeadbandFilter(DeadbandPolicy policy)
+  : policy_{policy},
+    suppressed_count_{0},
+    heartbeat_count_{0} {}
+
+bool DeadbandFilter::ShouldSend(const SoilMoistureMeasurement &measurement)
+{
+  if (!IsEnabled())
+  {
+    return true;
+  }
+
+  auto state = sensor_states_.find(measurement.sensor_id);
+  if (state == sensor_states_.end())
+  {
+    sensor_states_.emplace(
+        measurement.sensor_id,
+        SensorState{measurement.value, measurement.steady_time, 0});
+    return true;
+  }
+
+  SensorState &sensor = state->second;
+  bool is_heartbeat_due =
+      policy_.heartbeat_period.count() > 0 &&
+      measurement.steady_time - sensor.last_sent_time >=
+          policy_.heartbeat_period;
+
+  if (!IsOutsideDeadband(sensor.last_sent_value, measurement.value))
+  {
+    if (!is_heartbeat_due)
+    {
+      ++sensor.suppressed_count;
+      ++suppressed_count_;
+      return false;
+    }
+    ++heartbeat_count_;
+  }
+
+  sensor.last_sent_value = measurement.value;
+  sensor.last_sent_time = measurement.steady_time;
+  return true;
+}
+
+bool DeadbandFilter::IsEnabled() const
+{
+  return policy_.absolute_threshold > 0 || policy_.relative_threshold > 0;
+}
+
+size_t DeadbandFilter::GetSuppressedCount() const
+{
+  return suppressed_count_;
+}
+
+size_t DeadbandFilter::GetSuppressedCount(size_t sensor_id) const
+{
+  auto state = sensor_states_.find(sensor_id);
+  return state == sensor_states_.end() ? 0 : state->second.suppressed_count;
+}
+
+size_t DeadbandFilter::GetHeartbeatCount() const
+{
+  return heartbeat_count_;
+}
+
+bool DeadbandFilter::IsOutsideDeadband(
+    double last_sent_value,
+    double value) const
+{
+  double change = std::fabs(value - last_sent_value);
+  if (policy_.absolute_threshold > 0 && change > policy_.absolute_threshold)
+  {
+    return true;
+  }
+
+  return policy_.relative_threshold > 0 &&
+         change > policy_.relative_threshold * std::fabs(last_sent_value);
+}
+
+} // namespace organicdump
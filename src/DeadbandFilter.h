@@ -0,0 +1,54 @@
+#ifndef ORGANICDUMP_CLIENT_DEADBANDFILTER_H
+#define ORGANICDUMP_CLIENT_DEADBANDFILTER_H
+
+#include <chrono>
+#include <cstddef>
+#include <unordered_map>
+
+#include "DeadbandPolicy.h"
+#include "SoilMoistureMeasurement.h"
+
+namespace organicdump
+{
+
+/**
+ * Applies a DeadbandPolicy per sensor and counts what it suppresses.
+ */
+class DeadbandFilter
+{
+public:
+  DeadbandFilter();
+  explicit DeadbandFilter(DeadbandPolicy policy);
+
+  /**
+   * Returns true if |measurement| should be uploaded, and if so takes it as
+   * its sensor's new reference reading.
+   */
+  bool ShouldSend(const SoilMoistureMeasurement &measurement);
+
+  bool IsEnabled() const;
+  size_t GetSuppressedCount() const;
+  size_t GetSuppressedCount(size_t sensor_id) const;
+  size_t GetHeartbeatCount() const;
+
+private:
+  struct SensorState
+  {
+    double last_sent_value;
+    std::chrono::steady_clock::time_point last_sent_time;
+    size_t suppressed_count;
+  };
+
+private:
+  bool IsOutsideDeadband(double last_sent_value, double value) const;
+
+private:
+  DeadbandPolicy policy_;
+  std::unordered_map<size_t, SensorState> sensor_states_;
+  size_t suppressed_count_;
+  size_t heartbeat_count_;
+};
+
+} // namespace organicdump
+
+#endif // ORGANICDUMP_CLIENT_DEADBANDFILTER_H
@@ -0,0 +1,31 @@
+#ifndef ORGANICDUMP_CLIENT_DEADBANDPOLICY_H
+#define ORGANICDUMP_CLIENT_DEADBANDPOLICY_H
+
+#include <chrono>
+
+namespace organicdump
+{
+
+/**
+ * Controls report-by-exception uploads. A reading is uploaded only if it
+ * moves past a threshold from the last uploaded reading of its sensor, or if
+ * the sensor hasn't uploaded for a heartbeat period. With both thresholds at
+ * zero every reading is uploaded.
+ */
+struct DeadbandPolicy
+{
+  // Smallest absolute change worth uploading. Zero disables the check.
+  double absolute_threshold;
+
+  // Smallest change, as a fraction of the last uploaded value, worth
+  // uploading. Zero disables the check.
+  double relative_threshold;
+
+  // Longest a sensor goes without an upload while its readings sit inside
+  // the deadband. Zero disables heartbeats.
+  std::chrono::seconds heartbeat_period;
+};
+
+} // namespace organicdump
+
+#endif // ORGANICDUMP_CLIENT_DEADBANDPOLICY_H
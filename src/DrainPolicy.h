@@ -0,0 +1,32 @@
+#ifndef ORGANICDUMP_CLIENT_DRAINPOLICY_H
+#define ORGANICDUMP_CLIENT_DRAINPOLICY_H
+
+#include <cstddef>
+
+namespace organicdump
+{
+
+/**
+ * Controls how the monitoring daemon catches up on a spooled backlog.
+ */
+struct DrainPolicy
+{
+  // Extra server sessions opened to upload the backlog alongside the live
+  // session. Zero uploads the backlog in order on the live session.
+  size_t stream_count;
+
+  // Contiguous readings handed to a drain session at a time. Readings within
+  // a chunk are uploaded in order.
+  size_t chunk_size;
+
+  // Unsent readings needed, when a session comes up, to start catching up.
+  size_t backlog_threshold;
+
+  // Upper bound on backlog uploads per second across all drain sessions, so
+  // live readings keep priority. Zero leaves the rate uncapped.
+  size_t max_rate;
+};
+
+} // namespace organicdump
+
+#endif // ORGANICDUMP_CLIENT_DRAINPOLICY_H
@@ -0,0 +1,271 @@
+#include "EventLoop.h"
+
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include <cassert>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <utility>
+
+#include <glog/logging.h>
+
+namespace
+{
+constexpr int MAX_EVENTS_PER_WAIT = 16;
+constexpr std::chrono::nanoseconds::rep NANOS_PER_SECOND = 1000000000;
+
+struct timespec ToTimespec(std::chrono::nanoseconds duration)
+{
+  struct timespec ts;
+  ts.tv_sec = duration.count() / NANOS_PER_SECOND;
+  ts.tv_nsec = duration.count() % NANOS_PER_SECOND;
+  return ts;
+}
+} // namespace
+
+namespace organicdump
+{
+
+EventLoop::EventLoop()
+  : epoll_fd_{epoll_create1(EPOLL_CLOEXEC)},
+    is_running_{false}
+{
+  if (epoll_fd_ < 0)
+  {
+    LOG(ERROR) << "Failed to create epoll instance: " << strerror(errno);
+  }
+}
+
+EventLoop::~EventLoop()
+{
+  for (const auto &entry : timer_callbacks_)
+  {
+    close(entry.first);
+  }
+
+  if (epoll_fd_ >= 0)
+  {
+    close(epoll_fd_);
+  }
+}
+
+bool EventLoop::IsInitialized() const
+{
+  return epoll_fd_ >= 0;
+}
+
+bool EventLoop::AddFd(int fd, uint32_t events, FdCallback callback)
+{
+  assert(timer_callbacks_.count(fd) == 0);
+  return WatchFd(fd, events, std::move(callback));
+}
+
+bool EventLoop::ModifyFd(int fd, uint32_t events)
+{
+  assert(fd_callbacks_.count(fd) == 1);
+
+  struct epoll_event event = {};
+  event.events = events;
+  event.data.fd = fd;
+  if (epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, fd, &event) != 0)
+  {
+    LOG(ERROR) << "Failed to modify fd " << fd << " in epoll: "
+               << strerror(errno);
+    return false;
+  }
+
+  return true;
+}
+
+bool EventLoop::RemoveFd(int fd)
+{
+  if (fd_callbacks_.erase(fd) == 0)
+  {
+    return false;
+  }
+
+  if (epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr) != 0)
+  {
+    LOG(ERROR) << "Failed to remove fd " << fd << " from epoll: "
+               << strerror(errno);
+    return false;
+  }
+
+  return true;
+}
+
+bool EventLoop::AddTimer(TimerCallback callback, TimerId *out_timer_id)
+{
+  assert(out_timer_id);
+
+  int timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  if (timer_fd < 0)
+  {
+    LOG(ERROR) << "Failed to create timerfd: " << strerror(errno);
+    return false;
+  }
+
+  if (!WatchFd(timer_fd, EPOLLIN, [this, timer_fd](uint32_t) {
+        OnTimerReadable(timer_fd);
+      }))
+  {
+    close(timer_fd);
+    return false;
+  }
+
+  timer_callbacks_.emplace(timer_fd, std::move(callback));
+  *out_timer_id = timer_fd;
+  return true;
+}
+
+bool EventLoop::ArmTimer(
+    TimerId timer_id,
+    std::chrono::nanoseconds delay,
+    std::chrono::nanoseconds period)
+{
+  assert(timer_callbacks_.count(timer_id) == 1);
+
+  // A zero it_value disarms a timerfd, so round an immediate expiry up.
+  if (delay.count() <= 0)
+  {
+    delay = std::chrono::nanoseconds{1};
+  }
+
+  struct itimerspec spec;
+  spec.it_value = ToTimespec(delay);
+  spec.it_interval = ToTimespec(period);
+  if (timerfd_settime(timer_id, 0, &spec, nullptr) != 0)
+  {
+    LOG(ERROR) << "Failed to arm timerfd: " << strerror(errno);
+    return false;
+  }
+
+  return true;
+}
+
+bool EventLoop::DisarmTimer(TimerId timer_id)
+{
+  assert(timer_callbacks_.count(timer_id) == 1);
+
+  struct itimerspec spec = {};
+  if (timerfd_settime(timer_id, 0, &spec, nullptr) != 0)
+  {
+    LOG(ERROR) << "Failed to disarm timerfd: " << strerror(errno);
+    return false;
+  }
+
+  return true;
+}
+
+bool EventLoop::IsTimerArmed(TimerId timer_id) const
+{
+  assert(timer_callbacks_.count(timer_id) == 1);
+
+  struct itimerspec spec;
+  if (timerfd_gettime(timer_id, &spec) != 0)
+  {
+    return false;
+  }
+
+  return spec.it_value.tv_sec != 0 || spec.it_value.tv_nsec != 0;
+}
+
+bool EventLoop::RemoveTimer(TimerId timer_id)
+{
+  if (timer_callbacks_.erase(timer_id) == 0)
+  {
+    return false;
+  }
+
+  RemoveFd(timer_id);
+  close(timer_id);
+  return true;
+}
+
+bool EventLoop::Run()
+{
+  assert(IsInitialized());
+
+  struct epoll_event events[MAX_EVENTS_PER_WAIT];
+  is_running_ = true;
+
+  while (is_running_)
+  {
+    int event_count = epoll_wait(epoll_fd_, events, MAX_EVENTS_PER_WAIT, -1);
+    if (event_count < 0)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+
+      LOG(ERROR) << "epoll_wait failed: " << strerror(errno);
+      is_running_ = false;
+      return false;
+    }
+
+    for (int i = 0; i < event_count && is_running_; ++i)
+    {
+      auto it = fd_callbacks_.find(events[i].data.fd);
+      if (it == fd_callbacks_.end())
+      {
+        // Removed by an earlier callback in this batch.
+        continue;
+      }
+
+      std::shared_ptr<FdCallback> callback = it->second;
+      (*callback)(events[i].events);
+    }
+  }
+
+  return true;
+}
+
+void EventLoop::Stop()
+{
+  is_running_ = false;
+}
+
+bool EventLoop::WatchFd(int fd, uint32_t events, FdCallback callback)
+{
+  assert(IsInitialized());
+  assert(fd_callbacks_.count(fd) == 0);
+
+  struct epoll_event event = {};
+  event.events = events;
+  event.data.fd = fd;
+  if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) != 0)
+  {
+    LOG(ERROR) << "Failed to add fd " << fd << " to epoll: " << strerror(errno);
+    return false;
+  }
+
+  fd_callbacks_.emplace(fd, std::make_shared<FdCallback>(std::move(callback)));
+  return true;
+}
+
+void EventLoop::OnTimerReadable(TimerId timer_id)
+{
+  uint64_t expirations;
+  if (read(timer_id, &expirations, sizeof(expirations)) != sizeof(expirations))
+  {
+    // Spurious wakeup, or the timer was rearmed after it became readable.
+    return;
+  }
+
+  auto it = timer_callbacks_.find(timer_id);
+  if (it == timer_callbacks_.end())
+  {
+    return;
+  }
+
+  // Copy in case the callback removes its own timer.
+  TimerCallback callback = it->second;
+  callback();
+}
+
+} // namespace organicdump
@@ -0,0 +1,84 @@
+#ifndef ORGANICDUMP_CLIENT_EVENTLOOP_H
+#define ORGANICDUMP_CLIENT_EVENTLOOP_H
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+
+namespace organicdump
+{
+
+/**
+ * Single-threaded epoll loop. Watches file descriptors for readiness and
+ * drives timers backed by timerfds, so nothing in the daemon has to sleep.
+ */
+class EventLoop
+{
+public:
+  using FdCallback = std::function<void(uint32_t events)>;
+  using TimerCallback = std::function<void()>;
+  using TimerId = int;
+
+public:
+  EventLoop();
+  ~EventLoop();
+  bool IsInitialized() const;
+
+  /**
+   * Calls |callback| with the ready epoll events whenever |fd| matches
+   * |events|. The loop doesn't take ownership of |fd|.
+   */
+  bool AddFd(int fd, uint32_t events, FdCallback callback);
+
+  /**
+   * Changes the events a watched |fd| is reported for, keeping its callback.
+   */
+  bool ModifyFd(int fd, uint32_t events);
+  bool RemoveFd(int fd);
+
+  /**
+   * Creates a disarmed timer that calls |callback| on expiry.
+   */
+  bool AddTimer(TimerCallback callback, TimerId *out_timer_id);
+
+  /**
+   * Arms |timer_id| to fire once after |delay|, then every |period| if
+   * |period| is non-zero. Rearming replaces any earlier schedule.
+   */
+  bool ArmTimer(
+      TimerId timer_id,
+      std::chrono::nanoseconds delay,
+      std::chrono::nanoseconds period=std::chrono::nanoseconds{0});
+  bool DisarmTimer(TimerId timer_id);
+  bool IsTimerArmed(TimerId timer_id) const;
+  bool RemoveTimer(TimerId timer_id);
+
+  /**
+   * Dispatches events until Stop() is called from a callback or a wait
+   * fails. Returns false on failure.
+   */
+  bool Run();
+  void Stop();
+
+private:
+  bool WatchFd(int fd, uint32_t events, FdCallback callback);
+  void OnTimerReadable(TimerId timer_id);
+
+private:
+  EventLoop(const EventLoop &other) = delete;
+  EventLoop &operator=(const EventLoop &other) = delete;
+
+private:
+  int epoll_fd_;
+  bool is_running_;
+  // Callbacks are held by shared_ptr so that one may remove itself, or
+  // another watch, while it runs.
+  std::unordered_map<int, std::shared_ptr<FdCallback>> fd_callbacks_;
+  std::unordered_map<TimerId, TimerCallback> timer_callbacks_;
+};
+
+} // namespace organicdump
+
+#endif // ORGANICDUMP_CLIENT_EVENTLOOP_H
@@ -0,0 +1,100 @@
+#include "FileUtilities.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include <glog/logging.h>
+
+namespace
+{
+bool WriteAll(int fd, const std::string &contents)
+{
+  size_t written = 0;
+  while (written < contents.size())
+  {
+    ssize_t ret = write(fd, contents.data() + written, contents.size() - written);
+    if (ret < 0)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      return false;
+    }
+    written += static_cast<size_t>(ret);
+  }
+  return true;
+}
+
+std::string GetParentDirectory(const std::string &path)
+{
+  size_t slash = path.rfind('/');
+  if (slash == std::string::npos)
+  {
+    return ".";
+  }
+  return slash == 0 ? "/" : path.substr(0, slash);
+}
+} // namespace
+
+namespace organicdump
+{
+
+bool WriteFileAtomically(
+    const std::string &path,
+    const std::string &contents,
+    mode_t mode)
+{
+  std::string tmp_path = path + ".tmp";
+  int fd = open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, mode);
+  if (fd < 0)
+  {
+    LOG(ERROR) << "Failed to open " << tmp_path << ": " << strerror(errno);
+    return false;
+  }
+
+  // Without the fsync the rename can reach the disk before the data does,
+  // and a power cut leaves an empty file in place of the old one.
+  bool written = WriteAll(fd, contents) && fsync(fd) == 0;
+  if (!written)
+  {
+    LOG(ERROR) << "Failed to write " << tmp_path << ": " << strerror(errno);
+  }
+
+  if (close(fd) != 0 || !written)
+  {
+    std::remove(tmp_path.c_str());
+    return false;
+  }
+
+  if (std::rename(tmp_path.c_str(), path.c_str()) != 0)
+  {
+    LOG(ERROR) << "Failed to rename " << tmp_path << " to " << path << ": "
+               << strerror(errno);
+    std::remove(tmp_path.c_str());
+    return false;
+  }
+
+  std::string directory = GetParentDirectory(path);
+  int dir_fd = open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (dir_fd < 0)
+  {
+    LOG(WARNING) << "Failed to open " << directory << " to sync rename: "
+                 << strerror(errno);
+    return true;
+  }
+
+  if (fsync(dir_fd) != 0)
+  {
+    LOG(WARNING) << "Failed to sync " << directory << ": " << strerror(errno);
+  }
+  close(dir_fd);
+  return true;
+}
+
+} // namespace organicdump
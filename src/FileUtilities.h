@@ -0,0 +1,24 @@
+#ifndef ORGANICDUMP_CLIENT_FILEUTILITIES_H
+#define ORGANICDUMP_CLIENT_FILEUTILITIES_H
+
+#include <sys/types.h>
+
+#include <string>
+
+namespace organicdump
+{
+
+/**
+ * Replaces |path| with |contents|. The data goes to a scratch file that is
+ * synced and renamed over |path|, and the rename itself is synced, so after a
+ * crash or power loss |path| holds either the old or the new contents in
+ * full.
+ */
+bool WriteFileAtomically(
+    const std::string &path,
+    const std::string &contents,
+    mode_t mode);
+
+} // namespace organicdump
+
+#endif // ORGANICDUMP_CLIENT_FILEUTILITIES_H
@@ -0,0 +1,166 @@
+#include "FrameDecoder.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <utility>
+
+#include <glog/logging.h>
+
+#include "ProtobufFrame.h"
+
+namespace
+{
+// Enough for a burst of pipelined responses without growing.
+constexpr size_t INITIAL_BUFFER_SIZE = 4096;
+} // namespace
+
+namespace organicdump
+{
+
+FrameDecoder::FrameDecoder()
+  : buffer_(INITIAL_BUFFER_SIZE),
+    read_offset_{0},
+    write_offset_{0} {}
+
+FrameDecoder::FrameDecoder(FrameDecoder &&other)
+{
+  StealResources(&other);
+}
+
+FrameDecoder &FrameDecoder::operator=(FrameDecoder &&other)
+{
+  if (this != &other)
+  {
+    StealResources(&other);
+  }
+  return *this;
+}
+
+uint8_t *FrameDecoder::GetWriteBuffer(size_t min_size, size_t *out_capacity)
+{
+  assert(out_capacity);
+
+  // Reclaim consumed bytes before growing. Only the partial frame at the
+  // tail moves, and usually there's none.
+  if (read_offset_ > 0)
+  {
+    size_t buffered_size = write_offset_ - read_offset_;
+    std::memmove(buffer_.data(), buffer_.data() + read_offset_, buffered_size);
+    read_offset_ = 0;
+    write_offset_ = buffered_size;
+  }
+
+  if (buffer_.size() - write_offset_ < min_size)
+  {
+    size_t new_size = std::max(buffer_.size(), INITIAL_BUFFER_SIZE);
+    while (new_size - write_offset_ < min_size)
+    {
+      new_size *= 2;
+    }
+    buffer_.resize(new_size);
+  }
+
+  *out_capacity = buffer_.size() - write_offset_;
+  return buffer_.data() + write_offset_;
+}
+
+void FrameDecoder::Commit(size_t size)
+{
+  assert(write_offset_ + size <= buffer_.size());
+  write_offset_ += size;
+}
+
+bool FrameDecoder::Next(ProtobufFrame *out_frame, bool *out_corrupt)
+{
+  assert(out_frame);
+
+  if (out_corrupt)
+  {
+    *out_corrupt = false;
+  }
+
+  size_t body_size;
+  if (!PeekBodySize(&body_size))
+  {
+    return false;
+  }
+
+  if (body_size > MAX_FRAME_BODY_SIZE)
+  {
+    LOG(ERROR) << "Frame body of " << body_size << " bytes exceeds limit of "
+               << MAX_FRAME_BODY_SIZE;
+    if (out_corrupt)
+    {
+      *out_corrupt = true;
+    }
+    return false;
+  }
+
+  if (write_offset_ - read_offset_ < FRAME_HEADER_SIZE + body_size)
+  {
+    return false;
+  }
+
+  FrameHeader header;
+  DecodeFrameHeader(buffer_.data() + read_offset_, &header);
+
+  out_frame->type = header.type;
+  out_frame->body = buffer_.data() + read_offset_ + FRAME_HEADER_SIZE;
+  out_frame->body_size = body_size;
+  read_offset_ += FRAME_HEADER_SIZE + body_size;
+
+  if (read_offset_ == write_offset_)
+  {
+    read_offset_ = 0;
+    write_offset_ = 0;
+  }
+
+  return true;
+}
+
+bool FrameDecoder::HasFrame() const
+{
+  size_t body_size;
+  return PeekBodySize(&body_size) &&
+         write_offset_ - read_offset_ >= FRAME_HEADER_SIZE + body_size;
+}
+
+size_t FrameDecoder::GetBufferedSize() const
+{
+  return write_offset_ - read_offset_;
+}
+
+void FrameDecoder::Reset()
+{
+  read_offset_ = 0;
+  write_offset_ = 0;
+}
+
+bool FrameDecoder::PeekBodySize(size_t *out_body_size) const
+{
+  assert(out_body_size);
+
+  if (write_offset_ - read_offset_ < FRAME_HEADER_SIZE)
+  {
+    return false;
+  }
+
+  FrameHeader header;
+  DecodeFrameHeader(buffer_.data() + read_offset_, &header);
+  *out_body_size = header.size;
+  return true;
+}
+
+void FrameDecoder::StealResources(FrameDecoder *other)
+{
+  assert(other);
+  buffer_ = std::move(other->buffer_);
+  read_offset_ = other->read_offset_;
+  write_offset_ = other->write_offset_;
+  other->buffer_.clear();
+  other->read_offset_ = 0;
+  other->write_offset_ = 0;
+}
+
+} // namespace organicdump
@@ -0,0 +1,61 @@
+#ifndef ORGANICDUMP_CLIENT_FRAMEDECODER_H
+#define ORGANICDUMP_CLIENT_FRAMEDECODER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "ProtobufFrame.h"
+
+namespace organicdump
+{
+
+/**
+ * Incremental decoder for the protobuf frame stream. Bytes are read straight
+ * into a receive buffer owned by the decoder, in whatever chunks the TLS layer
+ * hands back. Complete frames are then handed out in place. A frame may span
+ * several reads, and one read may hold several frames. The buffer only grows,
+ * so a warm decoder doesn't allocate.
+ */
+class FrameDecoder
+{
+public:
+  FrameDecoder();
+  FrameDecoder(FrameDecoder &&other);
+  FrameDecoder &operator=(FrameDecoder &&other);
+
+  /**
+   * Returns space for at least |min_size| more bytes. Write received bytes
+   * there and then call Commit() with how many were written.
+   */
+  uint8_t *GetWriteBuffer(size_t min_size, size_t *out_capacity);
+  void Commit(size_t size);
+
+  /**
+   * Pops the next complete frame. |out_frame| points into the receive buffer
+   * and stays valid until the next call to GetWriteBuffer(). Returns false
+   * if no complete frame is buffered yet; |out_corrupt| is set if the stream
+   * can't be decoded.
+   */
+  bool Next(ProtobufFrame *out_frame, bool *out_corrupt=nullptr);
+  bool HasFrame() const;
+  size_t GetBufferedSize() const;
+  void Reset();
+
+private:
+  bool PeekBodySize(size_t *out_body_size) const;
+  void StealResources(FrameDecoder *other);
+
+private:
+  FrameDecoder(const FrameDecoder &other) = delete;
+  FrameDecoder &operator=(const FrameDecoder &other) = delete;
+
+private:
+  std::vector<uint8_t> buffer_;
+  size_t read_offset_;
+  size_t write_offset_;
+};
+
+} // namespace organicdump
+
+#endif // ORGANICDUMP_CLIENT_FRAMEDECODER_H
@@ -0,0 +1,34 @@
+#ifndef ORGANICDUMP_CLIENT_HARDWAREBACKEND_H
+#define ORGANICDUMP_CLIENT_HARDWAREBACKEND_H
+
+#include <chrono>
+
+#include "I2cBus.h"
+
+namespace organicdump
+{
+
+/**
+ * The hardware the monitoring client samples. Injected into the client so the
+ * daemon can run against real buses on a Pi or a simulation anywhere else.
+ */
+class HardwareBackend
+{
+public:
+  virtual ~HardwareBackend() = default;
+
+  /**
+   * Returns the bus numbered |bus_number|, opening it on first use, or
+   * nullptr if it can't be opened. The backend owns the bus.
+   */
+  virtual I2cBus *OpenBus(int bus_number) = 0;
+
+  /**
+   * How long an ADS1115 takes to finish a single-shot conversion.
+   */
+  virtual std::chrono::microseconds GetConversionTime() const = 0;
+};
+
+} // namespace organicdump
+
+#endif // ORGANICDUMP_CLIENT_HARDWAREBACKEND_H
@@ -0,0 +1,52 @@
+#ifndef ORGANICDUMP_CLIENT_I2CBUS_H
+#define ORGANICDUMP_CLIENT_I2CBUS_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace organicdump
+{
+
+/**
+ * One segment of a combined I2C transaction, as in the kernel's i2c_msg.
+ */
+struct I2cMessage
+{
+  uint16_t address;
+  bool is_read;
+  uint8_t *data;
+  uint16_t size;
+};
+
+/**
+ * An I2C bus that runs a list of messages as one combined transaction, with
+ * repeated starts between segments. Lets device drivers batch a whole sweep
+ * into a few transfers, and lets them run against a simulated bus.
+ */
+class I2cBus
+{
+public:
+  virtual ~I2cBus() = default;
+
+  /**
+   * Runs |count| messages in order as one transaction. Returns false if any
+   * segment fails, in which case read buffers are unspecified.
+   */
+  virtual bool Transfer(I2cMessage *messages, size_t count) = 0;
+
+  /**
+   * Closes the bus and opens it again, for an adapter that has wedged.
+   * Transfers fail until a reopen succeeds.
+   */
+  virtual bool Reopen() = 0;
+
+  /**
+   * Transactions issued so far, which is the number of syscalls on a real
+   * bus.
+   */
+  virtual size_t GetTransferCount() const = 0;
+};
+
+} // namespace organicdump
+
+#endif // ORGANICDUMP_CLIENT_I2CBUS_H
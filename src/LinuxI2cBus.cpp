@@ -0,0 +1,191 @@
+#include "LinuxI2cBus.h"
+
+#include <fcntl.h>
+#include <linux/i2c-dev.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <string>
+
+#include <glog/logging.h>
+
+namespace
+{
+// Kernel limit on segments per I2C_RDWR call.
+constexpr size_t MAX_MESSAGES_PER_TRANSFER = I2C_RDWR_IOCTL_MAX_MSGS;
+
+// I2C_TIMEOUT counts in units of 10 ms.
+constexpr std::chrono::milliseconds TIMEOUT_UNIT{10};
+} // namespace
+
+namespace organicdump
+{
+
+bool LinuxI2cBus::Open(
+    int bus_number,
+    std::chrono::milliseconds timeout,
+    LinuxI2cBus *out_bus)
+{
+  assert(out_bus);
+
+  std::string path = "/dev/i2c-" + std::to_string(bus_number);
+  int fd = open(path.c_str(), O_RDWR | O_CLOEXEC);
+  if (fd < 0)
+  {
+    LOG(ERROR) << "Failed to open " << path << ": " << strerror(errno);
+    return false;
+  }
+
+  unsigned long functionality;
+  if (ioctl(fd, I2C_FUNCS, &functionality) < 0 ||
+      !(functionality & I2C_FUNC_I2C))
+  {
+    LOG(ERROR) << path << " doesn't support combined I2C transactions";
+    close(fd);
+    return false;
+  }
+
+  unsigned long timeout_units = static_cast<unsigned long>(
+      std::max<std::chrono::milliseconds::rep>(
+          (timeout + TIMEOUT_UNIT - std::chrono::milliseconds{1}) / TIMEOUT_UNIT,
+          1));
+  if (ioctl(fd, I2C_TIMEOUT, timeout_units) < 0)
+  {
+    LOG(ERROR) << "Failed to set timeout on " << path << ": " << strerror(errno);
+    close(fd);
+    return false;
+  }
+
+  LinuxI2cBus bus;
+  bus.fd_ = fd;
+  bus.bus_number_ = bus_number;
+  bus.timeout_ = timeout;
+  *out_bus = std::move(bus);
+  return true;
+}
+
+LinuxI2cBus::LinuxI2cBus()
+  : fd_{-1},
+    bus_number_{-1},
+    timeout_{0},
+    transfer_count_{0} {}
+
+LinuxI2cBus::LinuxI2cBus(LinuxI2cBus &&other)
+  : LinuxI2cBus()
+{
+  StealResources(&other);
+}
+
+LinuxI2cBus &LinuxI2cBus::operator=(LinuxI2cBus &&other)
+{
+  if (this != &other)
+  {
+    CloseResources();
+    StealResources(&other);
+  }
+  return *this;
+}
+
+LinuxI2cBus::~LinuxI2cBus()
+{
+  CloseResources();
+}
+
+bool LinuxI2cBus::Transfer(I2cMessage *messages, size_t count)
+{
+  assert(messages);
+
+  if (fd_ < 0)
+  {
+    // Closed by a reopen that failed.
+    return false;
+  }
+
+  if (count == 0)
+  {
+    return true;
+  }
+
+  if (count > MAX_MESSAGES_PER_TRANSFER)
+  {
+    LOG(ERROR) << "I2C transaction of " << count << " segments exceeds the "
+               << MAX_MESSAGES_PER_TRANSFER << " segment limit";
+    return false;
+  }
+
+  kernel_messages_.resize(count);
+  for (size_t i = 0; i < count; ++i)
+  {
+    kernel_messages_[i].addr = messages[i].address;
+    kernel_messages_[i].flags = messages[i].is_read ? I2C_M_RD : 0;
+    kernel_messages_[i].len = messages[i].size;
+    kernel_messages_[i].buf = messages[i].data;
+  }
+
+  i2c_rdwr_ioctl_data transaction;
+  transaction.msgs = kernel_messages_.data();
+  transaction.nmsgs = static_cast<uint32_t>(count);
+
+  ++transfer_count_;
+  if (ioctl(fd_, I2C_RDWR, &transaction) < 0)
+  {
+    LOG(ERROR) << "I2C transaction failed: " << strerror(errno);
+    return false;
+  }
+
+  return true;
+}
+
+bool LinuxI2cBus::Reopen()
+{
+  assert(bus_number_ >= 0);
+
+  // Close first so the adapter is released even if the open fails.
+  size_t transfer_count = transfer_count_;
+  int bus_number = bus_number_;
+  std::chrono::milliseconds timeout = timeout_;
+  CloseResources();
+
+  LinuxI2cBus bus;
+  bool opened = Open(bus_number, timeout, &bus);
+  if (opened)
+  {
+    *this = std::move(bus);
+  }
+  bus_number_ = bus_number;
+  timeout_ = timeout;
+  transfer_count_ = transfer_count;
+  return opened;
+}
+
+size_t LinuxI2cBus::GetTransferCount() const
+{
+  return transfer_count_;
+}
+
+void LinuxI2cBus::CloseResources()
+{
+  if (fd_ >= 0)
+  {
+    close(fd_);
+  }
+  fd_ = -1;
+}
+
+void LinuxI2cBus::StealResources(LinuxI2cBus *other)
+{
+  assert(other);
+  fd_ = other->fd_;
+  bus_number_ = other->bus_number_;
+  timeout_ = other->timeout_;
+  transfer_count_ = other->transfer_count_;
+  kernel_messages_ = std::move(other->kernel_messages_);
+  other->fd_ = -1;
+}
+
+} // namespace organicdump
@@ -0,0 +1,59 @@
+#ifndef ORGANICDUMP_CLIENT_LINUXI2CBUS_H
+#define ORGANICDUMP_CLIENT_LINUXI2CBUS_H
+
+#include <chrono>
+#include <cstddef>
+#include <vector>
+
+#include <linux/i2c.h>
+
+#include "I2cBus.h"
+
+namespace organicdump
+{
+
+/**
+ * I2cBus over /dev/i2c-N. Each Transfer() is one I2C_RDWR ioctl.
+ */
+class LinuxI2cBus : public I2cBus
+{
+public:
+  /**
+   * Opens /dev/i2c-|bus_number|. A transaction that stalls for longer than
+   * |timeout| fails instead of blocking the sampler.
+   */
+  static bool Open(
+      int bus_number,
+      std::chrono::milliseconds timeout,
+      LinuxI2cBus *out_bus);
+
+public:
+  LinuxI2cBus();
+  LinuxI2cBus(LinuxI2cBus &&other);
+  LinuxI2cBus &operator=(LinuxI2cBus &&other);
+  ~LinuxI2cBus() override;
+
+  bool Transfer(I2cMessage *messages, size_t count) override;
+  bool Reopen() override;
+  size_t GetTransferCount() const override;
+
+private:
+  void CloseResources();
+  void StealResources(LinuxI2cBus *other);
+
+private:
+  LinuxI2cBus(const LinuxI2cBus &other) = delete;
+  LinuxI2cBus &operator=(const LinuxI2cBus &other) = delete;
+
+private:
+  int fd_;
+  int bus_number_;
+  std::chrono::milliseconds timeout_;
+  size_t transfer_count_;
+  // Reused across transfers so a sweep doesn't allocate.
+  std::vector<i2c_msg> kernel_messages_;
+};
+
+} // namespace organicdump
+
+#endif // ORGANICDUMP_CLIENT_LINUXI2CBUS_H
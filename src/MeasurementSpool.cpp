@@ -0,0 +1,387 @@
+#include "MeasurementSpool.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cassert>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <utility>
+
+#include <glog/logging.h>
+
+namespace
+{
+constexpr uint64_t SPOOL_MAGIC = 0x4c4f4f5053444f;  // "ODSPOOL"
+constexpr uint32_t SPOOL_VERSION = 1;
+constexpr size_t HEADER_SIZE = 4096;
+
+// Sequence numbers start at 1 so that a zeroed slot never looks valid.
+constexpr uint64_t FIRST_SEQ = 1;
+
+uint32_t Fnv1a(const uint8_t *data, size_t size)
+{
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < size; ++i)
+  {
+    hash ^= data[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+} // namespace
+
+namespace organicdump
+{
+
+struct MeasurementSpool::Header
+{
+  uint64_t magic;
+  uint32_t version;
+  uint32_t record_size;
+  uint64_t capacity;
+  uint64_t head_seq;
+};
+
+struct MeasurementSpool::Record
+{
+  uint64_t seq;
+  uint64_t sensor_id;
+  double value;
+  int64_t steady_time_ns;
+  int64_t wall_time_ns;
+  uint32_t conversion_latency_us;
+  uint32_t checksum;
+
+  uint32_t ComputeChecksum() const
+  {
+    return Fnv1a(
+        reinterpret_cast<const uint8_t *>(this),
+        offsetof(Record, checksum));
+  }
+};
+
+bool MeasurementSpool::Open(
+    const std::string &path,
+    size_t capacity,
+    MeasurementSpool *out_spool)
+{
+  assert(out_spool);
+  assert(capacity > 0);
+
+  MeasurementSpool spool;
+
+  if (path.empty())
+  {
+    if (!spool.Map(-1, capacity, true))
+    {
+      return false;
+    }
+    *out_spool = std::move(spool);
+    return true;
+  }
+
+  int fd = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+  if (fd < 0)
+  {
+    LOG(ERROR) << "Failed to open spool " << path << ": " << strerror(errno);
+    return false;
+  }
+
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0)
+  {
+    LOG(ERROR) << "Failed to stat spool " << path << ": " << strerror(errno);
+    close(fd);
+    return false;
+  }
+
+  bool is_new = static_cast<size_t>(file_stat.st_size) < HEADER_SIZE;
+  if (!is_new)
+  {
+    Header header;
+    bool has_header = pread(fd, &header, sizeof(header), 0) == sizeof(header);
+
+    if (has_header &&
+        header.magic == SPOOL_MAGIC &&
+        header.version != SPOOL_VERSION)
+    {
+      LOG(ERROR) << "Spool " << path << " has unsupported version "
+                 << header.version << ". Move it aside to start a new spool";
+      close(fd);
+      return false;
+    }
+
+    if (!has_header ||
+        header.magic != SPOOL_MAGIC ||
+        header.version != SPOOL_VERSION ||
+        header.record_size != sizeof(Record) ||
+        header.capacity == 0 ||
+        static_cast<size_t>(file_stat.st_size) <
+            HEADER_SIZE + header.capacity * sizeof(Record))
+    {
+      LOG(ERROR) << "Spool " << path << " is not a valid spool file. "
+                 << "Move it aside to start a new spool";
+      close(fd);
+      return false;
+    }
+
+    if (header.capacity != capacity)
+    {
+      LOG(WARNING) << "Keeping existing spool capacity of " << header.capacity
+                   << " records instead of " << capacity;
+    }
+    capacity = header.capacity;
+  }
+  else if (ftruncate(fd, HEADER_SIZE + capacity * sizeof(Record)) != 0)
+  {
+    LOG(ERROR) << "Failed to size spool " << path << ": " << strerror(errno);
+    close(fd);
+    return false;
+  }
+
+  // The mapping keeps the file alive.
+  bool mapped = spool.Map(fd, capacity, is_new);
+  close(fd);
+  if (!mapped)
+  {
+    return false;
+  }
+
+  LOG(INFO) << "Opened spool " << path << " with " << spool.GetSize()
+            << " unacknowledged readings";
+  *out_spool = std::move(spool);
+  return true;
+}
+
+MeasurementSpool::MeasurementSpool()
+  : map_{nullptr},
+    map_size_{0},
+    header_{nullptr},
+    records_{nullptr},
+    capacity_{0},
+    tail_seq_{FIRST_SEQ},
+    drop_count_{0} {}
+
+MeasurementSpool::MeasurementSpool(MeasurementSpool &&other)
+  : MeasurementSpool()
+{
+  StealResources(&other);
+}
+
+MeasurementSpool &MeasurementSpool::operator=(MeasurementSpool &&other)
+{
+  if (this != &other)
+  {
+    CloseResources();
+    StealResources(&other);
+  }
+  return *this;
+}
+
+MeasurementSpool::~MeasurementSpool()
+{
+  CloseResources();
+}
+
+bool MeasurementSpool::Append(const SoilMoistureMeasurement &measurement)
+{
+  assert(map_);
+
+  if (GetSize() >= capacity_)
+  {
+    ++drop_count_;
+    return false;
+  }
+
+  Record *record = GetRecord(tail_seq_);
+  record->seq = tail_seq_;
+  record->sensor_id = measurement.sensor_id;
+  record->value = measurement.value;
+  record->steady_time_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      measurement.steady_time.time_since_epoch()).count();
+  record->wall_time_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      measurement.wall_time.time_since_epoch()).count();
+  record->conversion_latency_us =
+      static_cast<uint32_t>(measurement.conversion_latency.count());
+  record->checksum = record->ComputeChecksum();
+
+  ++tail_seq_;
+  return true;
+}
+
+bool MeasurementSpool::Get(
+    uint64_t seq,
+    SoilMoistureMeasurement *out_measurement) const
+{
+  assert(out_measurement);
+
+  if (seq < GetHeadSeq() || seq >= tail_seq_)
+  {
+    return false;
+  }
+
+  const Record *record = GetRecord(seq);
+  out_measurement->sensor_id = record->sensor_id;
+  out_measurement->value = record->value;
+  // Steady times only mean something within one boot. Readings replayed
+  // after a reboot still carry a valid wall time.
+  out_measurement->steady_time = std::chrono::steady_clock::time_point{
+      std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+          std::chrono::nanoseconds{record->steady_time_ns})};
+  out_measurement->wall_time = std::chrono::system_clock::time_point{
+      std::chrono::duration_cast<std::chrono::system_clock::duration>(
+          std::chrono::nanoseconds{record->wall_time_ns})};
+  out_measurement->conversion_latency =
+      std::chrono::microseconds{record->conversion_latency_us};
+  return true;
+}
+
+void MeasurementSpool::Ack(size_t count)
+{
+  assert(count <= GetSize());
+  header_->head_seq += count;
+}
+
+bool MeasurementSpool::Sync()
+{
+  if (!map_ || header_ == nullptr)
+  {
+    return false;
+  }
+
+  if (msync(map_, map_size_, MS_SYNC) != 0)
+  {
+    LOG(ERROR) << "Failed to sync spool: " << strerror(errno);
+    return false;
+  }
+
+  return true;
+}
+
+uint64_t MeasurementSpool::GetHeadSeq() const
+{
+  return header_ ? header_->head_seq : FIRST_SEQ;
+}
+
+uint64_t MeasurementSpool::GetTailSeq() const
+{
+  return tail_seq_;
+}
+
+size_t MeasurementSpool::GetSize() const
+{
+  return static_cast<size_t>(tail_seq_ - GetHeadSeq());
+}
+
+size_t MeasurementSpool::GetCapacity() const
+{
+  return capacity_;
+}
+
+size_t MeasurementSpool::GetDropCount() const
+{
+  return drop_count_;
+}
+
+bool MeasurementSpool::Map(int fd, size_t capacity, bool is_new)
+{
+  static_assert(sizeof(Header) <= HEADER_SIZE, "Spool header must fit in its page");
+
+  size_t map_size = HEADER_SIZE + capacity * sizeof(Record);
+  int flags = fd < 0 ? MAP_PRIVATE | MAP_ANONYMOUS : MAP_SHARED;
+  void *map = mmap(nullptr, map_size, PROT_READ | PROT_WRITE, flags, fd, 0);
+  if (map == MAP_FAILED)
+  {
+    LOG(ERROR) << "Failed to map spool: " << strerror(errno);
+    return false;
+  }
+
+  map_ = static_cast<uint8_t *>(map);
+  map_size_ = map_size;
+  header_ = reinterpret_cast<Header *>(map_);
+  records_ = reinterpret_cast<Record *>(map_ + HEADER_SIZE);
+  capacity_ = capacity;
+
+  if (is_new)
+  {
+    std::memset(map_, 0, map_size_);
+    header_->magic = SPOOL_MAGIC;
+    header_->version = SPOOL_VERSION;
+    header_->record_size = sizeof(Record);
+    header_->capacity = capacity;
+    header_->head_seq = FIRST_SEQ;
+    tail_seq_ = FIRST_SEQ;
+    return fd < 0 || Sync();
+  }
+
+  Recover();
+  return true;
+}
+
+void MeasurementSpool::Recover()
+{
+  if (header_->head_seq < FIRST_SEQ)
+  {
+    header_->head_seq = FIRST_SEQ;
+  }
+
+  // Walk forward from the acknowledged position. A slot belongs to the spool
+  // only if it holds exactly the next sequence number and its checksum
+  // matches, so a torn append or a stale lap of the ring ends the scan.
+  uint64_t seq = header_->head_seq;
+  while (seq - header_->head_seq < capacity_)
+  {
+    const Record *record = GetRecord(seq);
+    if (record->seq != seq || record->checksum != record->ComputeChecksum())
+    {
+      break;
+    }
+    ++seq;
+  }
+
+  tail_seq_ = seq;
+}
+
+MeasurementSpool::Record *MeasurementSpool::GetRecord(uint64_t seq) const
+{
+  return &records_[seq % capacity_];
+}
+
+void MeasurementSpool::CloseResources()
+{
+  if (map_)
+  {
+    munmap(map_, map_size_);
+  }
+
+  map_ = nullptr;
+  map_size_ = 0;
+  header_ = nullptr;
+  records_ = nullptr;
+}
+
+void MeasurementSpool::StealResources(MeasurementSpool *other)
+{
+  assert(other);
+  map_ = other->map_;
+  map_size_ = other->map_size_;
+  header_ = other->header_;
+  records_ = other->records_;
+  capacity_ = other->capacity_;
+  tail_seq_ = other->tail_seq_;
+  drop_count_ = other->drop_count_;
+
+  other->map_ = nullptr;
+  other->map_size_ = 0;
+  other->header_ = nullptr;
+  other->records_ = nullptr;
+}
+
+} // namespace organicdump
@@ -0,0 +1,91 @@
+#ifndef ORGANICDUMP_CLIENT_MEASUREMENTSPOOL_H
+#define ORGANICDUMP_CLIENT_MEASUREMENTSPOOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "SoilMoistureMeasurement.h"
+
+namespace organicdump
+{
+
+/**
+ * Store-and-forward spool for readings awaiting acknowledgement. The spool is
+ * a fixed-size ring of checksummed records in a memory-mapped file. Readings
+ * are appended before upload and acknowledged in order once the server has
+ * assigned them ids. After a crash, Open() keeps every intact record from the
+ * last acknowledged position up to the first torn or missing one.
+ *
+ * Records are addressed by a sequence number that increases for the life of
+ * the file. [GetHeadSeq(), GetTailSeq()) are the unacknowledged records.
+ */
+class MeasurementSpool
+{
+public:
+  /**
+   * Opens or creates the spool at |path| with room for |capacity| records.
+   * An existing spool keeps its own capacity. An empty |path| gives a
+   * memory-only spool with the same behaviour minus durability.
+   */
+  static bool Open(
+      const std::string &path,
+      size_t capacity,
+      MeasurementSpool *out_spool);
+
+public:
+  MeasurementSpool();
+  MeasurementSpool(MeasurementSpool &&other);
+  MeasurementSpool &operator=(MeasurementSpool &&other);
+  ~MeasurementSpool();
+
+  /**
+   * Appends |measurement|. Returns false, and counts a drop, if the spool is
+   * full; the oldest unacknowledged readings are kept.
+   */
+  bool Append(const SoilMoistureMeasurement &measurement);
+  bool Get(uint64_t seq, SoilMoistureMeasurement *out_measurement) const;
+
+  /**
+   * Acknowledges the |count| oldest records.
+   */
+  void Ack(size_t count);
+
+  /**
+   * Flushes appended records and the acknowledged position to disk.
+   */
+  bool Sync();
+
+  uint64_t GetHeadSeq() const;
+  uint64_t GetTailSeq() const;
+  size_t GetSize() const;
+  size_t GetCapacity() const;
+  size_t GetDropCount() const;
+
+private:
+  struct Header;
+  struct Record;
+
+  bool Map(int fd, size_t capacity, bool is_new);
+  void Recover();
+  Record *GetRecord(uint64_t seq) const;
+  void CloseResources();
+  void StealResources(MeasurementSpool *other);
+
+private:
+  MeasurementSpool(const MeasurementSpool &other) = delete;
+  MeasurementSpool &operator=(const MeasurementSpool &other) = delete;
+
+private:
+  uint8_t *map_;
+  size_t map_size_;
+  Header *header_;
+  Record *records_;
+  size_t capacity_;
+  uint64_t tail_seq_;
+  size_t drop_count_;
+};
+
+} // namespace organicdump
+
+#endif // ORGANICDUMP_CLIENT_MEASUREMENTSPOOL_H
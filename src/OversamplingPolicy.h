@@ -0,0 +1,38 @@
+#ifndef ORGANICDUMP_CLIENT_OVERSAMPLINGPOLICY_H
+#define ORGANICDUMP_CLIENT_OVERSAMPLINGPOLICY_H
+
+#include <cstddef>
+
+namespace organicdump
+{
+
+enum class SampleFilterType
+{
+  MEAN,
+  MEDIAN,
+  TRIMMED_MEAN,
+  EWMA,
+};
+
+/**
+ * Controls how many conversions the sampler takes per channel each period,
+ * and how it reduces them to the one reading that gets uploaded.
+ */
+struct OversamplingPolicy
+{
+  // Conversions per channel per period.
+  size_t sample_count;
+
+  SampleFilterType filter;
+
+  // Fraction of conversions dropped from each end before a trimmed mean.
+  double trim_fraction;
+
+  // Weight of each new conversion in the moving average. The average carries
+  // over between periods.
+  double ewma_alpha;
+};
+
+} // namespace organicdump
+
+#endif // ORGANICDUMP_CLIENT_OVERSAMPLINGPOLICY_H
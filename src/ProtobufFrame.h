@@ -0,0 +1,75 @@
+#ifndef ORGANICDUMP_CLIENT_PROTOBUFFRAME_H
+#define ORGANICDUMP_CLIENT_PROTOBUFFRAME_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "NetworkUtilities.h"
+
+namespace organicdump
+{
+
+/**
+ * Wire framing shared with organic-dump-network: every protobuf message is
+ * preceded by an 8-byte header carrying its type and body size.
+ *
+ *   byte 0     message type
+ *   bytes 1-3  zero
+ *   bytes 4-7  body size, little-endian
+ *
+ * This is the layout of network::ProtobufMessageHeader as the server writes
+ * it on its little-endian targets. The fields are packed and unpacked one at
+ * a time so that the client doesn't depend on its own compiler's padding or
+ * byte order.
+ */
+constexpr size_t FRAME_HEADER_SIZE = 8;
+constexpr size_t FRAME_TYPE_OFFSET = 0;
+constexpr size_t FRAME_SIZE_OFFSET = 4;
+
+static_assert(
+    sizeof(network::ProtobufMessageHeader) == FRAME_HEADER_SIZE,
+    "organic-dump-network changed its frame header");
+
+// Bodies larger than this are treated as a corrupt stream rather than
+// buffered.
+constexpr size_t MAX_FRAME_BODY_SIZE = 1 << 20;
+
+struct FrameHeader
+{
+  uint8_t type;
+  uint32_t size;
+};
+
+struct ProtobufFrame
+{
+  uint8_t type;
+  const uint8_t *body;
+  size_t body_size;
+};
+
+inline void DecodeFrameHeader(const uint8_t *data, FrameHeader *out_header)
+{
+  const uint8_t *size = data + FRAME_SIZE_OFFSET;
+  out_header->type = data[FRAME_TYPE_OFFSET];
+  out_header->size = static_cast<uint32_t>(size[0]) |
+                     static_cast<uint32_t>(size[1]) << 8 |
+                     static_cast<uint32_t>(size[2]) << 16 |
+                     static_cast<uint32_t>(size[3]) << 24;
+}
+
+inline void EncodeFrameHeader(const FrameHeader &header, uint8_t *out_data)
+{
+  uint8_t *size = out_data + FRAME_SIZE_OFFSET;
+  out_data[FRAME_TYPE_OFFSET] = header.type;
+  out_data[1] = 0;
+  out_data[2] = 0;
+  out_data[3] = 0;
+  size[0] = static_cast<uint8_t>(header.size);
+  size[1] = static_cast<uint8_t>(header.size >> 8);
+  size[2] = static_cast<uint8_t>(header.size >> 16);
+  size[3] = static_cast<uint8_t>(header.size >> 24);
+}
+
+} // namespace organicdump
+
+#endif // ORGANICDUMP_CLIENT_PROTOBUFFRAME_H
@@ -1,25 +1,62 @@
 #include "ProtobufServer.h"
 
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <utility>
+
 #include "organic_dump.pb.h"
 
-#include "Fd.h"
+#include "ByteStream.h"
+#include "FrameDecoder.h"
 #include "OrganicDumpProtoMessage.h"
-#include "TlsConnection.h"
+#include "ProtobufFrame.h"
 
 namespace
 {
-using network::Fd;
-using network::TlsConnection;
+using organicdump_proto::MessageType;
+
+// Smallest read worth issuing. A BASIC_RESPONSE frame is well under this.
+constexpr size_t MIN_READ_SIZE = 512;
+
+// Unanswered keepalive probes before the kernel declares the session dead.
+constexpr int KEEPALIVE_PROBE_COUNT = 3;
+
+bool SetTcpOption(int fd, int level, int option, int value)
+{
+  if (setsockopt(fd, level, option, &value, sizeof(value)) != 0)
+  {
+    LOG(ERROR) << "Failed to set socket option " << option << ": "
+               << strerror(errno);
+    return false;
+  }
+  return true;
+}
 } // namespace
 
 namespace organicdump
 {
 
-ProtobufServer::ProtobufServer() : is_initialized_{false} {}
+ProtobufServer::ProtobufServer()
+  : is_initialized_{false},
+    send_offset_{0},
+    send_size_{0},
+    queued_frame_count_{0},
+    written_frame_count_{0} {}
 
-ProtobufServer::ProtobufServer(TlsConnection cxn)
+ProtobufServer::ProtobufServer(std::unique_ptr<ByteStream> stream)
   : is_initialized_{true},
-    cxn_{std::move(cxn)} {}
+    stream_{std::move(stream)},
+    send_offset_{0},
+    send_size_{0},
+    queued_frame_count_{0},
+    written_frame_count_{0} {}
 
 ProtobufServer::ProtobufServer(ProtobufServer&& other)
 {
@@ -46,48 +83,307 @@ bool ProtobufServer::Read(OrganicDumpProtoMessage *out_msg, bool *out_cxn_closed
   assert(out_msg);
 
   bool cxn_closed = false;
-  if (!ReadTlsProtobufMessage(
-        &cxn_,
-        out_msg,
-        &cxn_closed))
+  ProtobufFrame frame;
+  bool read_ok = ReadFrame(&frame, &cxn_closed);
+
+  if (out_cxn_closed)
+  {
+    *out_cxn_closed = cxn_closed;
+  }
+
+  if (!read_ok)
   {
     LOG(ERROR) << "Failed to read TLS protobuf message";
     return false;
   }
 
+  return DecodeMessage(frame, out_msg);
+}
+
+bool ProtobufServer::TryRead(
+    OrganicDumpProtoMessage *out_msg,
+    bool *out_has_message,
+    bool *out_cxn_closed)
+{
+  assert(out_msg);
+  assert(out_has_message);
+
+  *out_has_message = false;
+
+  bool cxn_closed = false;
+  bool corrupt = false;
+  ProtobufFrame frame;
+  if (!decoder_.Next(&frame, &corrupt))
+  {
+    if (corrupt)
+    {
+      return false;
+    }
+
+    size_t bytes_read = 0;
+    bool fill_ok = FillDecoder(&bytes_read, &cxn_closed);
+    if (out_cxn_closed)
+    {
+      *out_cxn_closed = cxn_closed;
+    }
+
+    if (!fill_ok)
+    {
+      LOG(ERROR) << "Failed to read TLS protobuf message";
+      return false;
+    }
+
+    if (!decoder_.Next(&frame, &corrupt))
+    {
+      return !corrupt;
+    }
+  }
+
+  if (!DecodeMessage(frame, out_msg))
+  {
+    return false;
+  }
+
+  *out_has_message = true;
+  return true;
+}
+
+bool ProtobufServer::HasBufferedMessage() const
+{
+  return decoder_.HasFrame() || (stream_ && stream_->HasPendingData());
+}
+
+bool ProtobufServer::Write(
+    MessageType type,
+    const google::protobuf::MessageLite &body,
+    bool *out_cxn_closed)
+{
+  Queue(type, body);
+  return Flush(out_cxn_closed);
+}
+
+void ProtobufServer::Queue(
+    MessageType type,
+    const google::protobuf::MessageLite &body)
+{
+  size_t body_size = body.ByteSizeLong();
+  size_t frame_size = FRAME_HEADER_SIZE + body_size;
+  if (send_offset_ > 0 && send_buffer_.size() < send_size_ + frame_size)
+  {
+    // Slide the part of a short write still owed to the front rather than
+    // grow past what's already been sent.
+    std::memmove(
+        send_buffer_.data(),
+        send_buffer_.data() + send_offset_,
+        send_size_ - send_offset_);
+    send_size_ -= send_offset_;
+    send_offset_ = 0;
+  }
+
+  if (send_buffer_.size() < send_size_ + frame_size)
+  {
+    send_buffer_.resize(send_size_ + frame_size);
+  }
+
+  uint8_t *frame = send_buffer_.data() + send_size_;
+  FrameHeader header;
+  header.type = static_cast<uint8_t>(type);
+  header.size = static_cast<uint32_t>(body_size);
+  EncodeFrameHeader(header, frame);
+  body.SerializeWithCachedSizesToArray(frame + FRAME_HEADER_SIZE);
+
+  send_size_ += frame_size;
+  ++queued_frame_count_;
+}
+
+bool ProtobufServer::Flush(bool *out_cxn_closed)
+{
+  if (out_cxn_closed)
+  {
+    *out_cxn_closed = false;
+  }
+
+  if (send_offset_ == send_size_)
+  {
+    return true;
+  }
+
+  bool cxn_closed = false;
+  size_t bytes_written = 0;
+  bool write_ok = stream_->Write(
+      send_buffer_.data() + send_offset_,
+      send_size_ - send_offset_,
+      &bytes_written,
+      &cxn_closed);
+
   if (out_cxn_closed)
   {
     *out_cxn_closed = cxn_closed;
   }
 
+  if (!write_ok)
+  {
+    LOG(ERROR) << "Failed to write " << queued_frame_count_
+               << " TLS protobuf messages";
+    return false;
+  }
+
+  send_offset_ += bytes_written;
+  if (send_offset_ < send_size_)
+  {
+    // The socket buffer is full. The rest goes once the fd is writable.
+    return true;
+  }
+
+  written_frame_count_ += queued_frame_count_;
+  send_offset_ = 0;
+  send_size_ = 0;
+  queued_frame_count_ = 0;
   return true;
 }
 
-bool ProtobufServer::Write(OrganicDumpProtoMessage *msg, bool *out_cxn_closed)
+bool ProtobufServer::HasQueuedFrames() const
 {
-  assert(msg);
+  return queued_frame_count_ > 0;
+}
 
-  bool cxn_closed = false;
-  if (!SendTlsProtobufMessage(
-        &cxn_,
-        msg,
-        &cxn_closed))
+bool ProtobufServer::WantsWrite() const
+{
+  return send_offset_ < send_size_ || (stream_ && stream_->WantsWrite());
+}
+
+size_t ProtobufServer::GetWrittenFrameCount() const
+{
+  return written_frame_count_;
+}
+
+size_t ProtobufServer::GetWriteCallCount() const
+{
+  return stream_ ? stream_->GetWriteCallCount() : 0;
+}
+
+int ProtobufServer::GetFd() const
+{
+  return stream_ ? stream_->GetFd() : -1;
+}
+
+bool ProtobufServer::EnableKeepalive(std::chrono::seconds period)
+{
+  assert(is_initialized_);
+  assert(period.count() > 0);
+
+  int fd = stream_->GetFd();
+  int seconds = static_cast<int>(period.count());
+  return SetTcpOption(fd, SOL_SOCKET, SO_KEEPALIVE, 1) &&
+         SetTcpOption(fd, IPPROTO_TCP, TCP_KEEPIDLE, seconds) &&
+         SetTcpOption(fd, IPPROTO_TCP, TCP_KEEPINTVL, seconds) &&
+         SetTcpOption(fd, IPPROTO_TCP, TCP_KEEPCNT, KEEPALIVE_PROBE_COUNT);
+}
+
+SSL *ProtobufServer::GetSsl() const
+{
+  return stream_ ? stream_->GetSsl() : nullptr;
+}
+
+bool ProtobufServer::ReadFrame(ProtobufFrame *out_frame, bool *out_cxn_closed)
+{
+  assert(out_frame);
+  assert(out_cxn_closed);
+
+  bool corrupt = false;
+  while (!decoder_.Next(out_frame, &corrupt))
+  {
+    if (corrupt || !Flush(out_cxn_closed))
+    {
+      return false;
+    }
+
+    // The response can't come before the request it answers has gone out.
+    size_t bytes_read = 0;
+    if (send_offset_ == send_size_ &&
+        !FillDecoder(&bytes_read, out_cxn_closed))
+    {
+      return false;
+    }
+
+    if (bytes_read == 0 && !WaitForStream())
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool ProtobufServer::FillDecoder(size_t *out_bytes_read, bool *out_cxn_closed)
+{
+  assert(out_bytes_read);
+  assert(out_cxn_closed);
+
+  // Read whatever the TLS layer has, up to the free space in the receive
+  // buffer. Split headers and multi-frame reads are sorted out by the
+  // decoder.
+  size_t capacity;
+  uint8_t *buffer = decoder_.GetWriteBuffer(MIN_READ_SIZE, &capacity);
+  if (!stream_->Read(buffer, capacity, out_bytes_read, out_cxn_closed) ||
+      *out_cxn_closed)
   {
-    LOG(ERROR) << "Failed to write TLS protobuf message";
     return false;
   }
 
-  if (out_cxn_closed)
+  decoder_.Commit(*out_bytes_read);
+  return true;
+}
+
+bool ProtobufServer::WaitForStream()
+{
+  // The socket stays non-blocking for the event loop, so blocking callers
+  // wait here instead.
+  struct pollfd poll_fd = {};
+  poll_fd.fd = stream_->GetFd();
+  if (poll_fd.fd < 0)
   {
-    *out_cxn_closed = cxn_closed;
+    LOG(ERROR) << "Server stream has no fd to wait on";
+    return false;
   }
 
+  poll_fd.events = stream_->WantsWrite() ? POLLOUT : POLLIN;
+  if (poll(&poll_fd, 1, -1) < 0 && errno != EINTR)
+  {
+    LOG(ERROR) << "Failed to wait on server stream: " << strerror(errno);
+    return false;
+  }
   return true;
 }
 
-const Fd &ProtobufServer::GetFd() const
+bool ProtobufServer::DecodeMessage(
+    const ProtobufFrame &frame,
+    OrganicDumpProtoMessage *out_msg)
 {
-  return cxn_.GetFd();
+  assert(out_msg);
+
+  // The server only ever sends BASIC_RESPONSE to clients. Any other frame
+  // has already been consumed whole, so the stream stays in sync: hand it
+  // up with just its type and let the caller reject it as a protocol error
+  // instead of tearing the connection down as if it had failed.
+  out_msg->type = static_cast<MessageType>(frame.type);
+  if (out_msg->type != MessageType::BASIC_RESPONSE)
+  {
+    LOG(WARNING) << "Skipping " << frame.body_size
+                 << " byte body of unexpected message type "
+                 << static_cast<int>(frame.type) << " from server";
+    return true;
+  }
+
+  if (!out_msg->basic_response.ParseFromArray(
+        frame.body,
+        static_cast<int>(frame.body_size)))
+  {
+    LOG(ERROR) << "Failed to parse BASIC_RESPONSE body";
+    return false;
+  }
+
+  return true;
 }
 
 void ProtobufServer::CloseResources()
@@ -98,7 +394,11 @@ void ProtobufServer::CloseResources()
   }
 
   is_initialized_ = false;
-  cxn_ = TlsConnection{};
+  stream_.reset();
+  decoder_.Reset();
+  send_offset_ = 0;
+  send_size_ = 0;
+  queued_frame_count_ = 0;
 }
 
 void ProtobufServer::StealResources(ProtobufServer *other)
@@ -106,7 +406,16 @@ void ProtobufServer::StealResources(ProtobufServer *other)
   assert(other);
   is_initialized_ = other->is_initialized_;
   other->is_initialized_ = false;
-  cxn_ = std::move(other->cxn_);
+  stream_ = std::move(other->stream_);
+  decoder_ = std::move(other->decoder_);
+  send_buffer_ = std::move(other->send_buffer_);
+  send_offset_ = other->send_offset_;
+  send_size_ = other->send_size_;
+  queued_frame_count_ = other->queued_frame_count_;
+  written_frame_count_ = other->written_frame_count_;
+  other->send_offset_ = 0;
+  other->send_size_ = 0;
+  other->queued_frame_count_ = 0;
 }
 
 } // namespace organicdump
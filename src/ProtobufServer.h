@@ -1,11 +1,20 @@
 #ifndef ORGANICDUMP_SERVER_PROTOBUFSERVER_H
 #define ORGANICDUMP_SERVER_PROTOBUFSERVER_H
 
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <google/protobuf/message_lite.h>
+#include <openssl/ssl.h>
+
 #include "organic_dump.pb.h"
 
-#include "Fd.h"
+#include "ByteStream.h"
+#include "FrameDecoder.h"
 #include "OrganicDumpProtoMessage.h"
-#include "TlsConnection.h"
+#include "ProtobufFrame.h"
 
 namespace organicdump
 {
@@ -14,15 +23,80 @@ class ProtobufServer
 {
 public:
   ProtobufServer();
-  ProtobufServer(network::TlsConnection cxn);
+  ProtobufServer(std::unique_ptr<ByteStream> stream);
   ProtobufServer(ProtobufServer&& other);
   ProtobufServer &operator=(ProtobufServer&& other);
   ~ProtobufServer();
+
+  /**
+   * Blocks until a whole message has arrived, first finishing any write a
+   * Flush() left part done.
+   */
   bool Read(OrganicDumpProtoMessage *out_msg, bool *out_cxn_closed=nullptr);
-  bool Write(OrganicDumpProtoMessage *msg, bool *out_cxn_closed=nullptr);
-  const network::Fd &GetFd() const;
+
+  /**
+   * Non-blocking form of Read(), for use once the fd has been reported
+   * ready. Issues at most one read on the connection and never waits.
+   * |out_has_message| is false if a full frame hasn't arrived yet, which
+   * includes the read finding nothing at all.
+   */
+  bool TryRead(
+      OrganicDumpProtoMessage *out_msg,
+      bool *out_has_message,
+      bool *out_cxn_closed=nullptr);
+
+  /**
+   * True if a message can be read without touching the socket.
+   */
+  bool HasBufferedMessage() const;
+  /**
+   * Frames |body| as a message of |type| and flushes it along with anything
+   * already queued.
+   */
+  bool Write(
+      organicdump_proto::MessageType type,
+      const google::protobuf::MessageLite &body,
+      bool *out_cxn_closed=nullptr);
+
+  /**
+   * Appends a framed message to the send buffer without writing it. Queued
+   * frames go out together, as one TLS record where they fit, on the next
+   * Flush() or Write().
+   */
+  void Queue(
+      organicdump_proto::MessageType type,
+      const google::protobuf::MessageLite &body);
+
+  /**
+   * Writes the send buffer as far as the socket takes it without blocking.
+   * Bytes it won't take stay buffered for the next Flush(), and WantsWrite()
+   * says to call it again once the fd is writable.
+   */
+  bool Flush(bool *out_cxn_closed=nullptr);
+  bool HasQueuedFrames() const;
+
+  /**
+   * True if the fd should be watched for writability: a Flush() left bytes
+   * unsent, or TLS has to write before a read can go on.
+   */
+  bool WantsWrite() const;
+
+  size_t GetWrittenFrameCount() const;
+
+  /**
+   * Writes issued on the connection, as counted by the stream. For TLS that
+   * is SSL_write calls, each one write() per 16 KiB record.
+   */
+  size_t GetWriteCallCount() const;
+  int GetFd() const;
+  bool EnableKeepalive(std::chrono::seconds period);
+  SSL *GetSsl() const;
 
 private:
+  bool ReadFrame(ProtobufFrame *out_frame, bool *out_cxn_closed);
+  bool FillDecoder(size_t *out_bytes_read, bool *out_cxn_closed);
+  bool WaitForStream();
+  bool DecodeMessage(const ProtobufFrame &frame, OrganicDumpProtoMessage *out_msg);
   void CloseResources();
   void StealResources(ProtobufServer *other);
 
@@ -32,7 +106,13 @@ private:
 
 private:
   bool is_initialized_;
-  network::TlsConnection cxn_;
+  std::unique_ptr<ByteStream> stream_;
+  FrameDecoder decoder_;
+  std::vector<uint8_t> send_buffer_;
+  size_t send_offset_;
+  size_t send_size_;
+  size_t queued_frame_count_;
+  size_t written_frame_count_;
 };
 
 } // namespace organicdump
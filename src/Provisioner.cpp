@@ -0,0 +1,164 @@
+#include "Provisioner.h"
+
+#include <cassert>
+#include <deque>
+#include <vector>
+
+#include <glog/logging.h>
+
+#include "ClientError.h"
+
+namespace organicdump
+{
+
+Provisioner::Provisioner(Client *client)
+  : client_{client}
+{
+  assert(client_);
+}
+
+bool Provisioner::Provision(ProvisioningManifest *manifest)
+{
+  assert(manifest);
+  assert(client_->GetPendingRequestCount() == 0);
+
+  const std::vector<SensorRegistration> &sensors = manifest->GetSensors();
+  std::vector<bool> is_owned(sensors.size(), false);
+  std::deque<PendingRequest> pending;
+  std::deque<size_t> unowned_sensors;
+  size_t next_sensor = 0;
+  size_t owned_count = 0;
+
+  // Probes registered by an earlier run still need handing to the Pi.
+  for (size_t i = 0; i < sensors.size(); ++i)
+  {
+    if (sensors[i].is_registered)
+    {
+      unowned_sensors.push_back(i);
+    }
+  }
+
+  // The server answers in order, so responses are matched to |pending|
+  // first-in-first-out. The Pi goes first so its id is back before any
+  // probe needs it.
+  if (!manifest->HasRpiId())
+  {
+    client_->PostRegisterRpi(
+        manifest->GetRpiName(),
+        manifest->GetRpiLocation());
+    pending.push_back(PendingRequest{RequestType::REGISTER_RPI, 0});
+  }
+
+  while (true)
+  {
+    while (next_sensor < sensors.size() && sensors[next_sensor].is_registered)
+    {
+      ++next_sensor;
+    }
+
+    if (pending.empty() &&
+        unowned_sensors.empty() &&
+        next_sensor == sensors.size())
+    {
+      break;
+    }
+
+    // Finish probes that are already registered before starting new ones,
+    // so a failure part way leaves as few unowned probes as possible.
+    while (client_->CanPostRequest() &&
+           manifest->HasRpiId() &&
+           !unowned_sensors.empty())
+    {
+      size_t sensor = unowned_sensors.front();
+      unowned_sensors.pop_front();
+      client_->PostPeripheralParent(
+          sensors[sensor].sensor_id,
+          manifest->GetRpiId());
+      pending.push_back(PendingRequest{RequestType::SET_OWNERSHIP, sensor});
+    }
+
+    while (client_->CanPostRequest() && next_sensor < sensors.size())
+    {
+      const SensorRegistration &sensor = sensors[next_sensor];
+      if (!sensor.is_registered)
+      {
+        client_->PostRegisterSoilMoistureSensor(
+            sensor.name,
+            sensor.location,
+            sensor.floor,
+            sensor.ceiling);
+        pending.push_back(
+            PendingRequest{RequestType::REGISTER_SENSOR, next_sensor});
+      }
+      ++next_sensor;
+    }
+
+    assert(!pending.empty());
+    PendingRequest request = pending.front();
+    pending.pop_front();
+
+    size_t id = 0;
+    ClientError error;
+    if (!client_->CompleteRequest(
+          request.type == RequestType::SET_OWNERSHIP ? nullptr : &id,
+          &error))
+    {
+      LOG(ERROR) << "Provisioning failed with " << GetClientErrorName(error);
+      LogProgress(*manifest, is_owned);
+      return false;
+    }
+
+    switch (request.type)
+    {
+      case RequestType::REGISTER_RPI:
+        LOG(INFO) << "Registered Pi " << manifest->GetRpiName() << " as "
+                  << id;
+        manifest->SetRpiId(id);
+        break;
+
+      case RequestType::REGISTER_SENSOR:
+        LOG(INFO) << "Registered sensor " << sensors[request.sensor].name
+                  << " as " << id;
+        manifest->SetSensorId(request.sensor, id);
+        unowned_sensors.push_back(request.sensor);
+        break;
+
+      case RequestType::SET_OWNERSHIP:
+        is_owned[request.sensor] = true;
+        ++owned_count;
+        break;
+    }
+  }
+
+  assert(owned_count == sensors.size());
+  assert(manifest->IsRegistered());
+  LOG(INFO) << "Provisioned Pi " << manifest->GetRpiId() << " with "
+            << owned_count << " sensors";
+  return true;
+}
+
+void Provisioner::LogProgress(
+    const ProvisioningManifest &manifest,
+    const std::vector<bool> &is_owned) const
+{
+  if (!manifest.HasRpiId())
+  {
+    LOG(ERROR) << "Pi " << manifest.GetRpiName() << " isn't registered";
+    return;
+  }
+
+  LOG(ERROR) << "Pi " << manifest.GetRpiName() << " registered as "
+             << manifest.GetRpiId();
+  const std::vector<SensorRegistration> &sensors = manifest.GetSensors();
+  for (size_t i = 0; i < sensors.size(); ++i)
+  {
+    if (sensors[i].is_registered)
+    {
+      LOG(ERROR) << "Sensor " << sensors[i].name << " registered as "
+                 << sensors[i].sensor_id
+                 << (is_owned[i] ? ", assigned to the Pi" : ", unassigned");
+    }
+  }
+}
+
+} // namespace organicdump
@@ -0,0 +1,64 @@
+#ifndef ORGANICDUMP_CLIENT_PROVISIONER_H
+#define ORGANICDUMP_CLIENT_PROVISIONER_H
+
+#include <cstddef>
+#include <vector>
+
+#include "Client.h"
+#include "ProvisioningManifest.h"
+
+namespace organicdump
+{
+
+/**
+ * Registers a rig described by a ProvisioningManifest over one connection.
+ * The Pi and every probe are registered with up to the client's pipeline
+ * window of requests in flight, and each probe is handed to the Pi as soon
+ * as both of their ids are back, so the whole rig costs one handshake and
+ * roughly one round trip per window of requests.
+ *
+ * Ids are recorded in the manifest as they arrive. A Pi or probe that the
+ * manifest already has an id for isn't registered again; probes are always
+ * handed to the Pi, which the server treats as idempotent. So a manifest
+ * saved after a failed run resumes where that run stopped.
+ */
+class Provisioner
+{
+public:
+  explicit Provisioner(Client *client);
+
+  /**
+   * On success, |manifest| is fully registered. On failure it still holds
+   * every id assigned before the failure.
+   */
+  bool Provision(ProvisioningManifest *manifest);
+
+private:
+  enum class RequestType
+  {
+    REGISTER_RPI,
+    REGISTER_SENSOR,
+    SET_OWNERSHIP,
+  };
+
+  struct PendingRequest
+  {
+    RequestType type;
+    size_t sensor;
+  };
+
+private:
+  Provisioner(const Provisioner &other) = delete;
+  Provisioner &operator=(const Provisioner &other) = delete;
+
+  void LogProgress(
+      const ProvisioningManifest &manifest,
+      const std::vector<bool> &is_owned) const;
+
+private:
+  Client *client_;
+};
+
+} // namespace organicdump
+
+#endif // ORGANICDUMP_CLIENT_PROVISIONER_H
@@ -0,0 +1,345 @@
+#include "ProvisioningManifest.h"
+
+#include <cassert>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <glog/logging.h>
+
+#include "SensorTopology.h"
+
+namespace
+{
+using organicdump::SensorRegistration;
+
+constexpr const char *RPI_JSON_NAME = "rpi";
+constexpr const char *RPI_ID_JSON_NAME = "rpi-id";
+constexpr const char *NAME_JSON_NAME = "name";
+constexpr const char *LOCATION_JSON_NAME = "location";
+constexpr const char *FLOOR_JSON_NAME = "floor";
+constexpr const char *CEILING_JSON_NAME = "ceiling";
+constexpr const char *ADCS_JSON_NAME = "adcs";
+constexpr const char *CHANNELS_JSON_NAME = "channels";
+constexpr const char *SENSOR_ID_JSON_NAME = "sensor-id";
+constexpr const char *SOIL_MOISTURE_SENSORS = "soil-moisture-sensors";
+constexpr const char *SOIL_MOISTURE_SENSOR_IDS = "soil-moisture-sensor-ids";
+
+bool ParseSensor(
+    const Json::Value &sensor,
+    const std::string &default_location,
+    std::vector<SensorRegistration> *out_sensors)
+{
+  assert(out_sensors);
+
+  if (!sensor[NAME_JSON_NAME].isString() ||
+      !sensor[FLOOR_JSON_NAME].isNumeric() ||
+      !sensor[CEILING_JSON_NAME].isNumeric())
+  {
+    LOG(ERROR) << "Soil moisture sensors need a name, floor and ceiling";
+    return false;
+  }
+
+  if (sensor.isMember(LOCATION_JSON_NAME) &&
+      !sensor[LOCATION_JSON_NAME].isString())
+  {
+    LOG(ERROR) << "Location of sensor " << sensor[NAME_JSON_NAME].asString()
+               << " must be a string";
+    return false;
+  }
+
+  // A sensor-id means an earlier run registered the sensor.
+  bool is_registered = sensor.isMember(SENSOR_ID_JSON_NAME);
+  if (is_registered && !sensor[SENSOR_ID_JSON_NAME].isUInt64())
+  {
+    LOG(ERROR) << "sensor-id of sensor " << sensor[NAME_JSON_NAME].asString()
+               << " must be an unsigned integer";
+    return false;
+  }
+
+  out_sensors->push_back(
+      SensorRegistration{
+          sensor[NAME_JSON_NAME].asString(),
+          sensor.get(LOCATION_JSON_NAME, default_location).asString(),
+          sensor[FLOOR_JSON_NAME].asDouble(),
+          sensor[CEILING_JSON_NAME].asDouble(),
+          is_registered,
+          is_registered ? sensor[SENSOR_ID_JSON_NAME].asUInt64() : 0});
+  return true;
+}
+
+// The document's sensor entries, in the order they're registered in.
+std::vector<Json::Value *> GetSensorEntries(Json::Value *root)
+{
+  assert(root);
+
+  std::vector<Json::Value *> entries;
+  if (root->isMember(ADCS_JSON_NAME))
+  {
+    Json::Value &adcs = (*root)[ADCS_JSON_NAME];
+    for (Json::ArrayIndex i = 0; i < adcs.size(); ++i)
+    {
+      Json::Value &channels = adcs[i][CHANNELS_JSON_NAME];
+      for (Json::ArrayIndex j = 0; j < channels.size(); ++j)
+      {
+        entries.push_back(&channels[j]);
+      }
+    }
+  }
+  else
+  {
+    Json::Value &sensors = (*root)[SOIL_MOISTURE_SENSORS];
+    for (Json::ArrayIndex i = 0; i < sensors.size(); ++i)
+    {
+      entries.push_back(&sensors[i]);
+    }
+  }
+  return entries;
+}
+
+} // namespace
+
+namespace organicdump
+{
+
+bool ProvisioningManifest::Parse(
+    Json::Value root,
+    ProvisioningManifest *out_manifest)
+{
+  assert(out_manifest);
+
+  const Json::Value &rpi = root[RPI_JSON_NAME];
+  if (!rpi[NAME_JSON_NAME].isString() || !rpi[LOCATION_JSON_NAME].isString())
+  {
+    LOG(ERROR) << "Manifest needs an rpi with a name and location";
+    return false;
+  }
+
+  // An rpi-id means an earlier run registered the Pi.
+  if (root.isMember(RPI_ID_JSON_NAME) && !root[RPI_ID_JSON_NAME].isUInt64())
+  {
+    LOG(ERROR) << "rpi-id must be an unsigned integer";
+    return false;
+  }
+
+  ProvisioningManifest manifest;
+  manifest.rpi_name_ = rpi[NAME_JSON_NAME].asString();
+  manifest.rpi_location_ = rpi[LOCATION_JSON_NAME].asString();
+  manifest.has_rpi_id_ = root.isMember(RPI_ID_JSON_NAME);
+  manifest.rpi_id_ = root.get(RPI_ID_JSON_NAME, 0).asUInt64();
+
+  // Sensors are registered in document order, which BuildMonitorConfig()
+  // walks again to fill in the ids.
+  if (root.isMember(ADCS_JSON_NAME))
+  {
+    const Json::Value &adcs = root[ADCS_JSON_NAME];
+    if (!adcs.isArray())
+    {
+      LOG(ERROR) << ADCS_JSON_NAME << " must be a list";
+      return false;
+    }
+
+    for (Json::ArrayIndex i = 0; i < adcs.size(); ++i)
+    {
+      const Json::Value &channels = adcs[i][CHANNELS_JSON_NAME];
+      if (!channels.isArray())
+      {
+        LOG(ERROR) << "ADC " << i << " has no channel list";
+        return false;
+      }
+
+      for (Json::ArrayIndex j = 0; j < channels.size(); ++j)
+      {
+        if (!ParseSensor(
+              channels[j],
+              manifest.rpi_location_,
+              &manifest.sensors_))
+        {
+          return false;
+        }
+      }
+    }
+  }
+  else
+  {
+    const Json::Value &sensors = root[SOIL_MOISTURE_SENSORS];
+    if (!sensors.isArray())
+    {
+      LOG(ERROR) << "Manifest needs " << ADCS_JSON_NAME << " or "
+                 << SOIL_MOISTURE_SENSORS;
+      return false;
+    }
+
+    for (Json::ArrayIndex i = 0; i < sensors.size(); ++i)
+    {
+      if (!ParseSensor(
+            sensors[i],
+            manifest.rpi_location_,
+            &manifest.sensors_))
+      {
+        return false;
+      }
+    }
+  }
+
+  if (manifest.sensors_.empty())
+  {
+    LOG(ERROR) << "Manifest has no soil moisture sensors";
+    return false;
+  }
+
+  // Catch wiring mistakes before anything is registered. Placeholder ids
+  // stand in for the ones the server will assign.
+  std::vector<size_t> placeholder_ids;
+  for (size_t i = 0; i < manifest.sensors_.size(); ++i)
+  {
+    placeholder_ids.push_back(i);
+  }
+
+  manifest.root_ = std::move(root);
+  Json::Value config;
+  if (!manifest.BuildMonitorConfig(0, placeholder_ids, &config))
+  {
+    LOG(ERROR) << "Manifest doesn't describe a valid sensor topology";
+    return false;
+  }
+
+  *out_manifest = std::move(manifest);
+  return true;
+}
+
+ProvisioningManifest::ProvisioningManifest()
+  : has_rpi_id_{false},
+    rpi_id_{0} {}
+
+const std::string &ProvisioningManifest::GetRpiName() const
+{
+  return rpi_name_;
+}
+
+const std::string &ProvisioningManifest::GetRpiLocation() const
+{
+  return rpi_location_;
+}
+
+bool ProvisioningManifest::HasRpiId() const
+{
+  return has_rpi_id_;
+}
+
+size_t ProvisioningManifest::GetRpiId() const
+{
+  assert(has_rpi_id_);
+  return rpi_id_;
+}
+
+void ProvisioningManifest::SetRpiId(size_t rpi_id)
+{
+  has_rpi_id_ = true;
+  rpi_id_ = rpi_id;
+}
+
+const std::vector<SensorRegistration> &ProvisioningManifest::GetSensors() const
+{
+  return sensors_;
+}
+
+void ProvisioningManifest::SetSensorId(size_t sensor, size_t sensor_id)
+{
+  assert(sensor < sensors_.size());
+  sensors_[sensor].is_registered = true;
+  sensors_[sensor].sensor_id = sensor_id;
+}
+
+bool ProvisioningManifest::IsRegistered() const
+{
+  for (const SensorRegistration &sensor : sensors_)
+  {
+    if (!sensor.is_registered)
+    {
+      return false;
+    }
+  }
+  return has_rpi_id_;
+}
+
+void ProvisioningManifest::BuildManifest(Json::Value *out_manifest) const
+{
+  assert(out_manifest);
+
+  Json::Value manifest = root_;
+  manifest.removeMember(RPI_ID_JSON_NAME);
+  if (has_rpi_id_)
+  {
+    manifest[RPI_ID_JSON_NAME] = static_cast<Json::UInt64>(rpi_id_);
+  }
+
+  std::vector<Json::Value *> entries = GetSensorEntries(&manifest);
+  assert(entries.size() == sensors_.size());
+  for (size_t i = 0; i < entries.size(); ++i)
+  {
+    entries[i]->removeMember(SENSOR_ID_JSON_NAME);
+    if (sensors_[i].is_registered)
+    {
+      (*entries[i])[SENSOR_ID_JSON_NAME] =
+          static_cast<Json::UInt64>(sensors_[i].sensor_id);
+    }
+  }
+
+  *out_manifest = std::move(manifest);
+}
+
+bool ProvisioningManifest::BuildMonitorConfig(Json::Value *out_config) const
+{
+  assert(IsRegistered());
+
+  std::vector<size_t> sensor_ids;
+  for (const SensorRegistration &sensor : sensors_)
+  {
+    sensor_ids.push_back(sensor.sensor_id);
+  }
+  return BuildMonitorConfig(rpi_id_, sensor_ids, out_config);
+}
+
+bool ProvisioningManifest::BuildMonitorConfig(
+    size_t rpi_id,
+    const std::vector<size_t> &sensor_ids,
+    Json::Value *out_config) const
+{
+  assert(out_config);
+  assert(sensor_ids.size() == sensors_.size());
+
+  Json::Value config = root_;
+  config[RPI_ID_JSON_NAME] = static_cast<Json::UInt64>(rpi_id);
+
+  if (config.isMember(ADCS_JSON_NAME))
+  {
+    std::vector<Json::Value *> entries = GetSensorEntries(&config);
+    for (size_t i = 0; i < entries.size(); ++i)
+    {
+      (*entries[i])[SENSOR_ID_JSON_NAME] =
+          static_cast<Json::UInt64>(sensor_ids[i]);
+    }
+  }
+  else
+  {
+    Json::Value &ids = config[SOIL_MOISTURE_SENSOR_IDS];
+    ids = Json::Value{Json::arrayValue};
+    for (size_t sensor_id : sensor_ids)
+    {
+      ids.append(static_cast<Json::UInt64>(sensor_id));
+    }
+  }
+
+  // The monitor must accept what provisioning writes.
+  SensorTopology topology;
+  if (!SensorTopology::Parse(config, &topology))
+  {
+    return false;
+  }
+
+  *out_config = std::move(config);
+  return true;
+}
+
+} // namespace organicdump
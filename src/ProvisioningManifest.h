@@ -0,0 +1,98 @@
+#ifndef ORGANICDUMP_CLIENT_PROVISIONINGMANIFEST_H
+#define ORGANICDUMP_CLIENT_PROVISIONINGMANIFEST_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include <json/json.h>
+
+namespace organicdump
+{
+
+/**
+ * One soil moisture probe to register with the server, and its id once it
+ * has one.
+ */
+struct SensorRegistration
+{
+  std::string name;
+  std::string location;
+  double floor;
+  double ceiling;
+  bool is_registered;
+  size_t sensor_id;
+};
+
+/**
+ * Describes a rig to commission: the Pi and every probe on it. A manifest is
+ * a monitor config with registration details in place of server ids:
+ *
+ *   {
+ *     "rpi": {"name": "bench-1", "location": "greenhouse"},
+ *     "adcs": [
+ *       {"bus": 1, "address": "0x49", "channels": [
+ *         {"channel": 0, "name": "tomato-1", "floor": 9000, "ceiling": 21000,
+ *          "period": 60}]}]
+ *   }
+ *
+ * Rigs on the original wiring can list "soil-moisture-sensors" instead of
+ * "adcs". A sensor's "location" defaults to the Pi's.
+ *
+ * Ids are recorded in the manifest as the server assigns them. An "rpi-id"
+ * or a sensor's "sensor-id" already in the document marks that part of the
+ * rig as registered, so a manifest saved by BuildManifest() after a failed
+ * run picks up where it stopped. Once everything has an id,
+ * BuildMonitorConfig() fills them into the same document.
+ */
+class ProvisioningManifest
+{
+public:
+  static bool Parse(Json::Value root, ProvisioningManifest *out_manifest);
+
+public:
+  ProvisioningManifest();
+
+  const std::string &GetRpiName() const;
+  const std::string &GetRpiLocation() const;
+  bool HasRpiId() const;
+  size_t GetRpiId() const;
+  void SetRpiId(size_t rpi_id);
+  const std::vector<SensorRegistration> &GetSensors() const;
+  void SetSensorId(size_t sensor, size_t sensor_id);
+
+  /**
+   * True once the Pi and every sensor have ids.
+   */
+  bool IsRegistered() const;
+
+  /**
+   * Writes the manifest back out with every id assigned so far.
+   */
+  void BuildManifest(Json::Value *out_manifest) const;
+
+  /**
+   * Writes the monitor config for a registered rig: the manifest with
+   * "rpi-id" and each probe's "sensor-id" filled in, or
+   * "soil-moisture-sensor-ids" for the original wiring.
+   */
+  bool BuildMonitorConfig(Json::Value *out_config) const;
+
+private:
+  bool BuildMonitorConfig(
+      size_t rpi_id,
+      const std::vector<size_t> &sensor_ids,
+      Json::Value *out_config) const;
+
+private:
+  Json::Value root_;
+  std::string rpi_name_;
+  std::string rpi_location_;
+  bool has_rpi_id_;
+  size_t rpi_id_;
+  std::vector<SensorRegistration> sensors_;
+};
+
+} // namespace organicdump
+
+#endif // ORGANICDUMP_CLIENT_PROVISIONINGMANIFEST_H
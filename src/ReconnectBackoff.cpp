@@ -0,0 +1,105 @@
+#include "ReconnectBackoff.h"
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+
+#include <glog/logging.h>
+
+namespace organicdump
+{
+
+ReconnectBackoff::ReconnectBackoff()
+  : ReconnectBackoff(
+        ReconnectPolicy{
+            std::chrono::milliseconds{0},
+            std::chrono::milliseconds{0},
+            0,
+            std::chrono::seconds{0}},
+        0) {}
+
+ReconnectBackoff::ReconnectBackoff(ReconnectPolicy policy, uint32_t seed)
+  : policy_{policy},
+    random_{seed},
+    last_delay_{policy.base_delay},
+    consecutive_server_errors_{0},
+    breaker_trip_count_{0} {}
+
+std::chrono::milliseconds ReconnectBackoff::OnSessionClosed()
+{
+  // Reconnect straight away. The jitter only keeps sessions the server
+  // closed together from reconnecting in the same instant.
+  return DrawJitter(policy_.base_delay);
+}
+
+std::chrono::milliseconds ReconnectBackoff::OnFailure(ClientError error)
+{
+  if (error == ClientError::SERVER)
+  {
+    ++consecutive_server_errors_;
+    if (policy_.breaker_threshold > 0 &&
+        consecutive_server_errors_ >= policy_.breaker_threshold)
+    {
+      // Open, or reopen after a failed trial connection. The cooldown is
+      // jittered too so tripped clients don't return together.
+      if (consecutive_server_errors_ == policy_.breaker_threshold)
+      {
+        ++breaker_trip_count_;
+        LOG(WARNING) << "Server failed " << consecutive_server_errors_
+                     << " times in a row. Holding off for "
+                     << policy_.breaker_cooldown.count() << " seconds";
+      }
+      return std::chrono::duration_cast<std::chrono::milliseconds>(
+          policy_.breaker_cooldown) +
+          DrawJitter(std::max(policy_.base_delay, policy_.max_delay));
+    }
+  }
+
+  return DrawDelay();
+}
+
+void ReconnectBackoff::OnSuccess()
+{
+  last_delay_ = policy_.base_delay;
+  consecutive_server_errors_ = 0;
+}
+
+bool ReconnectBackoff::IsBreakerOpen() const
+{
+  return policy_.breaker_threshold > 0 &&
+         consecutive_server_errors_ >= policy_.breaker_threshold;
+}
+
+size_t ReconnectBackoff::GetBreakerTripCount() const
+{
+  return breaker_trip_count_;
+}
+
+std::chrono::milliseconds ReconnectBackoff::DrawJitter(
+    std::chrono::milliseconds high)
+{
+  if (high.count() <= 0)
+  {
+    return std::chrono::milliseconds{0};
+  }
+
+  std::uniform_int_distribution<std::chrono::milliseconds::rep> distribution{
+      0,
+      high.count()};
+  return std::chrono::milliseconds{distribution(random_)};
+}
+
+std::chrono::milliseconds ReconnectBackoff::DrawDelay()
+{
+  auto low = policy_.base_delay.count();
+  auto high = std::max(low, 3 * last_delay_.count());
+  std::uniform_int_distribution<std::chrono::milliseconds::rep> distribution{
+      low,
+      high};
+  last_delay_ = std::min(
+      std::chrono::milliseconds{distribution(random_)},
+      policy_.max_delay);
+  return last_delay_;
+}
+
+} // namespace organicdump
@@ -0,0 +1,65 @@
+#ifndef ORGANICDUMP_CLIENT_RECONNECTBACKOFF_H
+#define ORGANICDUMP_CLIENT_RECONNECTBACKOFF_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+
+#include "ClientError.h"
+#include "ReconnectPolicy.h"
+
+namespace organicdump
+{
+
+/**
+ * Picks reconnect delays for one server session per the ReconnectPolicy.
+ * Each delay is drawn between the base delay and three times the previous
+ * one, capped at the maximum ("decorrelated jitter"), which spreads clients
+ * out while still backing off exponentially.
+ */
+class ReconnectBackoff
+{
+public:
+  ReconnectBackoff();
+  ReconnectBackoff(ReconnectPolicy policy, uint32_t seed);
+
+  /**
+   * Delay before reconnecting after a session that had been serving was
+   * closed cleanly by the server: a small jitter up to the base delay,
+   * without growing the backoff.
+   */
+  std::chrono::milliseconds OnSessionClosed();
+
+  /**
+   * Delay before reconnecting after a failure of kind |error|.
+   */
+  std::chrono::milliseconds OnFailure(ClientError error);
+
+  /**
+   * The server answered a request. Resets the backoff and closes the breaker.
+   */
+  void OnSuccess();
+
+  /**
+   * True while server errors keep the breaker open. The next connect after
+   * the cooldown is a trial.
+   */
+  bool IsBreakerOpen() const;
+  size_t GetBreakerTripCount() const;
+
+private:
+  std::chrono::milliseconds DrawJitter(std::chrono::milliseconds high);
+  std::chrono::milliseconds DrawDelay();
+
+private:
+  ReconnectPolicy policy_;
+  std::mt19937 random_;
+  std::chrono::milliseconds last_delay_;
+  size_t consecutive_server_errors_;
+  size_t breaker_trip_count_;
+};
+
+} // namespace organicdump
+
+#endif // ORGANICDUMP_CLIENT_RECONNECTBACKOFF_H
@@ -0,0 +1,32 @@
+#ifndef ORGANICDUMP_CLIENT_RECONNECTPOLICY_H
+#define ORGANICDUMP_CLIENT_RECONNECTPOLICY_H
+
+#include <chrono>
+#include <cstddef>
+
+namespace organicdump
+{
+
+/**
+ * How long to wait before reconnecting after a session fails. Delays grow
+ * exponentially with decorrelated jitter between |base_delay| and
+ * |max_delay|, so a fleet that lost the server at the same moment doesn't
+ * come back in lockstep. A session the server closed cleanly after serving
+ * reconnects straight away, after a jitter of at most |base_delay|.
+ *
+ * |breaker_threshold| server errors in a row open the circuit breaker, which
+ * holds off for |breaker_cooldown| before trying again.
+ */
+struct ReconnectPolicy
+{
+  std::chrono::milliseconds base_delay;
+  std::chrono::milliseconds max_delay;
+
+  // 0 disables the breaker.
+  size_t breaker_threshold;
+  std::chrono::seconds breaker_cooldown;
+};
+
+} // namespace organicdump
+
+#endif // ORGANICDUMP_CLIENT_RECONNECTPOLICY_H
@@ -0,0 +1,45 @@
+#include "RpiHardwareBackend.h"
+
+#include <chrono>
+#include <memory>
+#include <utility>
+
+#include <glog/logging.h>
+
+#include "Ads1115Registers.h"
+
+namespace organicdump
+{
+
+RpiHardwareBackend::RpiHardwareBackend(
+    std::chrono::milliseconds i2c_timeout,
+    Ads1115Policy adc_policy)
+  : i2c_timeout_{i2c_timeout},
+    adc_policy_{adc_policy} {}
+
+I2cBus *RpiHardwareBackend::OpenBus(int bus_number)
+{
+  auto bus = buses_.find(bus_number);
+  if (bus != buses_.end())
+  {
+    return bus->second.get();
+  }
+
+  std::unique_ptr<LinuxI2cBus> linux_bus{new LinuxI2cBus};
+  if (!LinuxI2cBus::Open(bus_number, i2c_timeout_, linux_bus.get()))
+  {
+    LOG(ERROR) << "Failed to open I2C bus " << bus_number;
+    return nullptr;
+  }
+
+  I2cBus *opened = linux_bus.get();
+  buses_[bus_number] = std::move(linux_bus);
+  return opened;
+}
+
+std::chrono::microseconds RpiHardwareBackend::GetConversionTime() const
+{
+  return ads1115::GetConversionTime(adc_policy_.data_rate_sps);
+}
+
+} // namespace organicdump
@@ -0,0 +1,41 @@
+#ifndef ORGANICDUMP_CLIENT_RPIHARDWAREBACKEND_H
+#define ORGANICDUMP_CLIENT_RPIHARDWAREBACKEND_H
+
+#include <chrono>
+#include <map>
+#include <memory>
+
+#include "Ads1115Policy.h"
+#include "HardwareBackend.h"
+#include "I2cBus.h"
+#include "LinuxI2cBus.h"
+
+namespace organicdump
+{
+
+/**
+ * ADS1115s wired to the Pi's I2C buses, reached through /dev/i2c-N.
+ */
+class RpiHardwareBackend : public HardwareBackend
+{
+public:
+  RpiHardwareBackend(
+      std::chrono::milliseconds i2c_timeout,
+      Ads1115Policy adc_policy);
+
+  I2cBus *OpenBus(int bus_number) override;
+  std::chrono::microseconds GetConversionTime() const override;
+
+private:
+  RpiHardwareBackend(const RpiHardwareBackend &other) = delete;
+  RpiHardwareBackend &operator=(const RpiHardwareBackend &other) = delete;
+
+private:
+  std::chrono::milliseconds i2c_timeout_;
+  Ads1115Policy adc_policy_;
+  std::map<int, std::unique_ptr<LinuxI2cBus>> buses_;
+};
+
+} // namespace organicdump
+
+#endif // ORGANICDUMP_CLIENT_RPIHARDWAREBACKEND_H
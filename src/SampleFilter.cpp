@@ -0,0 +1,118 @@
+#include "SampleFilter.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+namespace
+{
+
+// Plain loop over the raw samples. 16-bit inputs widened into a 32-bit
+// accumulator vectorize at -O2 and up, which matters once several ADCs share
+// one sampler.
+uint32_t Sum(const uint16_t *samples, size_t count)
+{
+  uint32_t sum = 0;
+  for (size_t i = 0; i < count; ++i)
+  {
+    sum += samples[i];
+  }
+  return sum;
+}
+
+} // namespace
+
+namespace organicdump
+{
+
+SampleFilter::SampleFilter(OversamplingPolicy policy)
+  : policy_{policy}
+{
+  scratch_.reserve(policy_.sample_count);
+}
+
+double SampleFilter::Apply(
+    size_t sensor_id,
+    const uint16_t *samples,
+    size_t count)
+{
+  assert(samples);
+  assert(count > 0);
+
+  switch (policy_.filter)
+  {
+    case SampleFilterType::MEDIAN:
+      return Median(samples, count);
+    case SampleFilterType::TRIMMED_MEAN:
+      return TrimmedMean(samples, count);
+    case SampleFilterType::EWMA:
+      return Ewma(sensor_id, samples, count);
+    case SampleFilterType::MEAN:
+    default:
+      return Mean(samples, count);
+  }
+}
+
+double SampleFilter::Mean(const uint16_t *samples, size_t count) const
+{
+  return static_cast<double>(Sum(samples, count)) / count;
+}
+
+double SampleFilter::Median(const uint16_t *samples, size_t count)
+{
+  scratch_.assign(samples, samples + count);
+  auto middle = scratch_.begin() + count / 2;
+  std::nth_element(scratch_.begin(), middle, scratch_.end());
+  if (count % 2 == 1)
+  {
+    return *middle;
+  }
+
+  // Even count: average the two middle values. The lower one is the largest
+  // of the partition below |middle|.
+  uint16_t lower = *std::max_element(scratch_.begin(), middle);
+  return (static_cast<double>(lower) + *middle) / 2;
+}
+
+double SampleFilter::TrimmedMean(const uint16_t *samples, size_t count)
+{
+  size_t trim_count =
+      static_cast<size_t>(std::floor(count * policy_.trim_fraction));
+  if (2 * trim_count >= count)
+  {
+    trim_count = (count - 1) / 2;
+  }
+
+  scratch_.assign(samples, samples + count);
+  std::sort(scratch_.begin(), scratch_.end());
+  return Mean(scratch_.data() + trim_count, count - 2 * trim_count);
+}
+
+double SampleFilter::Ewma(
+    size_t sensor_id,
+    const uint16_t *samples,
+    size_t count)
+{
+  // A new sensor's average starts at its first conversion, which then must
+  // not be folded in a second time.
+  size_t first = 0;
+  auto state = ewma_state_.find(sensor_id);
+  if (state == ewma_state_.end())
+  {
+    state = ewma_state_.emplace(sensor_id, samples[0]).first;
+    first = 1;
+  }
+
+  double average = state->second;
+  for (size_t i = first; i < count; ++i)
+  {
+    average += policy_.ewma_alpha * (samples[i] - average);
+  }
+
+  state->second = average;
+  return average;
+}
+
+} // namespace organicdump
@@ -0,0 +1,45 @@
+#ifndef ORGANICDUMP_CLIENT_SAMPLEFILTER_H
+#define ORGANICDUMP_CLIENT_SAMPLEFILTER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "OversamplingPolicy.h"
+
+namespace organicdump
+{
+
+/**
+ * Reduces a burst of raw ADC conversions from one sensor to a single value.
+ * Keeps moving average state per sensor, so one filter serves every channel
+ * on the sampler thread. Not thread safe.
+ */
+class SampleFilter
+{
+public:
+  explicit SampleFilter(OversamplingPolicy policy);
+
+  /**
+   * Returns the filtered value of |count| conversions from |sensor_id|.
+   * |count| must be positive.
+   */
+  double Apply(size_t sensor_id, const uint16_t *samples, size_t count);
+
+private:
+  double Mean(const uint16_t *samples, size_t count) const;
+  double Median(const uint16_t *samples, size_t count);
+  double TrimmedMean(const uint16_t *samples, size_t count);
+  double Ewma(size_t sensor_id, const uint16_t *samples, size_t count);
+
+private:
+  OversamplingPolicy policy_;
+  // Reused for the order statistics so filtering doesn't allocate per period.
+  std::vector<uint16_t> scratch_;
+  std::unordered_map<size_t, double> ewma_state_;
+};
+
+} // namespace organicdump
+
+#endif // ORGANICDUMP_CLIENT_SAMPLEFILTER_H
@@ -0,0 +1,303 @@
+#include "SensorTopology.h"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <set>
+#include <string>
+#include <tuple>
+#include <utility>
+
+#include <glog/logging.h>
+
+namespace
+{
+using I2c::Ads1115Channel;
+using organicdump::SensorChannel;
+
+constexpr const char *ADCS_JSON_NAME = "adcs";
+constexpr const char *BUS_JSON_NAME = "bus";
+constexpr const char *ADDRESS_JSON_NAME = "address";
+constexpr const char *CHANNELS_JSON_NAME = "channels";
+constexpr const char *CHANNEL_JSON_NAME = "channel";
+constexpr const char *SENSOR_ID_JSON_NAME = "sensor-id";
+constexpr const char *PERIOD_JSON_NAME = "period";
+constexpr const char *PHASE_OFFSET_JSON_NAME = "phase-offset";
+constexpr const char *SOIL_MOISTURE_SENSOR_IDS = "soil-moisture-sensor-ids";
+
+// The Pi exposes I2C buses 0 and 1.
+constexpr int MAX_BUS = 1;
+
+// An ADS1115 answers on one of four addresses picked by its ADDR pin.
+constexpr unsigned int MIN_ADS1115_ADDRESS = 0x48;
+constexpr unsigned int MAX_ADS1115_ADDRESS = 0x4b;
+constexpr size_t ADS1115_CHANNEL_COUNT = 4;
+
+// Wiring of the original single-ADC rig.
+constexpr int LEGACY_BUS = 1;
+constexpr uint8_t LEGACY_ADDRESS = 0x49;
+
+const Ads1115Channel ADS1115_CHANNELS[ADS1115_CHANNEL_COUNT] =
+{
+  Ads1115Channel::CHANNEL_0,
+  Ads1115Channel::CHANNEL_1,
+  Ads1115Channel::CHANNEL_2,
+  Ads1115Channel::CHANNEL_3,
+};
+
+bool ParseAddress(const Json::Value &value, uint8_t *out_address)
+{
+  assert(out_address);
+
+  unsigned long address;
+  if (value.isString())
+  {
+    // Accepts "0x49" as well as "73".
+    std::string text = value.asString();
+    char *end = nullptr;
+    address = std::strtoul(text.c_str(), &end, 0);
+    if (text.empty() || *end != '\0')
+    {
+      LOG(ERROR) << "Invalid ADC address: " << text;
+      return false;
+    }
+  }
+  else if (value.isUInt())
+  {
+    address = value.asUInt();
+  }
+  else
+  {
+    LOG(ERROR) << "ADC address must be a number or string";
+    return false;
+  }
+
+  if (address < MIN_ADS1115_ADDRESS || address > MAX_ADS1115_ADDRESS)
+  {
+    LOG(ERROR) << "ADC address " << address << " is not an ADS1115 address";
+    return false;
+  }
+
+  *out_address = static_cast<uint8_t>(address);
+  return true;
+}
+
+bool ParseSeconds(
+    const Json::Value &channel,
+    const char *name,
+    std::chrono::milliseconds *out_duration)
+{
+  assert(out_duration);
+
+  if (!channel.isMember(name))
+  {
+    *out_duration = std::chrono::milliseconds{0};
+    return true;
+  }
+
+  if (!channel[name].isNumeric() || channel[name].asDouble() < 0)
+  {
+    LOG(ERROR) << "ADC channel " << name << " must be a non-negative number "
+               << "of seconds";
+    return false;
+  }
+
+  *out_duration = std::chrono::milliseconds{
+      std::llround(channel[name].asDouble() * 1000)};
+  return true;
+}
+
+bool ParseAdc(const Json::Value &adc, std::vector<SensorChannel> *out_channels)
+{
+  assert(out_channels);
+
+  if (!adc[BUS_JSON_NAME].isInt() ||
+      adc[BUS_JSON_NAME].asInt() < 0 ||
+      adc[BUS_JSON_NAME].asInt() > MAX_BUS)
+  {
+    LOG(ERROR) << "ADC bus must be 0 or 1";
+    return false;
+  }
+  int bus = adc[BUS_JSON_NAME].asInt();
+
+  uint8_t address;
+  if (!ParseAddress(adc[ADDRESS_JSON_NAME], &address))
+  {
+    return false;
+  }
+
+  const Json::Value &channels = adc[CHANNELS_JSON_NAME];
+  if (!channels.isArray())
+  {
+    LOG(ERROR) << "ADC on bus " << bus << " has no channel list";
+    return false;
+  }
+
+  for (Json::ArrayIndex i = 0; i < channels.size(); ++i)
+  {
+    const Json::Value &channel = channels[i];
+    if (!channel[CHANNEL_JSON_NAME].isUInt() ||
+        channel[CHANNEL_JSON_NAME].asUInt() >= ADS1115_CHANNEL_COUNT ||
+        !channel[SENSOR_ID_JSON_NAME].isUInt64())
+    {
+      LOG(ERROR) << "ADC channels need a channel in 0-3 and a sensor-id";
+      return false;
+    }
+
+    std::chrono::milliseconds period;
+    std::chrono::milliseconds phase_offset;
+    if (!ParseSeconds(channel, PERIOD_JSON_NAME, &period) ||
+        !ParseSeconds(channel, PHASE_OFFSET_JSON_NAME, &phase_offset))
+    {
+      return false;
+    }
+
+    out_channels->push_back(
+        SensorChannel{
+            bus,
+            address,
+            ADS1115_CHANNELS[channel[CHANNEL_JSON_NAME].asUInt()],
+            static_cast<size_t>(channel[SENSOR_ID_JSON_NAME].asUInt64()),
+            period,
+            phase_offset});
+  }
+
+  return true;
+}
+
+bool ParseLegacy(
+    const Json::Value &sensor_ids,
+    std::vector<SensorChannel> *out_channels)
+{
+  assert(out_channels);
+
+  if (!sensor_ids.isArray() || sensor_ids.size() > ADS1115_CHANNEL_COUNT)
+  {
+    LOG(ERROR) << SOIL_MOISTURE_SENSOR_IDS << " must list at most "
+               << ADS1115_CHANNEL_COUNT << " ids";
+    return false;
+  }
+
+  for (Json::ArrayIndex i = 0; i < sensor_ids.size(); ++i)
+  {
+    out_channels->push_back(
+        SensorChannel{
+            LEGACY_BUS,
+            LEGACY_ADDRESS,
+            ADS1115_CHANNELS[i],
+            static_cast<size_t>(sensor_ids[i].asUInt64()),
+            std::chrono::milliseconds{0},
+            std::chrono::milliseconds{0}});
+  }
+
+  return true;
+}
+
+} // namespace
+
+namespace organicdump
+{
+
+bool SensorTopology::Parse(const Json::Value &root, SensorTopology *out_topology)
+{
+  assert(out_topology);
+
+  std::vector<SensorChannel> channels;
+  if (root.isMember(ADCS_JSON_NAME))
+  {
+    const Json::Value &adcs = root[ADCS_JSON_NAME];
+    if (!adcs.isArray())
+    {
+      LOG(ERROR) << ADCS_JSON_NAME << " must be a list";
+      return false;
+    }
+
+    for (Json::ArrayIndex i = 0; i < adcs.size(); ++i)
+    {
+      if (!ParseAdc(adcs[i], &channels))
+      {
+        return false;
+      }
+    }
+  }
+  else if (!ParseLegacy(root[SOIL_MOISTURE_SENSOR_IDS], &channels))
+  {
+    return false;
+  }
+
+  if (channels.empty())
+  {
+    LOG(ERROR) << "Sensor topology has no soil moisture sensors";
+    return false;
+  }
+
+  std::set<std::tuple<int, uint8_t, Ads1115Channel>> inputs;
+  std::set<size_t> sensor_ids;
+  for (const SensorChannel &channel : channels)
+  {
+    if (!inputs.emplace(channel.bus, channel.address, channel.channel).second)
+    {
+      LOG(ERROR) << "Bus " << channel.bus << " address "
+                 << static_cast<int>(channel.address) << " channel "
+                 << static_cast<int>(channel.channel) << " is listed twice";
+      return false;
+    }
+
+    if (!sensor_ids.insert(channel.sensor_id).second)
+    {
+      LOG(ERROR) << "Sensor " << channel.sensor_id << " is listed twice";
+      return false;
+    }
+  }
+
+  // Grouped by bus and device so a sweep switches slave address as rarely
+  // as possible.
+  std::sort(
+      channels.begin(),
+      channels.end(),
+      [](const SensorChannel &lhs, const SensorChannel &rhs)
+      {
+        return std::tie(lhs.bus, lhs.address, lhs.channel) <
+               std::tie(rhs.bus, rhs.address, rhs.channel);
+      });
+
+  *out_topology = SensorTopology{std::move(channels)};
+  return true;
+}
+
+SensorTopology::SensorTopology() {}
+
+SensorTopology::SensorTopology(std::vector<SensorChannel> channels)
+  : channels_{std::move(channels)} {}
+
+const std::vector<SensorChannel> &SensorTopology::GetChannels() const
+{
+  return channels_;
+}
+
+std::vector<SensorChannel> SensorTopology::GetBusChannels(int bus) const
+{
+  std::vector<SensorChannel> bus_channels;
+  for (const SensorChannel &channel : channels_)
+  {
+    if (channel.bus == bus)
+    {
+      bus_channels.push_back(channel);
+    }
+  }
+  return bus_channels;
+}
+
+std::vector<int> SensorTopology::GetBuses() const
+{
+  std::set<int> buses;
+  for (const SensorChannel &channel : channels_)
+  {
+    buses.insert(channel.bus);
+  }
+  return std::vector<int>{buses.begin(), buses.end()};
+}
+
+} // namespace organicdump
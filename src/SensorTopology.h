@@ -0,0 +1,73 @@
+#ifndef ORGANICDUMP_CLIENT_SENSORTOPOLOGY_H
+#define ORGANICDUMP_CLIENT_SENSORTOPOLOGY_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <json/json.h>
+
+#include "I2c/Devices/Ads1115AnalogToDigitalConverter/Ads1115Channel.h"
+
+namespace organicdump
+{
+
+/**
+ * One soil moisture probe: the ADS1115 input it's wired to, its sensor id on
+ * the server, and when it's sampled.
+ */
+struct SensorChannel
+{
+  int bus;
+  uint8_t address;
+  I2c::Ads1115Channel channel;
+  size_t sensor_id;
+
+  // Sampling period of this probe. Zero uses the daemon's measurement period.
+  std::chrono::milliseconds period;
+
+  // Delay of the probe's first reading after the sampler starts, which
+  // staggers probes that share a period.
+  std::chrono::milliseconds phase_offset;
+};
+
+/**
+ * Flat table of every probe on the Pi, built from the "adcs" list of the
+ * monitor config:
+ *
+ *   "adcs": [
+ *     {"bus": 1, "address": "0x49", "channels": [
+ *       {"channel": 0, "sensor-id": 12},
+ *       {"channel": 1, "sensor-id": 13, "period": 60, "phase-offset": 2.5}]}]
+ *
+ * "period" and "phase-offset" are optional and given in seconds.
+ *
+ * Configs without "adcs" keep the original wiring: the ids in
+ * "soil-moisture-sensor-ids" on channels 0 and up of the ADS1115 at 0x49 on
+ * bus 1.
+ */
+class SensorTopology
+{
+public:
+  static bool Parse(const Json::Value &root, SensorTopology *out_topology);
+
+public:
+  SensorTopology();
+  explicit SensorTopology(std::vector<SensorChannel> channels);
+
+  const std::vector<SensorChannel> &GetChannels() const;
+  std::vector<SensorChannel> GetBusChannels(int bus) const;
+
+  /**
+   * Buses with at least one probe, in ascending order.
+   */
+  std::vector<int> GetBuses() const;
+
+private:
+  std::vector<SensorChannel> channels_;
+};
+
+} // namespace organicdump
+
+#endif // ORGANICDUMP_CLIENT_SENSORTOPOLOGY_H
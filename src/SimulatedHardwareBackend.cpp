@@ -0,0 +1,117 @@
+#include "SimulatedHardwareBackend.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <random>
+
+#include <glog/logging.h>
+
+namespace
+{
+constexpr double PI = 3.14159265358979323846;
+
+// Largest code a single-ended input can produce.
+constexpr double MAX_CODE = 32767;
+
+// Inputs spread their phases over this many slots of the waveform period.
+constexpr size_t PHASE_SLOTS = 16;
+constexpr uint8_t FIRST_ADS1115_ADDRESS = 0x48;
+} // namespace
+
+namespace organicdump
+{
+
+SimulatedHardwareBackend::SimulatedHardwareBackend(
+    SimulationProfile profile,
+    const SensorTopology &topology)
+  : profile_{profile},
+    start_time_{std::chrono::steady_clock::now()}
+{
+  for (const SensorChannel &channel : topology.GetChannels())
+  {
+    std::unique_ptr<SimulatedI2cBus> &bus = buses_[channel.bus];
+    if (!bus)
+    {
+      bus.reset(new SimulatedI2cBus);
+      bus->SetSignalSource(MakeSignalSource(channel.bus));
+      bus->SetConversionTime(profile_.conversion_time);
+      bus->SetNackProbability(
+          profile_.nack_probability,
+          profile_.seed + static_cast<uint32_t>(channel.bus));
+    }
+    bus->AddAds1115(channel.address);
+  }
+}
+
+I2cBus *SimulatedHardwareBackend::OpenBus(int bus_number)
+{
+  SimulatedI2cBus *bus = GetSimulatedBus(bus_number);
+  if (!bus)
+  {
+    LOG(ERROR) << "No simulated devices on I2C bus " << bus_number;
+  }
+  return bus;
+}
+
+std::chrono::microseconds SimulatedHardwareBackend::GetConversionTime() const
+{
+  return profile_.conversion_time;
+}
+
+SimulatedI2cBus *SimulatedHardwareBackend::GetSimulatedBus(int bus_number)
+{
+  auto bus = buses_.find(bus_number);
+  return bus == buses_.end() ? nullptr : bus->second.get();
+}
+
+SimulatedI2cBus::SignalSource SimulatedHardwareBackend::MakeSignalSource(
+    int bus_number) const
+{
+  // Each bus is sampled by its own thread, so each source keeps its own
+  // generator.
+  SimulationProfile profile = profile_;
+  auto start_time = start_time_;
+  std::mt19937 random{profile.seed ^ (static_cast<uint32_t>(bus_number) << 16)};
+  std::normal_distribution<double> noise{
+      0,
+      std::max(profile.noise_stddev, 0.0)};
+
+  return [profile, start_time, random, noise](
+      uint8_t address,
+      size_t input,
+      std::chrono::steady_clock::time_point time) mutable
+  {
+    std::chrono::duration<double> elapsed = time - start_time;
+    double period = std::max<double>(profile.waveform_period.count(), 1);
+    size_t slot = (address - FIRST_ADS1115_ADDRESS) * 4 + input;
+    double phase = elapsed.count() * profile.time_scale / period +
+                   static_cast<double>(slot % PHASE_SLOTS) / PHASE_SLOTS;
+
+    double value = profile.base_value;
+    switch (profile.waveform)
+    {
+      case SimulatedWaveform::SINE:
+        value += profile.amplitude * std::sin(2 * PI * phase);
+        break;
+      case SimulatedWaveform::DRYING:
+        value += profile.amplitude * (1 - 2 * (phase - std::floor(phase)));
+        break;
+      case SimulatedWaveform::CONSTANT:
+      default:
+        break;
+    }
+
+    if (profile.noise_stddev > 0)
+    {
+      value += noise(random);
+    }
+
+    value = std::min(std::max(value, 0.0), MAX_CODE);
+    return static_cast<uint16_t>(std::lround(value));
+  };
+}
+
+} // namespace organicdump
@@ -0,0 +1,55 @@
+#ifndef ORGANICDUMP_CLIENT_SIMULATEDHARDWAREBACKEND_H
+#define ORGANICDUMP_CLIENT_SIMULATEDHARDWAREBACKEND_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+
+#include "HardwareBackend.h"
+#include "I2cBus.h"
+#include "SensorTopology.h"
+#include "SimulatedI2cBus.h"
+#include "SimulationProfile.h"
+
+namespace organicdump
+{
+
+/**
+ * Simulated ADS1115s at every address of a sensor topology, playing the
+ * profile's waveform with noise, conversion time and injected NACKs. Lets the
+ * whole daemon run, and be benchmarked, on any Linux host.
+ */
+class SimulatedHardwareBackend : public HardwareBackend
+{
+public:
+  SimulatedHardwareBackend(
+      SimulationProfile profile,
+      const SensorTopology &topology);
+
+  I2cBus *OpenBus(int bus_number) override;
+  std::chrono::microseconds GetConversionTime() const override;
+
+  /**
+   * Exposes a simulated bus so callers can inject faults or read its
+   * counters. Returns nullptr if the topology doesn't use the bus.
+   */
+  SimulatedI2cBus *GetSimulatedBus(int bus_number);
+
+private:
+  SimulatedI2cBus::SignalSource MakeSignalSource(int bus_number) const;
+
+private:
+  SimulatedHardwareBackend(const SimulatedHardwareBackend &other) = delete;
+  SimulatedHardwareBackend &operator=(const SimulatedHardwareBackend &other) = delete;
+
+private:
+  SimulationProfile profile_;
+  std::chrono::steady_clock::time_point start_time_;
+  std::map<int, std::unique_ptr<SimulatedI2cBus>> buses_;
+};
+
+} // namespace organicdump
+
+#endif // ORGANICDUMP_CLIENT_SIMULATEDHARDWAREBACKEND_H
@@ -0,0 +1,277 @@
+#include "SimulatedI2cBus.h"
+
+#include <cassert>
+#include <chrono>
+#include <random>
+#include <utility>
+
+#include "Ads1115Registers.h"
+
+namespace
+{
+// Power-on value of the config register.
+constexpr uint16_t DEFAULT_CONFIG = 0x8583;
+} // namespace
+
+namespace organicdump
+{
+
+SimulatedI2cBus::SimulatedI2cBus()
+  : conversion_time_{0},
+    nack_probability_{0},
+    is_wedged_{false},
+    transfer_count_{0},
+    message_count_{0},
+    conversion_count_{0},
+    early_read_count_{0},
+    nack_count_{0},
+    reopen_count_{0} {}
+
+void SimulatedI2cBus::AddAds1115(uint8_t address)
+{
+  devices_[address] = Ads1115State{
+      ads1115::CONVERSION_REGISTER,
+      DEFAULT_CONFIG,
+      0,
+      {0, 0, 0, 0},
+      false,
+      0,
+      std::chrono::steady_clock::time_point{},
+      false};
+}
+
+void SimulatedI2cBus::SetChannelValue(
+    uint8_t address,
+    I2c::Ads1115Channel channel,
+    uint16_t value)
+{
+  assert(devices_.count(address) > 0);
+  uint16_t input = ads1115::GetMux(channel) - ads1115::CONFIG_MUX_SINGLE_ENDED;
+  devices_.at(address).channel_values[input] = value;
+}
+
+void SimulatedI2cBus::SetSignalSource(SignalSource source)
+{
+  signal_source_ = std::move(source);
+}
+
+void SimulatedI2cBus::SetConversionTime(std::chrono::microseconds conversion_time)
+{
+  conversion_time_ = conversion_time;
+}
+
+void SimulatedI2cBus::SetNackProbability(double probability, uint32_t seed)
+{
+  nack_probability_ = probability;
+  nack_random_.seed(seed);
+}
+
+void SimulatedI2cBus::SetDeviceFailed(uint8_t address, bool is_failed)
+{
+  assert(devices_.count(address) > 0);
+  devices_.at(address).is_failed = is_failed;
+}
+
+void SimulatedI2cBus::SetWedged(bool is_wedged)
+{
+  is_wedged_ = is_wedged;
+}
+
+bool SimulatedI2cBus::Transfer(I2cMessage *messages, size_t count)
+{
+  assert(messages || count == 0);
+
+  ++transfer_count_;
+  if (is_wedged_)
+  {
+    return false;
+  }
+
+  auto now = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < count; ++i)
+  {
+    ++message_count_;
+
+    uint8_t address = static_cast<uint8_t>(messages[i].address);
+    auto device = devices_.find(address);
+    if (device == devices_.end() || device->second.is_failed || ShouldNack())
+    {
+      return false;
+    }
+
+    Update(address, &device->second, now);
+    bool succeeded = messages[i].is_read ?
+        Read(device->second, messages[i]) :
+        Write(address, &device->second, messages[i], now);
+    if (!succeeded)
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool SimulatedI2cBus::Reopen()
+{
+  // Devices keep their state. Only the adapter is reset.
+  ++reopen_count_;
+  is_wedged_ = false;
+  return true;
+}
+
+size_t SimulatedI2cBus::GetTransferCount() const
+{
+  return transfer_count_;
+}
+
+size_t SimulatedI2cBus::GetMessageCount() const
+{
+  return message_count_;
+}
+
+size_t SimulatedI2cBus::GetConversionCount() const
+{
+  return conversion_count_;
+}
+
+size_t SimulatedI2cBus::GetEarlyReadCount() const
+{
+  return early_read_count_;
+}
+
+size_t SimulatedI2cBus::GetNackCount() const
+{
+  return nack_count_;
+}
+
+size_t SimulatedI2cBus::GetReopenCount() const
+{
+  return reopen_count_;
+}
+
+void SimulatedI2cBus::Update(
+    uint8_t address,
+    Ads1115State *device,
+    std::chrono::steady_clock::time_point now)
+{
+  assert(device);
+
+  if (!device->is_converting ||
+      now - device->conversion_start < conversion_time_)
+  {
+    return;
+  }
+
+  // The input is sampled when the conversion starts.
+  device->conversion = signal_source_ ?
+      signal_source_(
+          address,
+          device->converting_input,
+          device->conversion_start) :
+      device->channel_values[device->converting_input];
+  device->is_converting = false;
+}
+
+bool SimulatedI2cBus::Write(
+    uint8_t address,
+    Ads1115State *device,
+    const I2cMessage &message,
+    std::chrono::steady_clock::time_point now)
+{
+  assert(device);
+
+  // The first byte selects a register; two more write it.
+  if (message.size != 1 && message.size != 3)
+  {
+    return false;
+  }
+
+  device->pointer = message.data[0];
+  if (message.size == 1)
+  {
+    return true;
+  }
+
+  // The conversion register is read-only. Threshold writes are accepted and
+  // ignored since the comparator isn't simulated.
+  if (device->pointer == ads1115::CONVERSION_REGISTER)
+  {
+    return false;
+  }
+  if (device->pointer != ads1115::CONFIG_REGISTER)
+  {
+    return true;
+  }
+
+  uint16_t value = static_cast<uint16_t>((message.data[1] << 8) | message.data[2]);
+
+  device->config = value;
+  // Setting OS has no effect while a conversion is running.
+  if ((value & ads1115::CONFIG_OS_START) && !device->is_converting)
+  {
+    uint16_t mux =
+        (value & ads1115::CONFIG_MUX_MASK) >> ads1115::CONFIG_MUX_SHIFT;
+    if (mux >= ads1115::CONFIG_MUX_SINGLE_ENDED)
+    {
+      device->is_converting = true;
+      device->converting_input = mux - ads1115::CONFIG_MUX_SINGLE_ENDED;
+      device->conversion_start = now;
+      Update(address, device, now);
+    }
+    ++conversion_count_;
+  }
+
+  return true;
+}
+
+bool SimulatedI2cBus::Read(
+    const Ads1115State &device,
+    const I2cMessage &message)
+{
+  if (message.size != 2)
+  {
+    return false;
+  }
+
+  // OS reads back set once a single-shot conversion has finished. Reading
+  // the result early returns the previous one.
+  uint16_t value;
+  if (device.pointer == ads1115::CONFIG_REGISTER)
+  {
+    value = device.is_converting ?
+        static_cast<uint16_t>(device.config & ~ads1115::CONFIG_OS_START) :
+        static_cast<uint16_t>(device.config | ads1115::CONFIG_OS_START);
+  }
+  else
+  {
+    if (device.is_converting)
+    {
+      ++early_read_count_;
+    }
+    value = device.conversion;
+  }
+
+  message.data[0] = static_cast<uint8_t>(value >> 8);
+  message.data[1] = static_cast<uint8_t>(value & 0xff);
+  return true;
+}
+
+bool SimulatedI2cBus::ShouldNack()
+{
+  if (nack_probability_ <= 0)
+  {
+    return false;
+  }
+
+  std::uniform_real_distribution<double> distribution{0, 1};
+  if (distribution(nack_random_) >= nack_probability_)
+  {
+    return false;
+  }
+
+  ++nack_count_;
+  return true;
+}
+
+} // namespace organicdump
@@ -0,0 +1,109 @@
+#ifndef ORGANICDUMP_CLIENT_SIMULATEDI2CBUS_H
+#define ORGANICDUMP_CLIENT_SIMULATEDI2CBUS_H
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <random>
+#include <unordered_map>
+
+#include "I2c/Devices/Ads1115AnalogToDigitalConverter/Ads1115Channel.h"
+
+#include "I2cBus.h"
+
+namespace organicdump
+{
+
+/**
+ * In-memory I2C bus populated with simulated ADS1115s. By default conversions
+ * complete as soon as they're started, reading back the value set for the
+ * channel. Counts transactions and segments so batching can be checked
+ * without hardware. A segment addressed to a missing device fails the
+ * transaction, as a NACK would.
+ *
+ * For benchmarking, a signal source can drive the inputs over time,
+ * conversions can take as long as real ones, and segments can be NACKed at
+ * random or by a failed device. Reading a conversion before it has finished
+ * returns the previous result, as on hardware, and is counted. A wedged bus
+ * fails every transaction until it's reopened.
+ */
+class SimulatedI2cBus : public I2cBus
+{
+public:
+  /**
+   * Value of input |input| (0-3) of the device at |address| at |time|.
+   */
+  using SignalSource = std::function<uint16_t(
+      uint8_t address,
+      size_t input,
+      std::chrono::steady_clock::time_point time)>;
+
+public:
+  SimulatedI2cBus();
+
+  void AddAds1115(uint8_t address);
+  void SetChannelValue(
+      uint8_t address,
+      I2c::Ads1115Channel channel,
+      uint16_t value);
+  void SetSignalSource(SignalSource source);
+  void SetConversionTime(std::chrono::microseconds conversion_time);
+  void SetNackProbability(double probability, uint32_t seed);
+  void SetDeviceFailed(uint8_t address, bool is_failed);
+  void SetWedged(bool is_wedged);
+
+  bool Transfer(I2cMessage *messages, size_t count) override;
+  bool Reopen() override;
+  size_t GetTransferCount() const override;
+  size_t GetMessageCount() const;
+  size_t GetConversionCount() const;
+  size_t GetEarlyReadCount() const;
+  size_t GetNackCount() const;
+  size_t GetReopenCount() const;
+
+private:
+  struct Ads1115State
+  {
+    uint8_t pointer;
+    uint16_t config;
+    uint16_t conversion;
+    std::array<uint16_t, 4> channel_values;
+    bool is_converting;
+    size_t converting_input;
+    std::chrono::steady_clock::time_point conversion_start;
+    bool is_failed;
+  };
+
+private:
+  void Update(
+      uint8_t address,
+      Ads1115State *device,
+      std::chrono::steady_clock::time_point now);
+  bool Write(
+      uint8_t address,
+      Ads1115State *device,
+      const I2cMessage &message,
+      std::chrono::steady_clock::time_point now);
+  bool Read(const Ads1115State &device, const I2cMessage &message);
+  bool ShouldNack();
+
+private:
+  std::unordered_map<uint8_t, Ads1115State> devices_;
+  SignalSource signal_source_;
+  std::chrono::microseconds conversion_time_;
+  double nack_probability_;
+  std::mt19937 nack_random_;
+  bool is_wedged_;
+  size_t transfer_count_;
+  size_t message_count_;
+  size_t conversion_count_;
+  size_t early_read_count_;
+  size_t nack_count_;
+  size_t reopen_count_;
+};
+
+} // namespace organicdump
+
+#endif // ORGANICDUMP_CLIENT_SIMULATEDI2CBUS_H
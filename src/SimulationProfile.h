@@ -0,0 +1,49 @@
+#ifndef ORGANICDUMP_CLIENT_SIMULATIONPROFILE_H
+#define ORGANICDUMP_CLIENT_SIMULATIONPROFILE_H
+
+#include <chrono>
+#include <cstdint>
+
+namespace organicdump
+{
+
+enum class SimulatedWaveform
+{
+  CONSTANT,
+  SINE,
+  // Falls steadily across each period, then jumps back up as if watered.
+  DRYING,
+};
+
+/**
+ * What the simulated ADS1115s read and how they misbehave. Values are raw
+ * conversion codes. Each channel plays the waveform with its own phase so the
+ * sensors don't move in lockstep.
+ */
+struct SimulationProfile
+{
+  SimulatedWaveform waveform;
+  double base_value;
+  double amplitude;
+  std::chrono::seconds waveform_period;
+
+  // Waveform time runs this many times faster than real time, so a day of
+  // drying can play out within a benchmark.
+  double time_scale;
+
+  // Standard deviation of the Gaussian noise added to every conversion.
+  double noise_stddev;
+
+  // Time a conversion takes before its result can be read. Zero makes
+  // conversions instant, which lets sweeps run at bus speed.
+  std::chrono::microseconds conversion_time;
+
+  // Chance that any one message of a transaction is NACKed.
+  double nack_probability;
+
+  uint32_t seed;
+};
+
+} // namespace organicdump
+
+#endif // ORGANICDUMP_CLIENT_SIMULATIONPROFILE_H
@@ -0,0 +1,30 @@
+#ifndef ORGANICDUMP_CLIENT_SOILMOISTUREMEASUREMENT_H
+#define ORGANICDUMP_CLIENT_SOILMOISTUREMEASUREMENT_H
+
+#include <chrono>
+#include <cstddef>
+
+namespace organicdump
+{
+
+struct SoilMoistureMeasurement
+{
+  size_t sensor_id;
+  double value;
+
+  // When the conversion was requested, on the monotonic clock. Orders and
+  // spaces readings on this host regardless of wall clock steps.
+  std::chrono::steady_clock::time_point steady_time;
+
+  // When the conversion was requested, on the wall clock. Places the reading
+  // in the time series however late it is uploaded.
+  std::chrono::system_clock::time_point wall_time;
+
+  // Time from requesting the first conversion to reading the last result
+  // over I2C, across every oversampled conversion.
+  std::chrono::microseconds conversion_latency;
+};
+
+} // namespace organicdump
+
+#endif // ORGANICDUMP_CLIENT_SOILMOISTUREMEASUREMENT_H
@@ -1,51 +1,78 @@
 #include "SoilMoistureMonitoringClient.h"
 
-#include <thread>
-#include <unordered_map>
+#include <sys/epoll.h>
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
 #include <utility>
+#include <vector>
 
 #include <glog/logging.h>
 
 #include "organic_dump.pb.h"
 
-#include "I2c/Devices/Ads1115AnalogToDigitalConverter/Ads1115.h"
-#include "I2c/Devices/Ads1115AnalogToDigitalConverter/Ads1115Channel.h"
-#include "I2c/I2cException.h"
-#include "I2c/I2cClient.h"
-#include "I2c/RpiI2cContext.h"
-#include "System/RpiSystemContext.h"
+#include "EventLoop.h"
 
 namespace
 {
-using I2c::Ads1115Channel;
-using I2c::Ads1115;
-using I2c::I2cClient;
-using I2c::RpiI2cContext;
-using System::RpiSystemContext;
+// Readings in transit from each sampler thread to the uploader.
+constexpr size_t SAMPLE_RING_CAPACITY = 1024;
 
-constexpr size_t I2C_ADC_SLAVE_ID = 0x49;
+constexpr uint32_t SERVER_EVENTS = EPOLLIN | EPOLLRDHUP;
 } // namespace
 
 namespace organicdump
 {
 
 SoilMoistureMonitoringClient::SoilMoistureMonitoringClient(
-    std::string ipv4,
-    int32_t port,
-    std::string cert_file,
-    std::string key_file,
-    std::string ca_file,
-    std::chrono::seconds retry_connect_server_period,
+    TlsContext tls_context,
+    ReconnectPolicy reconnect_policy,
     std::chrono::seconds measurement_period,
-    std::unordered_map<Ads1115Channel, size_t> channel_to_sensor_table)
-  : ipv4_{ipv4},
-    port_{port},
-    cert_file_{cert_file},
-    key_file_{key_file},
-    ca_file_{ca_file},
-    retry_connect_server_period_{retry_connect_server_period},
+    size_t pipeline_window,
+    ConnectionPolicy connection_policy,
+    DrainPolicy drain_policy,
+    AdaptiveSamplingPolicy sampling_policy,
+    OversamplingPolicy oversampling_policy,
+    DeadbandPolicy deadband_policy,
+    ChannelFaultPolicy fault_policy,
+    BusRecoveryPolicy bus_recovery_policy,
+    Ads1115Policy adc_policy,
+    TlsSessionCache session_cache,
+    ControlSocket control_socket,
+    MeasurementSpool spool,
+    SensorTopology topology,
+    std::unique_ptr<HardwareBackend> hardware_backend)
+  : tls_context_{std::move(tls_context)},
+    reconnect_policy_{reconnect_policy},
+    reconnect_backoff_{reconnect_policy, std::random_device{}()},
     measurement_period_{measurement_period},
-    channel_to_sensor_table_{std::move(channel_to_sensor_table)} {}
+    pipeline_window_{pipeline_window},
+    connection_policy_{connection_policy},
+    drain_policy_{drain_policy},
+    sampling_policy_{sampling_policy},
+    oversampling_policy_{oversampling_policy},
+    deadband_filter_{deadband_policy},
+    fault_policy_{fault_policy},
+    bus_recovery_policy_{bus_recovery_policy},
+    adc_policy_{adc_policy},
+    session_cache_{std::move(session_cache)},
+    control_socket_{std::move(control_socket)},
+    spool_{std::move(spool)},
+    topology_{std::move(topology)},
+    hardware_backend_{std::move(hardware_backend)},
+    event_loop_{nullptr},
+    drainer_{nullptr},
+    upload_tracker_{nullptr},
+    reconnect_timer_{-1},
+    session_has_responded_{false},
+    is_watching_server_writes_{false},
+    uploaded_measurement_count_{0},
+    rejected_measurement_count_{0} {}
 
 SoilMoistureMonitoringClient::SoilMoistureMonitoringClient(SoilMoistureMonitoringClient &&other)
 {
@@ -66,111 +93,665 @@ SoilMoistureMonitoringClient::~SoilMoistureMonitoringClient() {}
 
 bool SoilMoistureMonitoringClient::Run()
 {
-  size_t consecutive_failed_connections = 0;
-  while (true)
+  EventLoop event_loop;
+  if (!event_loop.IsInitialized())
+  {
+    LOG(ERROR) << "Failed to initialize event loop";
+    return false;
+  }
+
+  // One sampler per bus, each with its own ring so that every ring keeps a
+  // single producer. Rings are declared first so they outlive the samplers,
+  // and the backend owns the buses.
+  assert(hardware_backend_);
+  std::vector<std::unique_ptr<SpscRingBuffer<SoilMoistureMeasurement>>> sample_rings;
+  std::vector<std::unique_ptr<SoilMoistureSampler>> samplers;
+  for (int bus : topology_.GetBuses())
+  {
+    I2cBus *i2c_bus = hardware_backend_->OpenBus(bus);
+    if (!i2c_bus)
+    {
+      LOG(ERROR) << "Failed to open I2C bus " << bus;
+      samplers_.clear();
+      sample_rings_.clear();
+      return false;
+    }
+
+    sample_rings.emplace_back(
+        new SpscRingBuffer<SoilMoistureMeasurement>{SAMPLE_RING_CAPACITY});
+    samplers.emplace_back(
+        new SoilMoistureSampler{
+            i2c_bus,
+            hardware_backend_->GetConversionTime(),
+            adc_policy_,
+            topology_.GetBusChannels(bus),
+            measurement_period_,
+            sampling_policy_,
+            oversampling_policy_,
+            fault_policy_,
+            bus_recovery_policy_,
+            sample_rings.back().get()});
+
+    size_t worker_index = samplers.size() - 1;
+    if (!event_loop.AddFd(
+          samplers.back()->GetNotifyFd(),
+          EPOLLIN,
+          [this, worker_index](uint32_t) { OnSamplesReady(worker_index); }))
+    {
+      LOG(ERROR) << "Failed to watch sampler for bus " << bus;
+      samplers_.clear();
+      sample_rings_.clear();
+      return false;
+    }
+
+    sample_rings_.push_back(sample_rings.back().get());
+    samplers_.push_back(samplers.back().get());
+  }
+
+  // Local status queries are answered on this thread, between uploads.
+  if (control_socket_.IsOpen() &&
+      !event_loop.AddFd(
+        control_socket_.GetFd(),
+        EPOLLIN,
+        [this](uint32_t)
+        {
+          control_socket_.ServeConnections(
+              [this]() { return FormatQueueStats(); });
+        }))
+  {
+    LOG(ERROR) << "Failed to watch control socket";
+    samplers_.clear();
+    sample_rings_.clear();
+    return false;
+  }
+
+  if (!event_loop.AddTimer(
+        [this]() { OnReconnectTimer(); },
+        &reconnect_timer_))
+  {
+    LOG(ERROR) << "Failed to register monitoring events";
+    samplers_.clear();
+    sample_rings_.clear();
+    return false;
+  }
+
+  BacklogDrainer drainer{
+      &event_loop,
+      &tls_context_,
+      &session_cache_,
+      &spool_,
+      drain_policy_,
+      pipeline_window_,
+      reconnect_policy_,
+      [this](uint64_t seq) { CompleteMeasurement(seq); }};
+  UploadTracker upload_tracker{&spool_};
+
+  event_loop_ = &event_loop;
+  drainer_ = &drainer;
+  upload_tracker_ = &upload_tracker;
+
+  if (!Client::SENDS_CAPTURE_TIMES && spool_.GetSize() > 0)
+  {
+    // The server would file these under the time they arrive, which could
+    // be days after they were taken.
+    LOG(WARNING) << "Releasing " << spool_.GetSize()
+                 << " readings spooled by a previous run without uploading"
+                 << " them";
+    ReleaseQueuedMeasurements();
+    spool_.Sync();
+  }
+  else if (connection_policy_.upload && spool_.GetSize() > 0)
+  {
+    LOG(INFO) << "Replaying " << spool_.GetSize() << " spooled readings";
+    event_loop.ArmTimer(reconnect_timer_, std::chrono::nanoseconds{0});
+  }
+
+  if (!Client::SENDS_CAPTURE_TIMES && drain_policy_.stream_count > 0)
+  {
+    LOG(WARNING) << "Backlog drain sessions are off until readings can "
+                 << "carry their capture times";
+  }
+
+  // Each bus samples on its own thread at its own cadence, whatever the
+  // network is doing. This thread only uploads.
+  bool started = true;
+  for (const auto &sampler : samplers)
+  {
+    if (!sampler->Start())
+    {
+      LOG(ERROR) << "Failed to start soil moisture sampler";
+      started = false;
+      break;
+    }
+  }
+
+  bool result = started && event_loop.Run();
+
+  for (const auto &sampler : samplers)
+  {
+    sampler->Stop();
+  }
+  drainer.Stop();
+  connector_.Cancel();
+  CloseSession();
+  spool_.Sync();
+  event_loop_ = nullptr;
+  samplers_.clear();
+  sample_rings_.clear();
+  drainer_ = nullptr;
+  upload_tracker_ = nullptr;
+  return result;
+}
+
+void SoilMoistureMonitoringClient::OnSamplesReady(size_t worker_index)
+{
+  samplers_[worker_index]->ConsumeNotification();
+
+  // Readings hit the spool, and the disk, before any upload attempt, so
+  // neither an unreachable server nor a power cut can lose them.
+  SoilMoistureMeasurement measurement;
+  size_t spooled_count = 0;
+  while (sample_rings_[worker_index]->TryPop(&measurement))
   {
-    if (!MonitorSoilMoisture(&consecutive_failed_connections))
+    if (!deadband_filter_.ShouldSend(measurement))
+    {
+      continue;
+    }
+
+    if (!spool_.Append(measurement))
     {
-      LOG(ERROR) << "Encountered error when monitoring soil moisture";
+      LOG(WARNING) << "Spool full. Dropping reading for sensor "
+                   << measurement.sensor_id;
+      continue;
     }
+    ++spooled_count;
+  }
+
+  // The mapping survives a crash of this process but not a power cut, and a
+  // post can fail long after it was written. Sync first, so a reading is
+  // never only in flight.
+  if (spooled_count > 0 && !spool_.Sync())
+  {
+    LOG(WARNING) << "Spooled readings may not survive a power loss";
+  }
 
-    LOG(INFO) << "Retrying server connection in "
-              << retry_connect_server_period_.count() << " seconds";
-    std::this_thread::sleep_for(retry_connect_server_period_);
+  if (!connection_policy_.upload)
+  {
+    ReleaseQueuedMeasurements();
+    return;
   }
 
-  return true;
+  // While a connect is under way or a reconnect is scheduled, the readings
+  // wait in the spool.
+  if (client_.IsConnected())
+  {
+    PostQueuedMeasurements();
+  }
+  else if (!connector_.IsConnecting() &&
+           !event_loop_->IsTimerArmed(reconnect_timer_))
+  {
+    StartConnect();
+  }
 }
 
-bool SoilMoistureMonitoringClient::MonitorSoilMoisture(
-    size_t *out_consecutive_failed_connections)
+void SoilMoistureMonitoringClient::OnReconnectTimer()
 {
-  RpiSystemContext rpiSystemContext;
-  RpiI2cContext rpiI2cContext{&rpiSystemContext};
-  I2cClient *i2c = rpiI2cContext.GetBus1I2cClient();
-  i2c->SetSlave(I2C_ADC_SLAVE_ID);
-  size_t consecutive_successful_readings = 0;
+  if (client_.IsConnected() || connector_.IsConnecting() ||
+      !upload_tracker_->HasUnposted())
+  {
+    // Nothing to send. The next measurement connects lazily.
+    return;
+  }
 
-  while (true)
+  if (reconnect_backoff_.IsBreakerOpen())
   {
-    // Destroy client before sleeping so that TCP connection is closed before
-    // the long sleep.
+    LOG(INFO) << "Breaker cooldown over. Trying the server again";
+  }
+  StartConnect();
+}
+
+void SoilMoistureMonitoringClient::OnServerEvent(uint32_t events)
+{
+  // Writable counts as readable here: TLS may have stalled a read on a
+  // write, and TryCompleteRequest() flushes first anyway.
+  if ((events & (EPOLLIN | EPOLLOUT)) && client_.GetPendingRequestCount() > 0)
+  {
+    // Touch the socket once, then drain every response already buffered. A
+    // partial frame waits for the next readiness event.
+    bool may_read_socket = true;
+    while (client_.GetPendingRequestCount() > 0 &&
+           (may_read_socket || client_.HasBufferedResponse()))
     {
-      Client client;
-      if (!Client::Create(
-            ipv4_,
-            port_,
-            cert_file_,
-            key_file_,
-            ca_file_,
-            &client))
+      may_read_socket = false;
+
+      size_t measurement_id;
+      bool completed = false;
+      ClientError error;
+      if (!client_.TryCompleteRequest(&measurement_id, &completed, &error))
       {
-        LOG(ERROR) << "Failed to connect server: " << ipv4_ << ":" << port_;
-        ++*out_consecutive_failed_connections;
-        return false;
+        SoilMoistureMeasurement oldest;
+        spool_.Get(upload_tracker_->GetOldestInFlight(), &oldest);
+        LOG(ERROR) << "Failed to read BASIC_RESPONSE for sensor "
+                   << oldest.sensor_id << ": " << GetClientErrorName(error);
+        HandleSessionFailure(error);
+        return;
       }
 
-      LOG(INFO) << "Successfully connected to server: " << ipv4_ << ":" << port_;
-      *out_consecutive_failed_connections = 0;
+      if (!completed)
+      {
+        break;
+      }
 
-      if (!MeasureSoilMoisture(&client, i2c))
+      if (!session_has_responded_)
       {
-        LOG(ERROR) << "Failed to take soil moisture sensor reading";
-        return false;
+        session_has_responded_ = true;
+        reconnect_backoff_.OnSuccess();
       }
-      else
+
+      uint64_t seq = upload_tracker_->PopInFlight();
+      if (error == ClientError::REJECTED)
       {
-        LOG(ERROR) << "Num successful soil moisture readings: "
-                   << ++consecutive_successful_readings;
+        // Resending would be refused again. Drop it so it can't hold up the
+        // readings behind it.
+        SoilMoistureMeasurement rejected;
+        spool_.Get(seq, &rejected);
+        LOG(WARNING) << "Server rejected reading for sensor "
+                     << rejected.sensor_id << ". Dropping it";
+        ++rejected_measurement_count_;
       }
+      CompleteMeasurement(seq);
     }
 
-    LOG(INFO) << "Sleeping for " << measurement_period_.count()
-              << " seconds before taking next soil moisture reading";
-    std::this_thread::sleep_for(measurement_period_);
+    spool_.Sync();
+
+    PostQueuedMeasurements();
+    MaybeCloseIdleSession();
+    return;
+  }
+
+  if (events == EPOLLOUT)
+  {
+    // Nothing outstanding, so only the HELLO can be left to flush.
+    PostQueuedMeasurements();
+    return;
+  }
+
+  // Readable with nothing outstanding, or hung up: the server closed the
+  // session.
+  LOG(INFO) << "Server closed the session";
+  HandleSessionFailure(
+      (events & EPOLLERR) ? ClientError::NETWORK : ClientError::CONNECTION_CLOSED);
+}
+
+void SoilMoistureMonitoringClient::StartConnect()
+{
+  assert(!client_.IsConnected());
+  assert(!connector_.IsConnecting());
+
+  if (!tls_context_.ReloadIfChanged())
+  {
+    LOG(WARNING) << "Connecting with previously loaded TLS credentials";
+  }
+
+  // The handshake runs on the event loop, so sampling and the drain sessions
+  // carry on while the server is slow to answer.
+  if (!connector_.Start(
+        event_loop_,
+        &tls_context_,
+        &session_cache_,
+        &client_,
+        [this](ClientError error) { OnConnected(error); }))
+  {
+    OnConnected(ClientError::NETWORK);
+  }
+}
+
+void SoilMoistureMonitoringClient::OnConnected(ClientError error)
+{
+  if (error != ClientError::NONE)
+  {
+    LOG(ERROR) << "Failed to connect server: " << tls_context_.GetIpv4()
+               << ":" << tls_context_.GetPort();
+    std::chrono::milliseconds delay = reconnect_backoff_.OnFailure(error);
+    LOG(INFO) << "Retrying server connection in " << delay.count() << " ms";
+    event_loop_->ArmTimer(reconnect_timer_, delay);
+    return;
+  }
+
+  LOG(INFO) << "Successfully connected to server: " << tls_context_.GetIpv4()
+            << ":" << tls_context_.GetPort();
+  session_has_responded_ = false;
+  is_watching_server_writes_ = false;
+  client_.SetPipelineWindow(pipeline_window_);
+
+  if (connection_policy_.persistent &&
+      connection_policy_.keepalive_period.count() > 0 &&
+      !client_.EnableKeepalive(connection_policy_.keepalive_period))
+  {
+    LOG(WARNING) << "Failed to enable keepalive on server session";
+  }
+
+  if (!event_loop_->AddFd(
+        client_.GetFd(),
+        SERVER_EVENTS,
+        [this](uint32_t events) { OnServerEvent(events); }))
+  {
+    LOG(ERROR) << "Failed to watch server session";
+    client_.Close();
+    event_loop_->ArmTimer(
+        reconnect_timer_,
+        reconnect_backoff_.OnFailure(ClientError::NETWORK));
+    return;
+  }
+
+  ReleaseDelayedMeasurements();
+  PostQueuedMeasurements();
+}
+
+void SoilMoistureMonitoringClient::CloseSession()
+{
+  if (!client_.IsConnected())
+  {
+    return;
   }
 
-  return true;
+  if (event_loop_)
+  {
+    event_loop_->RemoveFd(client_.GetFd());
+  }
+  client_.Close();
 }
 
-bool SoilMoistureMonitoringClient::MeasureSoilMoisture(
-    Client *client,
-    I2cClient *i2c)
+void SoilMoistureMonitoringClient::HandleSessionFailure(ClientError error)
 {
-  assert(client);
-  assert(i2c);
+  // A session the server closed after serving was most likely restarted or
+  // timed out while idle, so come back without backing off. Anything else
+  // backs off, and repeated server errors trip the breaker.
+  bool was_closed =
+      error == ClientError::CONNECTION_CLOSED && session_has_responded_;
+  CloseSession();
 
-  Ads1115 ads1115{i2c};
-  uint16_t reading;
+  // Unacknowledged readings are replayed from the spool, in order.
+  upload_tracker_->RewindInFlight();
+
+  if (!upload_tracker_->HasUnposted())
+  {
+    return;
+  }
 
-  for (const auto &entry : channel_to_sensor_table_)
+  std::chrono::milliseconds delay = was_closed ?
+      reconnect_backoff_.OnSessionClosed() :
+      reconnect_backoff_.OnFailure(error);
+  if (was_closed)
   {
-    if (!ads1115.Read(entry.first, &reading))
+    LOG(WARNING) << "Server closed the persistent session. Reconnecting in "
+                 << delay.count() << " ms";
+  }
+  else if (reconnect_backoff_.IsBreakerOpen())
+  {
+    LOG(WARNING) << "Session failed with " << GetClientErrorName(error)
+                 << " while the breaker is open. Trying the server again in "
+                 << delay.count() << " ms";
+  }
+  else
+  {
+    LOG(INFO) << "Session failed with " << GetClientErrorName(error)
+              << ". Retrying server connection in " << delay.count() << " ms";
+  }
+  event_loop_->ArmTimer(reconnect_timer_, delay);
+}
+
+void SoilMoistureMonitoringClient::PostQueuedMeasurements()
+{
+  MaybeStartDrain();
+
+  SoilMoistureMeasurement measurement;
+  while (upload_tracker_->HasUnposted() && client_.CanPostRequest())
+  {
+    spool_.Get(upload_tracker_->GetNextSeq(), &measurement);
+    if (!client_.PostSoilMoistureMeasurement(measurement))
     {
-      LOG(ERROR) << "Failed to read channel " << static_cast<int>(entry.first);
-      return false;
+      LOG(ERROR) << "Failed to upload soil moisture sensor reading for sensor "
+                 << measurement.sensor_id;
+      HandleSessionFailure(ClientError::NETWORK);
+      return;
     }
+    upload_tracker_->MarkPosted();
+  }
+
+  ClientError error;
+  if (!client_.Flush(&error))
+  {
+    HandleSessionFailure(error);
+    return;
+  }
+
+  WatchServerWrites();
+}
+
+void SoilMoistureMonitoringClient::WatchServerWrites()
+{
+  // EPOLLOUT is level-triggered, so it's only asked for while a flush is
+  // part done or it would wake the loop on every pass.
+  bool wants_write = client_.WantsWrite();
+  if (wants_write == is_watching_server_writes_)
+  {
+    return;
+  }
+
+  if (!event_loop_->ModifyFd(
+        client_.GetFd(),
+        wants_write ? SERVER_EVENTS | EPOLLOUT : SERVER_EVENTS))
+  {
+    LOG(ERROR) << "Failed to update server session events";
+    HandleSessionFailure(ClientError::NETWORK);
+    return;
+  }
+  is_watching_server_writes_ = wants_write;
+}
+
+void SoilMoistureMonitoringClient::ReleaseQueuedMeasurements()
+{
+  // Nothing will ever acknowledge these, so log each one and let it go
+  // rather than let the spool fill.
+  SoilMoistureMeasurement measurement;
+  while (upload_tracker_->HasUnposted())
+  {
+    uint64_t seq = upload_tracker_->GetNextSeq();
+    spool_.Get(seq, &measurement);
+    LOG(INFO) << "Reading for sensor " << measurement.sensor_id << ": "
+              << measurement.value << " (not uploaded)";
+    upload_tracker_->MarkPosted();
+    upload_tracker_->PopInFlight();
+    upload_tracker_->Complete(seq);
+  }
+}
+
+void SoilMoistureMonitoringClient::ReleaseDelayedMeasurements()
+{
+  if (Client::SENDS_CAPTURE_TIMES)
+  {
+    return;
+  }
 
-    if (!client->SendSoilMoistureMeasurement(entry.second, reading))
+  // Readings that waited out a reconnect for more than a measurement period
+  // would be filed under their arrival time, so they're let go instead. A
+  // new session has nothing in flight, so these are the oldest readings.
+  auto oldest_allowed = std::chrono::steady_clock::now() - measurement_period_;
+  SoilMoistureMeasurement measurement;
+  size_t released_count = 0;
+  while (upload_tracker_->HasUnposted())
+  {
+    uint64_t seq = upload_tracker_->GetNextSeq();
+    spool_.Get(seq, &measurement);
+    if (measurement.steady_time >= oldest_allowed)
     {
-      LOG(ERROR) << "Failed to upload soil moisture sensor reading for sensor "
-                 << entry.second;
-      return false;
+      break;
     }
+
+    upload_tracker_->MarkPosted();
+    upload_tracker_->PopInFlight();
+    upload_tracker_->Complete(seq);
+    ++released_count;
+  }
+
+  if (released_count > 0)
+  {
+    LOG(WARNING) << "Released " << released_count << " readings older than "
+                 << measurement_period_.count()
+                 << " s without uploading them";
+    spool_.Sync();
+  }
+}
+
+void SoilMoistureMonitoringClient::MaybeStartDrain()
+{
+  // The backlog is only handed over while nothing is in flight on the live
+  // session, which is always the case right after it connects. Drained
+  // readings are late by definition, so there's no backlog to drain until
+  // they can carry their capture times.
+  if (!Client::SENDS_CAPTURE_TIMES ||
+      drainer_->IsActive() || drain_policy_.stream_count == 0 ||
+      !upload_tracker_->CanHandOffBacklog(drain_policy_.backlog_threshold))
+  {
+    return;
+  }
+
+  // Hand the backlog to the drain sessions. The live session carries on with
+  // readings taken from now on.
+  if (drainer_->Start(upload_tracker_->GetNextSeq(), spool_.GetTailSeq()))
+  {
+    upload_tracker_->HandOffBacklog();
+  }
+}
+
+void SoilMoistureMonitoringClient::CompleteMeasurement(uint64_t seq)
+{
+  // Drain and live sessions finish out of order, and a drain session that
+  // failed after the server answered may upload a reading again.
+  if (upload_tracker_->Complete(seq))
+  {
+    ++uploaded_measurement_count_;
+  }
+}
+
+void SoilMoistureMonitoringClient::MaybeCloseIdleSession()
+{
+  if (upload_tracker_->HasUnposted() ||
+      client_.GetPendingRequestCount() > 0)
+  {
+    return;
+  }
+
+  LOG(INFO) << "Num successful soil moisture uploads: "
+            << uploaded_measurement_count_ << ". Session frames written: "
+            << client_.GetWrittenFrameCount() << " in "
+            << client_.GetWriteCallCount() << " write calls";
+  LogQueueStats();
+
+  // Channels keep their own, adaptive periods and phases, so the daemon's
+  // measurement period says little about when the next reading is due. Ask
+  // the samplers instead.
+  auto idle_time = GetNextSampleDue() - std::chrono::steady_clock::now();
+  if (!connection_policy_.persistent ||
+      idle_time > connection_policy_.idle_close_threshold)
+  {
+    // Close the session rather than hold it idle until the next reading.
+    CloseSession();
+  }
+}
+
+std::chrono::steady_clock::time_point
+SoilMoistureMonitoringClient::GetNextSampleDue() const
+{
+  auto next_due = std::chrono::steady_clock::time_point::max();
+  for (const SoilMoistureSampler *sampler : samplers_)
+  {
+    next_due = std::min(next_due, sampler->GetNextDue());
+  }
+  return next_due;
+}
+
+void SoilMoistureMonitoringClient::LogQueueStats() const
+{
+  LOG(INFO) << FormatQueueStats();
+}
+
+std::string SoilMoistureMonitoringClient::FormatQueueStats() const
+{
+  size_t ring_size = 0;
+  size_t ring_capacity = 0;
+  size_t ring_drops = 0;
+  for (const SpscRingBuffer<SoilMoistureMeasurement> *ring : sample_rings_)
+  {
+    ring_size += ring->GetSize();
+    ring_capacity += ring->GetCapacity();
+    ring_drops += ring->GetDropCount();
+  }
+
+  size_t sweeps = 0;
+  size_t failed_reads = 0;
+  size_t quarantined = 0;
+  size_t bus_reopens = 0;
+  for (const SoilMoistureSampler *sampler : samplers_)
+  {
+    sweeps += sampler->GetSweepCount();
+    failed_reads += sampler->GetFailedReadCount();
+    quarantined += sampler->GetQuarantinedCount();
+    bus_reopens += sampler->GetBusReopenCount();
   }
 
-  return true;
+  std::ostringstream stats;
+  stats << "Sample ring depth: " << ring_size << "/" << ring_capacity
+        << ", ring drops: " << ring_drops
+        << ", spool depth: " << spool_.GetSize() << "/"
+        << spool_.GetCapacity()
+        << ", spool drops: " << spool_.GetDropCount()
+        << ", backlog drained: " << drainer_->GetDrainedCount()
+        << ", deadband suppressed: "
+        << deadband_filter_.GetSuppressedCount()
+        << ", heartbeats: " << deadband_filter_.GetHeartbeatCount()
+        << ", sweeps: " << sweeps
+        << ", failed reads: " << failed_reads
+        << ", quarantined sensors: " << quarantined
+        << ", bus reopens: " << bus_reopens
+        << ", rejected readings: " << rejected_measurement_count_
+        << ", breaker trips: " << reconnect_backoff_.GetBreakerTripCount()
+        << ", breaker open: "
+        << (reconnect_backoff_.IsBreakerOpen() ? "yes" : "no");
+  return stats.str();
 }
 
 void SoilMoistureMonitoringClient::StealResources(SoilMoistureMonitoringClient *other) {
-  ipv4_ = std::move(other->ipv4_);
-  port_ = std::move(other->port_);
-  cert_file_ = std::move(other->cert_file_);
-  key_file_ = std::move(other->key_file_);
-  ca_file_ = std::move(other->ca_file_);
-  retry_connect_server_period_ = std::move(other->retry_connect_server_period_);
+  assert(!other->event_loop_);
+  tls_context_ = std::move(other->tls_context_);
+  reconnect_policy_ = other->reconnect_policy_;
+  reconnect_backoff_ = std::move(other->reconnect_backoff_);
   measurement_period_ = std::move(other->measurement_period_);
-  channel_to_sensor_table_ = std::move(other->channel_to_sensor_table_);
+  pipeline_window_ = other->pipeline_window_;
+  connection_policy_ = other->connection_policy_;
+  drain_policy_ = other->drain_policy_;
+  sampling_policy_ = other->sampling_policy_;
+  oversampling_policy_ = other->oversampling_policy_;
+  deadband_filter_ = std::move(other->deadband_filter_);
+  fault_policy_ = other->fault_policy_;
+  bus_recovery_policy_ = other->bus_recovery_policy_;
+  adc_policy_ = other->adc_policy_;
+  session_cache_ = std::move(other->session_cache_);
+  control_socket_ = std::move(other->control_socket_);
+  topology_ = std::move(other->topology_);
+  hardware_backend_ = std::move(other->hardware_backend_);
+  event_loop_ = nullptr;
+  samplers_.clear();
+  sample_rings_.clear();
+  drainer_ = nullptr;
+  upload_tracker_ = nullptr;
+  reconnect_timer_ = -1;
+  session_has_responded_ = false;
+  is_watching_server_writes_ = false;
+  spool_ = std::move(other->spool_);
+  uploaded_measurement_count_ = other->uploaded_measurement_count_;
+  rejected_measurement_count_ = other->rejected_measurement_count_;
 }
 
 } // namespace organicdump
@@ -5,13 +5,34 @@
 #include <cstdint>
 #include <memory>
 #include <string>
-#include <unordered_map>
-
-#include "I2c/Devices/Ads1115AnalogToDigitalConverter/Ads1115.h"
-#include "I2c/Devices/Ads1115AnalogToDigitalConverter/Ads1115Channel.h"
-#include "I2c/I2cClient.h"
+#include <vector>
 
+#include "AdaptiveSamplingPolicy.h"
+#include "Ads1115Policy.h"
+#include "BacklogDrainer.h"
+#include "BusRecoveryPolicy.h"
+#include "ChannelFaultPolicy.h"
 #include "Client.h"
+#include "ClientConnector.h"
+#include "ClientError.h"
+#include "ConnectionPolicy.h"
+#include "ControlSocket.h"
+#include "DeadbandFilter.h"
+#include "DeadbandPolicy.h"
+#include "DrainPolicy.h"
+#include "EventLoop.h"
+#include "HardwareBackend.h"
+#include "MeasurementSpool.h"
+#include "OversamplingPolicy.h"
+#include "ReconnectBackoff.h"
+#include "ReconnectPolicy.h"
+#include "SensorTopology.h"
+#include "SoilMoistureMeasurement.h"
+#include "SoilMoistureSampler.h"
+#include "SpscRingBuffer.h"
+#include "TlsContext.h"
+#include "TlsSessionCache.h"
+#include "UploadTracker.h"
 
 namespace organicdump
 {
@@ -20,22 +41,46 @@ class SoilMoistureMonitoringClient
 {
 public:
   SoilMoistureMonitoringClient(
-      std::string ipv4,
-      int32_t port,
-      std::string cert_file,
-      std::string key_file,
-      std::string ca_file,
-      std::chrono::seconds retry_connect_server_period,
+      TlsContext tls_context,
+      ReconnectPolicy reconnect_policy,
       std::chrono::seconds measurement_period,
-      std::unordered_map<I2c::Ads1115Channel, size_t> channel_to_sensor_table);
+      size_t pipeline_window,
+      ConnectionPolicy connection_policy,
+      DrainPolicy drain_policy,
+      AdaptiveSamplingPolicy sampling_policy,
+      OversamplingPolicy oversampling_policy,
+      DeadbandPolicy deadband_policy,
+      ChannelFaultPolicy fault_policy,
+      BusRecoveryPolicy bus_recovery_policy,
+      Ads1115Policy adc_policy,
+      TlsSessionCache session_cache,
+      ControlSocket control_socket,
+      MeasurementSpool spool,
+      SensorTopology topology,
+      std::unique_ptr<HardwareBackend> hardware_backend);
   SoilMoistureMonitoringClient(SoilMoistureMonitoringClient &&other);
   SoilMoistureMonitoringClient &operator=(SoilMoistureMonitoringClient &&other);
   ~SoilMoistureMonitoringClient();
   bool Run();
 
 private:
-  bool MonitorSoilMoisture(size_t *out_consecutive_failed_connections);
-  bool MeasureSoilMoisture(Client *client, I2c::I2cClient *i2c);
+  void OnSamplesReady(size_t worker_index);
+  void OnReconnectTimer();
+  void OnServerEvent(uint32_t events);
+  void StartConnect();
+  void OnConnected(ClientError error);
+  void CloseSession();
+  void HandleSessionFailure(ClientError error);
+  void PostQueuedMeasurements();
+  void WatchServerWrites();
+  void ReleaseQueuedMeasurements();
+  void ReleaseDelayedMeasurements();
+  void MaybeStartDrain();
+  void CompleteMeasurement(uint64_t seq);
+  void MaybeCloseIdleSession();
+  std::chrono::steady_clock::time_point GetNextSampleDue() const;
+  void LogQueueStats() const;
+  std::string FormatQueueStats() const;
   void StealResources(SoilMoistureMonitoringClient *other);
 
 private:
@@ -43,14 +88,38 @@ private:
   SoilMoistureMonitoringClient &operator=(const SoilMoistureMonitoringClient &other) = delete;
 
 private:
-  std::string ipv4_;
-  int32_t port_;
-  std::string cert_file_;
-  std::string key_file_;
-  std::string ca_file_;
-  std::chrono::seconds retry_connect_server_period_;
+  TlsContext tls_context_;
+  ReconnectPolicy reconnect_policy_;
+  ReconnectBackoff reconnect_backoff_;
   std::chrono::seconds measurement_period_;
-  std::unordered_map<I2c::Ads1115Channel, size_t> channel_to_sensor_table_;
+  size_t pipeline_window_;
+  ConnectionPolicy connection_policy_;
+  DrainPolicy drain_policy_;
+  AdaptiveSamplingPolicy sampling_policy_;
+  OversamplingPolicy oversampling_policy_;
+  DeadbandFilter deadband_filter_;
+  ChannelFaultPolicy fault_policy_;
+  BusRecoveryPolicy bus_recovery_policy_;
+  Ads1115Policy adc_policy_;
+  TlsSessionCache session_cache_;
+  ControlSocket control_socket_;
+  MeasurementSpool spool_;
+  SensorTopology topology_;
+  std::unique_ptr<HardwareBackend> hardware_backend_;
+
+  // State below only lives for the duration of Run().
+  EventLoop *event_loop_;
+  std::vector<SoilMoistureSampler *> samplers_;
+  std::vector<SpscRingBuffer<SoilMoistureMeasurement> *> sample_rings_;
+  BacklogDrainer *drainer_;
+  UploadTracker *upload_tracker_;
+  EventLoop::TimerId reconnect_timer_;
+  ClientConnector connector_;
+  Client client_;
+  bool session_has_responded_;
+  bool is_watching_server_writes_;
+  size_t uploaded_measurement_count_;
+  size_t rejected_measurement_count_;
 };
 
 } // namespace organicdump
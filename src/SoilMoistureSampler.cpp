@@ -0,0 +1,595 @@
+#include "SoilMoistureSampler.h"
+
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <glog/logging.h>
+
+namespace
+{
+// Channels due within the same tick are converted in the same sweep.
+constexpr std::chrono::milliseconds TIMER_RESOLUTION{1};
+} // namespace
+
+namespace organicdump
+{
+
+SoilMoistureSampler::SoilMoistureSampler(
+    I2cBus *bus,
+    std::chrono::microseconds conversion_time,
+    Ads1115Policy adc_policy,
+    std::vector<SensorChannel> channels,
+    std::chrono::seconds measurement_period,
+    AdaptiveSamplingPolicy sampling_policy,
+    OversamplingPolicy oversampling_policy,
+    ChannelFaultPolicy fault_policy,
+    BusRecoveryPolicy bus_recovery_policy,
+    SpscRingBuffer<SoilMoistureMeasurement> *ring)
+  : bus_{bus},
+    bus_number_{channels.empty() ? -1 : channels.front().bus},
+    ads1115_batch_{bus, conversion_time, adc_policy},
+    sampling_policy_{sampling_policy},
+    fault_policy_{fault_policy},
+    bus_recovery_policy_{bus_recovery_policy},
+    failed_sweeps_{0},
+    reopen_period_{bus_recovery_policy.reopen_period},
+    next_reopen_{},
+    sample_count_{std::max<size_t>(oversampling_policy.sample_count, 1)},
+    filter_{oversampling_policy},
+    samples_(sample_count_),
+    timer_wheel_{
+        channels.size(),
+        TIMER_RESOLUTION,
+        std::chrono::steady_clock::now()},
+    ring_{ring},
+    notify_fd_{eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)},
+    stop_requested_{false},
+    next_due_{0},
+    sweep_count_{0},
+    failed_read_count_{0},
+    quarantined_count_{0},
+    bus_reopen_count_{0}
+{
+  assert(bus_);
+  assert(ring_);
+  assert(sampling_policy_.min_period <= sampling_policy_.max_period);
+
+  // Every channel starts at its own period, or the daemon's, and adapts from
+  // there. A channel's own period isn't clamped while sampling is fixed.
+  bool is_adaptive = sampling_policy_.min_period < sampling_policy_.max_period;
+  for (const SensorChannel &channel : channels)
+  {
+    std::chrono::steady_clock::duration period = measurement_period;
+    if (channel.period.count() > 0)
+    {
+      period = channel.period;
+    }
+    if (is_adaptive || channel.period.count() == 0)
+    {
+      period = std::min<std::chrono::steady_clock::duration>(
+          std::max<std::chrono::steady_clock::duration>(
+              period,
+              sampling_policy_.min_period),
+          sampling_policy_.max_period);
+    }
+
+    schedules_.push_back(
+        ChannelSchedule{
+            channel.address,
+            channel.channel,
+            channel.sensor_id,
+            std::max<std::chrono::steady_clock::duration>(
+                period,
+                TIMER_RESOLUTION),
+            channel.phase_offset,
+            std::chrono::steady_clock::time_point{},
+            false,
+            0,
+            std::chrono::steady_clock::time_point{},
+            0,
+            false,
+            fault_policy_.quarantine_period});
+  }
+
+  if (notify_fd_ < 0)
+  {
+    LOG(ERROR) << "Failed to create sampler eventfd: " << strerror(errno);
+  }
+}
+
+SoilMoistureSampler::~SoilMoistureSampler()
+{
+  Stop();
+
+  if (notify_fd_ >= 0)
+  {
+    close(notify_fd_);
+  }
+}
+
+bool SoilMoistureSampler::Start()
+{
+  assert(!thread_.joinable());
+
+  if (notify_fd_ < 0)
+  {
+    return false;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock{stop_mutex_};
+    stop_requested_ = false;
+  }
+
+  thread_ = std::thread{[this]() { Run(); }};
+  return true;
+}
+
+void SoilMoistureSampler::Stop()
+{
+  if (!thread_.joinable())
+  {
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock{stop_mutex_};
+    stop_requested_ = true;
+  }
+  stop_cv_.notify_all();
+  thread_.join();
+}
+
+int SoilMoistureSampler::GetNotifyFd() const
+{
+  return notify_fd_;
+}
+
+void SoilMoistureSampler::ConsumeNotification()
+{
+  uint64_t count;
+  if (read(notify_fd_, &count, sizeof(count)) < 0 && errno != EAGAIN)
+  {
+    LOG(ERROR) << "Failed to read sampler eventfd: " << strerror(errno);
+  }
+}
+
+std::chrono::steady_clock::time_point SoilMoistureSampler::GetNextDue() const
+{
+  return std::chrono::steady_clock::time_point{
+      std::chrono::steady_clock::duration{
+          next_due_.load(std::memory_order_relaxed)}};
+}
+
+size_t SoilMoistureSampler::GetSweepCount() const
+{
+  return sweep_count_.load(std::memory_order_relaxed);
+}
+
+size_t SoilMoistureSampler::GetFailedReadCount() const
+{
+  return failed_read_count_.load(std::memory_order_relaxed);
+}
+
+size_t SoilMoistureSampler::GetQuarantinedCount() const
+{
+  return quarantined_count_.load(std::memory_order_relaxed);
+}
+
+size_t SoilMoistureSampler::GetBusReopenCount() const
+{
+  return bus_reopen_count_.load(std::memory_order_relaxed);
+}
+
+void SoilMoistureSampler::Run()
+{
+  // Deadlines are absolute. Each channel's advance by whole periods from its
+  // phase offset, so the cadence doesn't stretch by however long each sweep
+  // takes and channels never drift against each other.
+  auto start_time = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < schedules_.size(); ++i)
+  {
+    schedules_[i].next_due = start_time + schedules_[i].phase_offset;
+    timer_wheel_.Schedule(i, schedules_[i].next_due);
+  }
+  PublishNextDue();
+
+  std::unique_lock<std::mutex> lock{stop_mutex_};
+  while (!stop_requested_)
+  {
+    lock.unlock();
+    auto now = std::chrono::steady_clock::now();
+    due_schedules_.clear();
+    timer_wheel_.Advance(now, &due_schedules_);
+    Sweep(now);
+    PublishNextDue();
+    lock.lock();
+
+    std::chrono::steady_clock::time_point wakeup;
+    if (!timer_wheel_.GetNextWakeup(&wakeup))
+    {
+      stop_cv_.wait(lock, [this]() { return stop_requested_; });
+      break;
+    }
+
+    stop_cv_.wait_until(lock, wakeup, [this]() { return stop_requested_; });
+  }
+}
+
+void SoilMoistureSampler::Sweep(std::chrono::steady_clock::time_point now)
+{
+  // A deadline beyond the wheel's horizon fires early. Put it back.
+  due_schedules_.erase(
+      std::remove_if(
+          due_schedules_.begin(),
+          due_schedules_.end(),
+          [this, now](size_t index)
+          {
+            if (schedules_[index].next_due <= now)
+            {
+              return false;
+            }
+            timer_wheel_.Schedule(index, schedules_[index].next_due);
+            return true;
+          }),
+      due_schedules_.end());
+  if (due_schedules_.empty())
+  {
+    return;
+  }
+
+  // Every conversion due on the bus goes into one batch, so the devices
+  // convert in parallel and the sweep costs a handful of transactions.
+  conversions_.clear();
+  for (size_t index : due_schedules_)
+  {
+    const ChannelSchedule &schedule = schedules_[index];
+    for (size_t j = 0; j < sample_count_; ++j)
+    {
+      conversions_.push_back(
+          Ads1115Conversion{schedule.address, schedule.channel, 0, false});
+    }
+  }
+
+  auto steady_time = std::chrono::steady_clock::now();
+  auto wall_time = std::chrono::system_clock::now();
+  if (!ads1115_batch_.Convert(&conversions_))
+  {
+    RetryFailedConversions();
+  }
+  auto conversion_latency =
+      std::chrono::duration_cast<std::chrono::microseconds>(
+          std::chrono::steady_clock::now() - steady_time);
+
+  // A sweep in which nothing read is held against the bus, which a reopen
+  // fixes, rather than against its channels. Otherwise a wedged bus would
+  // quarantine every channel before failing enough sweeps to be reopened.
+  bool is_bus_failure =
+      bus_recovery_policy_.reopen_threshold > 0 &&
+      std::none_of(
+          conversions_.begin(),
+          conversions_.end(),
+          [](const Ads1115Conversion &conversion)
+          {
+            return conversion.is_valid;
+          });
+
+  bool any_sampled = false;
+  bool any_pushed = false;
+  for (size_t i = 0; i < due_schedules_.size(); ++i)
+  {
+    size_t index = due_schedules_[i];
+    ChannelSchedule &schedule = schedules_[index];
+
+    // A failed conversion is left out of the burst rather than failing the
+    // whole channel.
+    size_t read_count = 0;
+    for (size_t j = 0; j < sample_count_; ++j)
+    {
+      const Ads1115Conversion &conversion = conversions_[i * sample_count_ + j];
+      if (!conversion.is_valid)
+      {
+        failed_read_count_.fetch_add(1, std::memory_order_relaxed);
+        continue;
+      }
+      samples_[read_count++] = conversion.value;
+    }
+
+    bool sampled = read_count > 0;
+    any_sampled = any_sampled || sampled;
+    SoilMoistureMeasurement measurement;
+    if (sampled)
+    {
+      measurement = SoilMoistureMeasurement{
+          schedule.sensor_id,
+          filter_.Apply(schedule.sensor_id, samples_.data(), read_count),
+          steady_time,
+          wall_time,
+          conversion_latency};
+      AdaptPeriod(measurement, &schedule);
+    }
+    else if (!schedule.is_quarantined)
+    {
+      LOG(ERROR) << "Failed to read sensor " << schedule.sensor_id;
+    }
+
+    if (!UpdateFaultState(sampled, is_bus_failure, now, &schedule))
+    {
+      schedule.next_due += schedule.period;
+      if (schedule.next_due <= now)
+      {
+        // Overran, or the period just shrank past the missed deadline. Skip
+        // the missed deadlines rather than sampling in a burst to catch up,
+        // and stay on the channel's phase.
+        auto missed = (now - schedule.next_due) / schedule.period + 1;
+        schedule.next_due += schedule.period * missed;
+      }
+    }
+    timer_wheel_.Schedule(index, schedule.next_due);
+
+    if (!sampled)
+    {
+      continue;
+    }
+
+    if (!ring_->TryPush(measurement))
+    {
+      LOG(WARNING) << "Sample ring full. Dropping reading for sensor "
+                   << schedule.sensor_id;
+      continue;
+    }
+    any_pushed = true;
+  }
+
+  // The batch reads every due channel before any reading is filtered, so a
+  // wakeup per reading would only buy the uploader a few microseconds of
+  // filtering. Wake it once per sweep; it uploads while this thread waits
+  // for the next deadline.
+  if (any_pushed)
+  {
+    Notify();
+  }
+
+  UpdateBusHealth(any_sampled, now);
+  sweep_count_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void SoilMoistureSampler::RetryFailedConversions()
+{
+  // Only the failed conversions go round again, so a flaky probe costs one
+  // more short transaction rather than a repeat of the sweep. Quarantined
+  // channels are only being probed and get no retries.
+  for (size_t attempt = 0; attempt < fault_policy_.retry_count; ++attempt)
+  {
+    retry_indices_.clear();
+    retry_conversions_.clear();
+    for (size_t i = 0; i < conversions_.size(); ++i)
+    {
+      if (!conversions_[i].is_valid &&
+          !schedules_[due_schedules_[i / sample_count_]].is_quarantined)
+      {
+        retry_indices_.push_back(i);
+        retry_conversions_.push_back(conversions_[i]);
+      }
+    }
+
+    if (retry_indices_.empty())
+    {
+      return;
+    }
+
+    bool all_valid = ads1115_batch_.Convert(&retry_conversions_);
+    for (size_t i = 0; i < retry_indices_.size(); ++i)
+    {
+      conversions_[retry_indices_[i]] = retry_conversions_[i];
+    }
+
+    if (all_valid)
+    {
+      return;
+    }
+  }
+}
+
+bool SoilMoistureSampler::UpdateFaultState(
+    bool sampled,
+    bool is_bus_failure,
+    std::chrono::steady_clock::time_point now,
+    ChannelSchedule *schedule)
+{
+  assert(schedule);
+
+  if (sampled)
+  {
+    if (schedule->is_quarantined)
+    {
+      LOG(INFO) << "Sensor " << schedule->sensor_id << " recovered";
+      quarantined_count_.fetch_sub(1, std::memory_order_relaxed);
+    }
+    schedule->consecutive_failures = 0;
+    schedule->is_quarantined = false;
+    schedule->quarantine_period = fault_policy_.quarantine_period;
+    return false;
+  }
+
+  if (is_bus_failure && !schedule->is_quarantined)
+  {
+    return false;
+  }
+
+  ++schedule->consecutive_failures;
+  if (fault_policy_.quarantine_threshold == 0 ||
+      schedule->consecutive_failures < fault_policy_.quarantine_threshold)
+  {
+    return false;
+  }
+
+  if (schedule->is_quarantined)
+  {
+    // Still failing. Back off further before the next probe.
+    schedule->quarantine_period = std::min<std::chrono::steady_clock::duration>(
+        2 * schedule->quarantine_period,
+        fault_policy_.max_quarantine_period);
+  }
+  else
+  {
+    schedule->is_quarantined = true;
+    quarantined_count_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  schedule->next_due = now + std::max<std::chrono::steady_clock::duration>(
+      schedule->quarantine_period,
+      TIMER_RESOLUTION);
+  LOG(WARNING) << "Quarantined sensor " << schedule->sensor_id << " after "
+               << schedule->consecutive_failures << " failed reads. Probing "
+               << "again in "
+               << std::chrono::duration_cast<std::chrono::seconds>(
+                      schedule->quarantine_period).count()
+               << " seconds";
+  return true;
+}
+
+void SoilMoistureSampler::UpdateBusHealth(
+    bool any_sampled,
+    std::chrono::steady_clock::time_point now)
+{
+  if (any_sampled)
+  {
+    if (bus_recovery_policy_.reopen_threshold > 0 &&
+        failed_sweeps_ >= bus_recovery_policy_.reopen_threshold)
+    {
+      LOG(INFO) << "I2C bus " << bus_number_ << " recovered";
+    }
+    failed_sweeps_ = 0;
+    reopen_period_ = bus_recovery_policy_.reopen_period;
+    return;
+  }
+
+  // One bad probe fails its own channel. Nothing reading on the whole bus
+  // points at the adapter or the handle instead.
+  ++failed_sweeps_;
+  if (bus_recovery_policy_.reopen_threshold == 0 ||
+      failed_sweeps_ < bus_recovery_policy_.reopen_threshold ||
+      now < next_reopen_)
+  {
+    return;
+  }
+
+  bus_reopen_count_.fetch_add(1, std::memory_order_relaxed);
+  bool reopened = bus_->Reopen();
+  next_reopen_ = now + reopen_period_;
+  reopen_period_ = std::min<std::chrono::steady_clock::duration>(
+      2 * reopen_period_,
+      bus_recovery_policy_.max_reopen_period);
+  if (!reopened)
+  {
+    LOG(ERROR) << "Failed to reopen I2C bus " << bus_number_;
+    return;
+  }
+
+  LOG(WARNING) << "Reopened I2C bus " << bus_number_ << " after "
+               << failed_sweeps_ << " sweeps without a reading";
+
+  // Channels quarantined while the bus was down were most likely fine. Probe
+  // them now rather than after their backoff.
+  for (size_t i = 0; i < schedules_.size(); ++i)
+  {
+    if (schedules_[i].is_quarantined)
+    {
+      schedules_[i].next_due = now;
+      timer_wheel_.Schedule(i, now);
+    }
+  }
+}
+
+void SoilMoistureSampler::AdaptPeriod(
+    const SoilMoistureMeasurement &measurement,
+    ChannelSchedule *schedule) const
+{
+  assert(schedule);
+
+  bool had_last_value = schedule->has_last_value;
+  double last_value = schedule->last_value;
+  auto last_time = schedule->last_time;
+  schedule->has_last_value = true;
+  schedule->last_value = measurement.value;
+  schedule->last_time = measurement.steady_time;
+
+  if (!had_last_value ||
+      sampling_policy_.min_period == sampling_policy_.max_period)
+  {
+    return;
+  }
+
+  std::chrono::duration<double> elapsed = measurement.steady_time - last_time;
+  if (elapsed.count() <= 0)
+  {
+    return;
+  }
+
+  // Seconds it would take to move by the target change at the current rate.
+  double rate = std::fabs(measurement.value - last_value) / elapsed.count();
+  std::chrono::duration<double> wanted = sampling_policy_.max_period;
+  if (rate > 0)
+  {
+    wanted = std::chrono::duration<double>{
+        sampling_policy_.target_change / rate};
+  }
+
+  // Shrink straight away so a watering is caught, but back off gradually so
+  // one flat pair of samples doesn't jump to the longest period.
+  auto period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+      std::min(wanted, std::chrono::duration<double>{2 * schedule->period}));
+  period = std::max<std::chrono::steady_clock::duration>(
+      period,
+      sampling_policy_.min_period);
+  period = std::min<std::chrono::steady_clock::duration>(
+      period,
+      sampling_policy_.max_period);
+  period = std::max<std::chrono::steady_clock::duration>(
+      period,
+      TIMER_RESOLUTION);
+
+  if (period != schedule->period)
+  {
+    VLOG(1) << "Sensor " << schedule->sensor_id << " sampling period now "
+            << std::chrono::duration_cast<std::chrono::seconds>(period).count()
+            << " seconds";
+  }
+  schedule->period = period;
+}
+
+void SoilMoistureSampler::PublishNextDue()
+{
+  auto next_due = std::chrono::steady_clock::time_point::max();
+  for (const ChannelSchedule &schedule : schedules_)
+  {
+    next_due = std::min(next_due, schedule.next_due);
+  }
+  next_due_.store(
+      next_due.time_since_epoch().count(),
+      std::memory_order_relaxed);
+}
+
+void SoilMoistureSampler::Notify()
+{
+  uint64_t one = 1;
+  if (write(notify_fd_, &one, sizeof(one)) < 0 && errno != EAGAIN)
+  {
+    LOG(ERROR) << "Failed to signal sampler eventfd: " << strerror(errno);
+  }
+}
+
+} // namespace organicdump
@@ -0,0 +1,166 @@
+#ifndef ORGANICDUMP_CLIENT_SOILMOISTURESAMPLER_H
+#define ORGANICDUMP_CLIENT_SOILMOISTURESAMPLER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "I2c/Devices/Ads1115AnalogToDigitalConverter/Ads1115Channel.h"
+
+#include "AdaptiveSamplingPolicy.h"
+#include "Ads1115Batch.h"
+#include "Ads1115Policy.h"
+#include "BusRecoveryPolicy.h"
+#include "ChannelFaultPolicy.h"
+#include "I2cBus.h"
+#include "OversamplingPolicy.h"
+#include "SampleFilter.h"
+#include "SensorTopology.h"
+#include "SoilMoistureMeasurement.h"
+#include "SpscRingBuffer.h"
+#include "TimerWheel.h"
+
+namespace organicdump
+{
+
+/**
+ * Samples the soil moisture sensors of one I2C bus on its own thread and
+ * pushes the readings into a ring buffer for the uploader. Buses are
+ * independent, so each gets its own sampler and ring. The notify fd becomes
+ * readable after each sweep that produced readings so the uploader can wait
+ * on it from an event loop. The sampler never blocks on the uploader: a full
+ * ring drops the reading and counts it.
+ *
+ * Each channel is converted |sample_count| times per period and filtered
+ * down to one reading. Channels keep their own period and phase offset on
+ * absolute deadlines held in a timer wheel. Periods adapt to how fast their
+ * reading changes within the AdaptiveSamplingPolicy bounds.
+ *
+ * Faults stay with the channel that has them: failed conversions are retried
+ * on their own, and a channel that keeps failing is quarantined per the
+ * ChannelFaultPolicy while the rest keep their schedule. A bus on which
+ * nothing reads at all is blamed instead of its channels, and reopened per
+ * the BusRecoveryPolicy.
+ *
+ * Reopens happen on the sampler thread. The bus handle therefore lives as
+ * long as the daemon, and only a wedged bus ever costs a reopen.
+ */
+class SoilMoistureSampler
+{
+public:
+  SoilMoistureSampler(
+      I2cBus *bus,
+      std::chrono::microseconds conversion_time,
+      Ads1115Policy adc_policy,
+      std::vector<SensorChannel> channels,
+      std::chrono::seconds measurement_period,
+      AdaptiveSamplingPolicy sampling_policy,
+      OversamplingPolicy oversampling_policy,
+      ChannelFaultPolicy fault_policy,
+      BusRecoveryPolicy bus_recovery_policy,
+      SpscRingBuffer<SoilMoistureMeasurement> *ring);
+  ~SoilMoistureSampler();
+
+  bool Start();
+  void Stop();
+
+  int GetNotifyFd() const;
+
+  /**
+   * Resets the notify fd once the uploader has been woken.
+   */
+  void ConsumeNotification();
+
+  /**
+   * Earliest deadline of any channel, as of the sampler's last sweep. The
+   * uploader uses it to tell how long the session will sit idle.
+   */
+  std::chrono::steady_clock::time_point GetNextDue() const;
+
+  size_t GetSweepCount() const;
+  size_t GetFailedReadCount() const;
+  size_t GetQuarantinedCount() const;
+  size_t GetBusReopenCount() const;
+
+private:
+  struct ChannelSchedule
+  {
+    uint8_t address;
+    I2c::Ads1115Channel channel;
+    size_t sensor_id;
+    std::chrono::steady_clock::duration period;
+    std::chrono::steady_clock::duration phase_offset;
+    std::chrono::steady_clock::time_point next_due;
+    bool has_last_value;
+    double last_value;
+    std::chrono::steady_clock::time_point last_time;
+    size_t consecutive_failures;
+    bool is_quarantined;
+    std::chrono::steady_clock::duration quarantine_period;
+  };
+
+private:
+  void Run();
+  void Sweep(std::chrono::steady_clock::time_point now);
+  void RetryFailedConversions();
+  bool UpdateFaultState(
+      bool sampled,
+      bool is_bus_failure,
+      std::chrono::steady_clock::time_point now,
+      ChannelSchedule *schedule);
+  void UpdateBusHealth(
+      bool any_sampled,
+      std::chrono::steady_clock::time_point now);
+  void AdaptPeriod(
+      const SoilMoistureMeasurement &measurement,
+      ChannelSchedule *schedule) const;
+  void PublishNextDue();
+  void Notify();
+
+private:
+  SoilMoistureSampler(const SoilMoistureSampler &other) = delete;
+  SoilMoistureSampler &operator=(const SoilMoistureSampler &other) = delete;
+
+private:
+  I2cBus *bus_;
+  int bus_number_;
+  Ads1115Batch ads1115_batch_;
+  std::vector<ChannelSchedule> schedules_;
+  AdaptiveSamplingPolicy sampling_policy_;
+  ChannelFaultPolicy fault_policy_;
+  BusRecoveryPolicy bus_recovery_policy_;
+  // Sweeps in a row in which no channel read, and when the bus may next be
+  // reopened.
+  size_t failed_sweeps_;
+  std::chrono::steady_clock::duration reopen_period_;
+  std::chrono::steady_clock::time_point next_reopen_;
+  size_t sample_count_;
+  SampleFilter filter_;
+  std::vector<uint16_t> samples_;
+  // Fires each channel at its next deadline.
+  TimerWheel timer_wheel_;
+  // Per-sweep scratch, reused to keep the sampler thread allocation free.
+  std::vector<size_t> due_schedules_;
+  std::vector<Ads1115Conversion> conversions_;
+  std::vector<size_t> retry_indices_;
+  std::vector<Ads1115Conversion> retry_conversions_;
+  SpscRingBuffer<SoilMoistureMeasurement> *ring_;
+  int notify_fd_;
+  std::thread thread_;
+  std::mutex stop_mutex_;
+  std::condition_variable stop_cv_;
+  bool stop_requested_;
+  std::atomic<std::chrono::steady_clock::rep> next_due_;
+  std::atomic<size_t> sweep_count_;
+  std::atomic<size_t> failed_read_count_;
+  std::atomic<size_t> quarantined_count_;
+  std::atomic<size_t> bus_reopen_count_;
+};
+
+} // namespace organicdump
+
+#endif // ORGANICDUMP_CLIENT_SOILMOISTURESAMPLER_H
@@ -0,0 +1,112 @@
+#ifndef ORGANICDUMP_CLIENT_SPSCRINGBUFFER_H
+#define ORGANICDUMP_CLIENT_SPSCRINGBUFFER_H
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <vector>
+
+namespace organicdump
+{
+
+/**
+ * Bounded lock-free queue for exactly one producer thread and one consumer
+ * thread. Capacity is rounded up to a power of two. A push to a full ring
+ * fails and is counted as a drop; the producer never waits on the consumer.
+ */
+template <typename T>
+class SpscRingBuffer
+{
+public:
+  SpscRingBuffer(size_t capacity)
+    : mask_{RoundUpToPowerOfTwo(capacity) - 1},
+      slots_(mask_ + 1),
+      head_{0},
+      tail_{0},
+      drop_count_{0} {}
+
+  /**
+   * Producer only.
+   */
+  bool TryPush(const T &value)
+  {
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail - head_.load(std::memory_order_acquire) > mask_)
+    {
+      drop_count_.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+
+    slots_[tail & mask_] = value;
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * Consumer only.
+   */
+  bool TryPop(T *out_value)
+  {
+    assert(out_value);
+
+    size_t head = head_.load(std::memory_order_relaxed);
+    if (head == tail_.load(std::memory_order_acquire))
+    {
+      return false;
+    }
+
+    *out_value = slots_[head & mask_];
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * Safe from either thread; exact only from the consumer.
+   */
+  size_t GetSize() const
+  {
+    return tail_.load(std::memory_order_acquire) -
+           head_.load(std::memory_order_acquire);
+  }
+
+  size_t GetCapacity() const
+  {
+    return mask_ + 1;
+  }
+
+  size_t GetDropCount() const
+  {
+    return drop_count_.load(std::memory_order_relaxed);
+  }
+
+private:
+  static size_t RoundUpToPowerOfTwo(size_t value)
+  {
+    size_t result = 1;
+    while (result < value)
+    {
+      result <<= 1;
+    }
+    return result;
+  }
+
+private:
+  SpscRingBuffer(const SpscRingBuffer &other) = delete;
+  SpscRingBuffer &operator=(const SpscRingBuffer &other) = delete;
+
+private:
+  static constexpr size_t CACHE_LINE_SIZE = 64;
+
+  const size_t mask_;
+  std::vector<T> slots_;
+
+  // Producer and consumer indices live on separate cache lines so the two
+  // threads don't bounce one line between cores.
+  alignas(CACHE_LINE_SIZE) std::atomic<size_t> head_;
+  alignas(CACHE_LINE_SIZE) std::atomic<size_t> tail_;
+  alignas(CACHE_LINE_SIZE) std::atomic<size_t> drop_count_;
+};
+
+} // namespace organicdump
+
+#endif // ORGANICDUMP_CLIENT_SPSCRINGBUFFER_H
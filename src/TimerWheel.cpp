@@ -0,0 +1,247 @@
+#include "TimerWheel.h"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace
+{
+constexpr size_t NONE = std::numeric_limits<size_t>::max();
+} // namespace
+
+namespace organicdump
+{
+
+constexpr size_t TimerWheel::LEVEL_COUNT;
+constexpr size_t TimerWheel::SLOT_BITS;
+constexpr size_t TimerWheel::SLOT_COUNT;
+
+TimerWheel::TimerWheel(
+    size_t timer_count,
+    std::chrono::steady_clock::duration resolution,
+    std::chrono::steady_clock::time_point origin)
+  : timers_(timer_count, Timer{0, 0, 0, NONE, NONE, false}),
+    resolution_{resolution},
+    origin_{origin},
+    current_tick_{0}
+{
+  assert(resolution_.count() > 0);
+
+  for (Level &level : levels_)
+  {
+    level.heads.fill(NONE);
+    level.occupied = 0;
+  }
+}
+
+void TimerWheel::Schedule(
+    size_t timer,
+    std::chrono::steady_clock::time_point deadline)
+{
+  assert(timer < timers_.size());
+
+  Cancel(timer);
+
+  // Keep within the current turn of the top level. A clamped timer fires
+  // early, at the end of the turn, and its owner has to schedule it again.
+  uint64_t horizon = current_tick_ | ((uint64_t{1} << (SLOT_BITS * LEVEL_COUNT)) - 1);
+  uint64_t tick = std::max(ToTick(deadline, true), current_tick_);
+  timers_[timer].expiry_tick = std::min(tick, horizon);
+  Insert(timer);
+}
+
+void TimerWheel::Cancel(size_t timer)
+{
+  assert(timer < timers_.size());
+
+  if (timers_[timer].is_scheduled)
+  {
+    Unlink(timer);
+  }
+}
+
+bool TimerWheel::IsScheduled(size_t timer) const
+{
+  assert(timer < timers_.size());
+  return timers_[timer].is_scheduled;
+}
+
+void TimerWheel::Advance(
+    std::chrono::steady_clock::time_point now,
+    std::vector<size_t> *out_expired)
+{
+  assert(out_expired);
+
+  uint64_t target = std::max(ToTick(now, false), current_tick_);
+  while (true)
+  {
+    // Jump straight to the next slot that needs attention rather than
+    // stepping through empty ticks.
+    uint64_t tick;
+    if (!GetNextEventTick(&tick) || tick > target)
+    {
+      current_tick_ = target;
+      return;
+    }
+    current_tick_ = tick;
+
+    // Slots above level 0 whose span has started now hold timers that belong
+    // further down.
+    for (size_t level = LEVEL_COUNT - 1; level > 0; --level)
+    {
+      Cascade(level, (current_tick_ >> (SLOT_BITS * level)) & (SLOT_COUNT - 1));
+    }
+
+    size_t slot = current_tick_ & (SLOT_COUNT - 1);
+    while (levels_[0].heads[slot] != NONE)
+    {
+      size_t timer = levels_[0].heads[slot];
+      Unlink(timer);
+      out_expired->push_back(timer);
+    }
+  }
+}
+
+bool TimerWheel::GetNextWakeup(
+    std::chrono::steady_clock::time_point *out_wakeup) const
+{
+  assert(out_wakeup);
+
+  uint64_t tick;
+  if (!GetNextEventTick(&tick))
+  {
+    return false;
+  }
+
+  *out_wakeup = origin_ + resolution_ * static_cast<int64_t>(tick);
+  return true;
+}
+
+void TimerWheel::Insert(size_t timer)
+{
+  Timer &entry = timers_[timer];
+
+  // A timer lives on the level of the highest slot digit in which its expiry
+  // differs from the current tick, so it moves down a level each time the
+  // wheel reaches the span of its slot.
+  uint64_t differing = entry.expiry_tick ^ current_tick_;
+  size_t level = 0;
+  while (level + 1 < LEVEL_COUNT && (differing >> (SLOT_BITS * (level + 1))) != 0)
+  {
+    ++level;
+  }
+
+  size_t slot = (entry.expiry_tick >> (SLOT_BITS * level)) & (SLOT_COUNT - 1);
+  Level &wheel_level = levels_[level];
+  entry.level = level;
+  entry.slot = slot;
+  entry.prev = NONE;
+  entry.next = wheel_level.heads[slot];
+  entry.is_scheduled = true;
+  if (entry.next != NONE)
+  {
+    timers_[entry.next].prev = timer;
+  }
+  wheel_level.heads[slot] = timer;
+  wheel_level.occupied |= uint64_t{1} << slot;
+}
+
+void TimerWheel::Unlink(size_t timer)
+{
+  Timer &entry = timers_[timer];
+  assert(entry.is_scheduled);
+
+  Level &level = levels_[entry.level];
+  if (entry.prev != NONE)
+  {
+    timers_[entry.prev].next = entry.next;
+  }
+  else
+  {
+    level.heads[entry.slot] = entry.next;
+  }
+  if (entry.next != NONE)
+  {
+    timers_[entry.next].prev = entry.prev;
+  }
+
+  if (level.heads[entry.slot] == NONE)
+  {
+    level.occupied &= ~(uint64_t{1} << entry.slot);
+  }
+
+  entry.prev = NONE;
+  entry.next = NONE;
+  entry.is_scheduled = false;
+}
+
+void TimerWheel::Cascade(size_t level, size_t slot)
+{
+  cascading_.clear();
+  while (levels_[level].heads[slot] != NONE)
+  {
+    size_t timer = levels_[level].heads[slot];
+    Unlink(timer);
+    cascading_.push_back(timer);
+  }
+
+  for (size_t timer : cascading_)
+  {
+    Insert(timer);
+  }
+}
+
+bool TimerWheel::GetNextEventTick(uint64_t *out_tick) const
+{
+  assert(out_tick);
+
+  // The earliest occupied slot at or after the current position on each
+  // level. A slot above level 0 needs attention when its span starts.
+  bool found = false;
+  for (size_t level = 0; level < LEVEL_COUNT; ++level)
+  {
+    size_t shift = SLOT_BITS * level;
+    size_t position = (current_tick_ >> shift) & (SLOT_COUNT - 1);
+    uint64_t occupied = levels_[level].occupied & (~uint64_t{0} << position);
+    if (occupied == 0)
+    {
+      continue;
+    }
+
+    uint64_t slot = static_cast<uint64_t>(__builtin_ctzll(occupied));
+    uint64_t span = uint64_t{1} << shift;
+    uint64_t base = (current_tick_ >> (shift + SLOT_BITS)) << (shift + SLOT_BITS);
+    uint64_t tick = std::max(base + slot * span, current_tick_);
+    if (!found || tick < *out_tick)
+    {
+      *out_tick = tick;
+      found = true;
+    }
+  }
+
+  return found;
+}
+
+uint64_t TimerWheel::ToTick(
+    std::chrono::steady_clock::time_point time,
+    bool round_up) const
+{
+  if (time <= origin_)
+  {
+    return 0;
+  }
+
+  auto elapsed = (time - origin_).count();
+  auto resolution = resolution_.count();
+  auto tick = elapsed / resolution;
+  if (round_up && elapsed % resolution != 0)
+  {
+    ++tick;
+  }
+  return static_cast<uint64_t>(tick);
+}
+
+} // namespace organicdump
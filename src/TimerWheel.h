@@ -0,0 +1,98 @@
+#ifndef ORGANICDUMP_CLIENT_TIMERWHEEL_H
+#define ORGANICDUMP_CLIENT_TIMERWHEEL_H
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace organicdump
+{
+
+/**
+ * Hierarchical timing wheel over a fixed set of timers numbered 0 to
+ * timer_count - 1. Scheduling, cancelling and firing a timer are O(1), as is
+ * finding the next wakeup, so any number of channels can keep their own
+ * deadlines without a scan per sweep.
+ *
+ * Deadlines are absolute steady_clock times rounded up to the resolution, so
+ * a timer fires at most one tick late. Six levels of 64 slots cover 2^36
+ * ticks, over two years at 1 ms. A deadline past the end of the top level's
+ * current turn is clamped to it and fires early, so owners should check
+ * their own deadline when a timer fires.
+ */
+class TimerWheel
+{
+public:
+  TimerWheel(
+      size_t timer_count,
+      std::chrono::steady_clock::duration resolution,
+      std::chrono::steady_clock::time_point origin);
+
+  /**
+   * Fires |timer| at the first Advance() at or after |deadline|. Replaces any
+   * earlier deadline for the timer.
+   */
+  void Schedule(size_t timer, std::chrono::steady_clock::time_point deadline);
+  void Cancel(size_t timer);
+  bool IsScheduled(size_t timer) const;
+
+  /**
+   * Moves the wheel to |now| and appends every timer that fell due to
+   * |out_expired|. Fired timers are no longer scheduled.
+   */
+  void Advance(
+      std::chrono::steady_clock::time_point now,
+      std::vector<size_t> *out_expired);
+
+  /**
+   * Sets |out_wakeup| to when Advance() should next be called. This can be
+   * before the earliest deadline when a timer still has to move down a level,
+   * but never after it. Returns false if no timer is scheduled.
+   */
+  bool GetNextWakeup(std::chrono::steady_clock::time_point *out_wakeup) const;
+
+private:
+  static constexpr size_t LEVEL_COUNT = 6;
+  static constexpr size_t SLOT_BITS = 6;
+  static constexpr size_t SLOT_COUNT = 1 << SLOT_BITS;
+
+  struct Timer
+  {
+    uint64_t expiry_tick;
+    size_t level;
+    size_t slot;
+    // Neighbours in the slot's list, or NONE.
+    size_t prev;
+    size_t next;
+    bool is_scheduled;
+  };
+
+  struct Level
+  {
+    std::array<size_t, SLOT_COUNT> heads;
+    // Bit n is set while slot n holds a timer.
+    uint64_t occupied;
+  };
+
+private:
+  void Insert(size_t timer);
+  void Unlink(size_t timer);
+  void Cascade(size_t level, size_t slot);
+  bool GetNextEventTick(uint64_t *out_tick) const;
+  uint64_t ToTick(std::chrono::steady_clock::time_point time, bool round_up) const;
+
+private:
+  std::vector<Timer> timers_;
+  std::array<Level, LEVEL_COUNT> levels_;
+  std::chrono::steady_clock::duration resolution_;
+  std::chrono::steady_clock::time_point origin_;
+  uint64_t current_tick_;
+  // Timers being moved down by Cascade(), reused to avoid allocating.
+  std::vector<size_t> cascading_;
+};
+
+} // namespace organicdump
+
+#endif // ORGANICDUMP_CLIENT_TIMERWHEEL_H
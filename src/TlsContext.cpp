@@ -0,0 +1,276 @@
+#include "TlsContext.h"
+
+#include <sys/stat.h>
+
+#include <cassert>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <string>
+#include <utility>
+
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+
+#include <glog/logging.h>
+
+#include "TlsStream.h"
+
+namespace
+{
+void LogSslError(const char *what, const std::string &path)
+{
+  char reason[256];
+  ERR_error_string_n(ERR_get_error(), reason, sizeof(reason));
+  ERR_clear_error();
+  LOG(ERROR) << what << " " << path << ": " << reason;
+}
+} // namespace
+
+namespace organicdump
+{
+
+bool TlsContext::Create(
+    std::string ipv4,
+    int32_t port,
+    std::string cert_file,
+    std::string key_file,
+    std::string ca_file,
+    TlsContext *out_context)
+{
+  assert(out_context);
+
+  // A server that drops the session mid-write must surface as a failed
+  // SSL_write, not kill the process.
+  signal(SIGPIPE, SIG_IGN);
+
+  TlsContext context;
+  context.ipv4_ = std::move(ipv4);
+  context.port_ = port;
+  context.cert_file_ = std::move(cert_file);
+  context.key_file_ = std::move(key_file);
+  context.ca_file_ = std::move(ca_file);
+
+  if (!context.Build())
+  {
+    LOG(ERROR) << "Failed to build TLS context";
+    return false;
+  }
+
+  *out_context = std::move(context);
+  return true;
+}
+
+TlsContext::TlsContext()
+  : is_initialized_{false},
+    port_{0},
+    ssl_ctx_{nullptr} {}
+
+TlsContext::TlsContext(TlsContext &&other)
+  : is_initialized_{false},
+    ssl_ctx_{nullptr}
+{
+  StealResources(&other);
+}
+
+TlsContext &TlsContext::operator=(TlsContext &&other)
+{
+  if (this != &other)
+  {
+    CloseResources();
+    StealResources(&other);
+  }
+  return *this;
+}
+
+TlsContext::~TlsContext()
+{
+  CloseResources();
+}
+
+bool TlsContext::Connect(TlsStream *out_stream, SSL_SESSION *session)
+{
+  assert(is_initialized_);
+  assert(out_stream);
+  return TlsStream::Connect(ssl_ctx_, ipv4_, port_, session, out_stream);
+}
+
+bool TlsContext::StartConnect(TlsStream *out_stream, SSL_SESSION *session)
+{
+  assert(is_initialized_);
+  assert(out_stream);
+  return TlsStream::StartConnect(ssl_ctx_, ipv4_, port_, session, out_stream);
+}
+
+bool TlsContext::ReloadIfChanged()
+{
+  assert(is_initialized_);
+
+  FileStamp cert_stamp;
+  FileStamp key_stamp;
+  FileStamp ca_stamp;
+  if (!StatFile(cert_file_, &cert_stamp) ||
+      !StatFile(key_file_, &key_stamp) ||
+      !StatFile(ca_file_, &ca_stamp))
+  {
+    LOG(ERROR) << "Failed to stat TLS credentials. Keeping current context";
+    return false;
+  }
+
+  if (IsSameFile(cert_stamp, cert_stamp_) &&
+      IsSameFile(key_stamp, key_stamp_) &&
+      IsSameFile(ca_stamp, ca_stamp_))
+  {
+    return true;
+  }
+
+  LOG(INFO) << "TLS credentials changed on disk. Rebuilding TLS context";
+
+  TlsContext context;
+  context.ipv4_ = ipv4_;
+  context.port_ = port_;
+  context.cert_file_ = cert_file_;
+  context.key_file_ = key_file_;
+  context.ca_file_ = ca_file_;
+
+  if (!context.Build())
+  {
+    LOG(ERROR) << "Failed to rebuild TLS context. Keeping current context";
+    return false;
+  }
+
+  *this = std::move(context);
+  return true;
+}
+
+const std::string &TlsContext::GetIpv4() const
+{
+  return ipv4_;
+}
+
+int32_t TlsContext::GetPort() const
+{
+  return port_;
+}
+
+bool TlsContext::StatFile(const std::string &path, FileStamp *out_stamp)
+{
+  assert(out_stamp);
+
+  struct stat file_stat;
+  if (stat(path.c_str(), &file_stat) != 0)
+  {
+    LOG(ERROR) << "Failed to stat " << path << ": " << strerror(errno);
+    return false;
+  }
+
+  out_stamp->device = file_stat.st_dev;
+  out_stamp->inode = file_stat.st_ino;
+  out_stamp->size = file_stat.st_size;
+  out_stamp->modified = file_stat.st_mtim;
+  return true;
+}
+
+bool TlsContext::IsSameFile(const FileStamp &lhs, const FileStamp &rhs)
+{
+  // Certificate rotation usually renames a new file into place, so compare
+  // the inode as well as the modification time.
+  return lhs.device == rhs.device &&
+         lhs.inode == rhs.inode &&
+         lhs.size == rhs.size &&
+         lhs.modified.tv_sec == rhs.modified.tv_sec &&
+         lhs.modified.tv_nsec == rhs.modified.tv_nsec;
+}
+
+bool TlsContext::Build()
+{
+  // Stamp the files before reading them so that a write racing with the
+  // build is picked up by the next reload check.
+  if (!StatFile(cert_file_, &cert_stamp_) ||
+      !StatFile(key_file_, &key_stamp_) ||
+      !StatFile(ca_file_, &ca_stamp_))
+  {
+    return false;
+  }
+
+  // Connections hold their own reference to the SSL_CTX, so a rebuild can
+  // swap it out under sessions that are still open.
+  ssl_ctx_ = SSL_CTX_new(TLS_client_method());
+  if (!ssl_ctx_)
+  {
+    LogSslError("Failed to allocate SSL_CTX for", ipv4_);
+    return false;
+  }
+
+  // Marked initialized now so that CloseResources() frees the SSL_CTX if a
+  // later step fails.
+  is_initialized_ = true;
+
+  if (SSL_CTX_use_certificate_chain_file(ssl_ctx_, cert_file_.c_str()) != 1)
+  {
+    LogSslError("Failed to load certificate", cert_file_);
+    return false;
+  }
+
+  if (SSL_CTX_use_PrivateKey_file(
+          ssl_ctx_,
+          key_file_.c_str(),
+          SSL_FILETYPE_PEM) != 1 ||
+      SSL_CTX_check_private_key(ssl_ctx_) != 1)
+  {
+    LogSslError("Failed to load private key", key_file_);
+    return false;
+  }
+
+  if (SSL_CTX_load_verify_locations(ssl_ctx_, ca_file_.c_str(), nullptr) != 1)
+  {
+    LogSslError("Failed to load CA", ca_file_);
+    return false;
+  }
+
+  SSL_CTX_set_verify(ssl_ctx_, SSL_VERIFY_PEER, nullptr);
+  SSL_CTX_set_min_proto_version(ssl_ctx_, TLS1_2_VERSION);
+  SSL_CTX_set_mode(ssl_ctx_, SSL_MODE_AUTO_RETRY);
+
+  // Streams are non-blocking. A write the socket only partly takes reports
+  // what went out, and the rest is retried from the send buffer, which may
+  // have been reallocated by then.
+  SSL_CTX_set_mode(
+      ssl_ctx_,
+      SSL_MODE_ENABLE_PARTIAL_WRITE | SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+
+  // Sessions are cached by TlsSessionCache, which outlives the connection.
+  SSL_CTX_set_session_cache_mode(ssl_ctx_, SSL_SESS_CACHE_CLIENT);
+  return true;
+}
+
+void TlsContext::CloseResources()
+{
+  if (!is_initialized_)
+  {
+    return;
+  }
+
+  is_initialized_ = false;
+  SSL_CTX_free(ssl_ctx_);
+  ssl_ctx_ = nullptr;
+}
+
+void TlsContext::StealResources(TlsContext *other)
+{
+  assert(other);
+  is_initialized_ = other->is_initialized_;
+  other->is_initialized_ = false;
+  ipv4_ = std::move(other->ipv4_);
+  port_ = other->port_;
+  cert_file_ = std::move(other->cert_file_);
+  key_file_ = std::move(other->key_file_);
+  ca_file_ = std::move(other->ca_file_);
+  cert_stamp_ = other->cert_stamp_;
+  key_stamp_ = other->key_stamp_;
+  ca_stamp_ = other->ca_stamp_;
+  ssl_ctx_ = other->ssl_ctx_;
+  other->ssl_ctx_ = nullptr;
+}
+
+} // namespace organicdump
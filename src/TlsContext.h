@@ -0,0 +1,95 @@
+#ifndef ORGANICDUMP_CLIENT_TLSCONTEXT_H
+#define ORGANICDUMP_CLIENT_TLSCONTEXT_H
+
+#include <sys/types.h>
+
+#include <cstdint>
+#include <ctime>
+#include <string>
+
+#include <openssl/ssl.h>
+
+#include "TlsStream.h"
+
+namespace organicdump
+{
+
+/**
+ * TLS client context for one server: the cert, key and CA are read and parsed
+ * once into an SSL_CTX, and every connection to the server reuses the result.
+ * The server's certificate must chain to the CA.
+ */
+class TlsContext
+{
+public:
+  static bool Create(
+      std::string ipv4,
+      int32_t port,
+      std::string cert_file,
+      std::string key_file,
+      std::string ca_file,
+      TlsContext *out_context);
+
+public:
+  TlsContext();
+  TlsContext(TlsContext &&other);
+  TlsContext &operator=(TlsContext &&other);
+  ~TlsContext();
+
+  /**
+   * Opens a new connection to the server, offering |session| for resumption
+   * if it's non-null.
+   */
+  bool Connect(TlsStream *out_stream, SSL_SESSION *session=nullptr);
+
+  /**
+   * Like Connect(), but leaves the handshake for the caller to drive with
+   * TlsStream::ContinueConnect().
+   */
+  bool StartConnect(TlsStream *out_stream, SSL_SESSION *session=nullptr);
+
+  /**
+   * Rebuilds the context if the cert, key or CA file changed on disk since
+   * the last build. If a changed file fails to load, the current context is
+   * kept and false is returned.
+   */
+  bool ReloadIfChanged();
+
+  const std::string &GetIpv4() const;
+  int32_t GetPort() const;
+
+private:
+  struct FileStamp
+  {
+    dev_t device;
+    ino_t inode;
+    off_t size;
+    struct timespec modified;
+  };
+
+  static bool StatFile(const std::string &path, FileStamp *out_stamp);
+  static bool IsSameFile(const FileStamp &lhs, const FileStamp &rhs);
+  bool Build();
+  void CloseResources();
+  void StealResources(TlsContext *other);
+
+private:
+  TlsContext(const TlsContext &other) = delete;
+  TlsContext &operator=(const TlsContext &other) = delete;
+
+private:
+  bool is_initialized_;
+  std::string ipv4_;
+  int32_t port_;
+  std::string cert_file_;
+  std::string key_file_;
+  std::string ca_file_;
+  FileStamp cert_stamp_;
+  FileStamp key_stamp_;
+  FileStamp ca_stamp_;
+  SSL_CTX *ssl_ctx_;
+};
+
+} // namespace organicdump
+
+#endif // ORGANICDUMP_CLIENT_TLSCONTEXT_H
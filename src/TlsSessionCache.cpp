@@ -0,0 +1,198 @@
+#include "TlsSessionCache.h"
+
+#include <cassert>
+#include <cstdio>
+#include <string>
+#include <utility>
+
+#include <openssl/bio.h>
+#include <openssl/pem.h>
+#include <openssl/ssl.h>
+
+#include <glog/logging.h>
+
+#include "FileUtilities.h"
+
+namespace organicdump
+{
+
+TlsSessionCache::TlsSessionCache()
+  : session_{nullptr},
+    handshake_count_{0},
+    resumed_handshake_count_{0} {}
+
+TlsSessionCache::TlsSessionCache(std::string cache_file)
+  : cache_file_{std::move(cache_file)},
+    session_{nullptr},
+    handshake_count_{0},
+    resumed_handshake_count_{0}
+{
+  if (!cache_file_.empty() && !Load())
+  {
+    LOG(INFO) << "No usable TLS session in cache file " << cache_file_;
+  }
+}
+
+TlsSessionCache::TlsSessionCache(TlsSessionCache &&other)
+  : session_{nullptr}
+{
+  StealResources(&other);
+}
+
+TlsSessionCache &TlsSessionCache::operator=(TlsSessionCache &&other)
+{
+  if (this != &other)
+  {
+    CloseResources();
+    StealResources(&other);
+  }
+  return *this;
+}
+
+TlsSessionCache::~TlsSessionCache()
+{
+  CloseResources();
+}
+
+SSL_SESSION *TlsSessionCache::Lookup()
+{
+  return session_;
+}
+
+void TlsSessionCache::Store(SSL *ssl)
+{
+  assert(ssl);
+
+  SSL_SESSION *session = SSL_get1_session(ssl);
+  if (!session)
+  {
+    return;
+  }
+
+  if (session_)
+  {
+    SSL_SESSION_free(session_);
+  }
+  session_ = session;
+
+  if (!cache_file_.empty() && !Save())
+  {
+    LOG(WARNING) << "Failed to write TLS session cache file " << cache_file_;
+  }
+}
+
+void TlsSessionCache::Invalidate()
+{
+  if (session_)
+  {
+    SSL_SESSION_free(session_);
+    session_ = nullptr;
+  }
+
+  if (!cache_file_.empty())
+  {
+    std::remove(cache_file_.c_str());
+  }
+}
+
+void TlsSessionCache::RecordHandshake(bool resumed)
+{
+  ++handshake_count_;
+  if (resumed)
+  {
+    ++resumed_handshake_count_;
+  }
+
+  LOG(INFO) << "TLS handshake " << (resumed ? "resumed" : "full")
+            << ". Resumption hit rate: " << GetHitRate()
+            << " (" << resumed_handshake_count_ << "/" << handshake_count_ << ")";
+}
+
+size_t TlsSessionCache::GetHandshakeCount() const
+{
+  return handshake_count_;
+}
+
+size_t TlsSessionCache::GetResumedHandshakeCount() const
+{
+  return resumed_handshake_count_;
+}
+
+double TlsSessionCache::GetHitRate() const
+{
+  if (handshake_count_ == 0)
+  {
+    return 0.0;
+  }
+  return static_cast<double>(resumed_handshake_count_) / handshake_count_;
+}
+
+bool TlsSessionCache::Load()
+{
+  FILE *file = std::fopen(cache_file_.c_str(), "r");
+  if (!file)
+  {
+    return false;
+  }
+
+  SSL_SESSION *session = PEM_read_SSL_SESSION(file, nullptr, nullptr, nullptr);
+  std::fclose(file);
+
+  if (!session)
+  {
+    LOG(WARNING) << "Ignoring malformed TLS session cache file " << cache_file_;
+    return false;
+  }
+
+  session_ = session;
+  return true;
+}
+
+bool TlsSessionCache::Save() const
+{
+  assert(session_);
+
+  BIO *bio = BIO_new(BIO_s_mem());
+  if (!bio)
+  {
+    return false;
+  }
+
+  std::string pem;
+  if (PEM_write_bio_SSL_SESSION(bio, session_) == 1)
+  {
+    char *data = nullptr;
+    long size = BIO_get_mem_data(bio, &data);
+    pem.assign(data, static_cast<size_t>(size));
+  }
+  BIO_free(bio);
+
+  if (pem.empty())
+  {
+    return false;
+  }
+
+  // The session is a bearer credential for resumption: keep it private.
+  return WriteFileAtomically(cache_file_, pem, 0600);
+}
+
+void TlsSessionCache::CloseResources()
+{
+  if (session_)
+  {
+    SSL_SESSION_free(session_);
+    session_ = nullptr;
+  }
+}
+
+void TlsSessionCache::StealResources(TlsSessionCache *other)
+{
+  assert(other);
+  cache_file_ = std::move(other->cache_file_);
+  session_ = other->session_;
+  other->session_ = nullptr;
+  handshake_count_ = other->handshake_count_;
+  resumed_handshake_count_ = other->resumed_handshake_count_;
+}
+
+} // namespace organicdump
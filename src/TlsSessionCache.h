@@ -0,0 +1,72 @@
+#ifndef ORGANICDUMP_CLIENT_TLSSESSIONCACHE_H
+#define ORGANICDUMP_CLIENT_TLSSESSIONCACHE_H
+
+#include <cstddef>
+#include <string>
+
+#include <openssl/ssl.h>
+
+namespace organicdump
+{
+
+/**
+ * Client-side TLS session cache. Holds the most recent session for one server
+ * so that reconnects can use an abbreviated handshake. If a cache file is
+ * given, the session is also kept on disk so it survives a daemon restart.
+ */
+class TlsSessionCache
+{
+public:
+  TlsSessionCache();
+  TlsSessionCache(std::string cache_file);
+  TlsSessionCache(TlsSessionCache &&other);
+  TlsSessionCache &operator=(TlsSessionCache &&other);
+  ~TlsSessionCache();
+
+  /**
+   * Returns the cached session, or nullptr if there is none. The cache keeps
+   * ownership of the session.
+   */
+  SSL_SESSION *Lookup();
+
+  /**
+   * Takes a reference to the session negotiated on |ssl| and writes it
+   * through to the cache file. Call this late in a connection's life: TLS 1.3
+   * servers send tickets after the handshake.
+   */
+  void Store(SSL *ssl);
+
+  /**
+   * Drops the cached session, e.g. after the server rejected it.
+   */
+  void Invalidate();
+
+  /**
+   * Counts a completed handshake for the resumption hit rate.
+   */
+  void RecordHandshake(bool resumed);
+
+  size_t GetHandshakeCount() const;
+  size_t GetResumedHandshakeCount() const;
+  double GetHitRate() const;
+
+private:
+  bool Load();
+  bool Save() const;
+  void CloseResources();
+  void StealResources(TlsSessionCache *other);
+
+private:
+  TlsSessionCache(const TlsSessionCache &other) = delete;
+  TlsSessionCache &operator=(const TlsSessionCache &other) = delete;
+
+private:
+  std::string cache_file_;
+  SSL_SESSION *session_;
+  size_t handshake_count_;
+  size_t resumed_handshake_count_;
+};
+
+} // namespace organicdump
+
+#endif // ORGANICDUMP_CLIENT_TLSSESSIONCACHE_H
@@ -0,0 +1,394 @@
+#include "TlsStream.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <utility>
+
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+
+#include <glog/logging.h>
+
+namespace
+{
+// Logs and clears the OpenSSL error queue so a stale entry isn't blamed on
+// the next call.
+void LogSslError(const char *what, int ssl_error)
+{
+  char reason[256];
+  unsigned long err = ERR_get_error();
+  if (err != 0)
+  {
+    ERR_error_string_n(err, reason, sizeof(reason));
+  }
+  else
+  {
+    std::strncpy(reason, strerror(errno), sizeof(reason) - 1);
+    reason[sizeof(reason) - 1] = '\0';
+  }
+  ERR_clear_error();
+
+  LOG(ERROR) << what << " failed (SSL error " << ssl_error << "): " << reason;
+}
+
+bool IsClosedError(int ssl_error)
+{
+  if (ssl_error == SSL_ERROR_ZERO_RETURN)
+  {
+    return true;
+  }
+
+  // A peer that drops the socket without close_notify shows up as a syscall
+  // error with EOF or a reset.
+  return ssl_error == SSL_ERROR_SYSCALL &&
+         (errno == 0 || errno == ECONNRESET || errno == EPIPE);
+}
+} // namespace
+
+namespace organicdump
+{
+
+bool TlsStream::Connect(
+    SSL_CTX *ssl_ctx,
+    const std::string &ipv4,
+    int32_t port,
+    SSL_SESSION *session,
+    TlsStream *out_stream)
+{
+  assert(out_stream);
+
+  // The handshake runs in |out_stream| so that a failed one can still be
+  // asked why it failed.
+  if (!StartConnect(ssl_ctx, ipv4, port, session, out_stream))
+  {
+    return false;
+  }
+
+  bool connected = false;
+  while (true)
+  {
+    if (!out_stream->ContinueConnect(&connected))
+    {
+      return false;
+    }
+
+    if (connected)
+    {
+      break;
+    }
+
+    struct pollfd poll_fd = {};
+    poll_fd.fd = out_stream->fd_;
+    poll_fd.events = out_stream->wants_write_ ? POLLOUT : POLLIN;
+    if (poll(&poll_fd, 1, -1) < 0 && errno != EINTR)
+    {
+      LOG(ERROR) << "Failed to wait on TLS handshake: " << strerror(errno);
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool TlsStream::StartConnect(
+    SSL_CTX *ssl_ctx,
+    const std::string &ipv4,
+    int32_t port,
+    SSL_SESSION *session,
+    TlsStream *out_stream)
+{
+  assert(ssl_ctx);
+  assert(out_stream);
+
+  sockaddr_in address;
+  std::memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+  address.sin_port = htons(static_cast<uint16_t>(port));
+  if (inet_pton(AF_INET, ipv4.c_str(), &address.sin_addr) != 1)
+  {
+    LOG(ERROR) << "Invalid server address " << ipv4;
+    return false;
+  }
+
+  TlsStream stream;
+  stream.fd_ = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (stream.fd_ < 0)
+  {
+    LOG(ERROR) << "Failed to create socket: " << strerror(errno);
+    return false;
+  }
+
+  if (connect(
+          stream.fd_,
+          reinterpret_cast<const sockaddr *>(&address),
+          sizeof(address)) != 0 &&
+      errno != EINPROGRESS)
+  {
+    LOG(ERROR) << "Failed to connect to " << ipv4 << ":" << port << ": "
+               << strerror(errno);
+    return false;
+  }
+
+  // Frames are coalesced before they're written, so Nagle would only hold a
+  // pipelined request back behind an unacknowledged one.
+  int no_delay = 1;
+  if (setsockopt(
+          stream.fd_,
+          IPPROTO_TCP,
+          TCP_NODELAY,
+          &no_delay,
+          sizeof(no_delay)) != 0)
+  {
+    LOG(WARNING) << "Failed to disable Nagle: " << strerror(errno);
+  }
+
+  stream.ssl_ = SSL_new(ssl_ctx);
+  if (!stream.ssl_ || SSL_set_fd(stream.ssl_, stream.fd_) != 1)
+  {
+    LogSslError("SSL_new", 0);
+    return false;
+  }
+
+  if (session && SSL_set_session(stream.ssl_, session) != 1)
+  {
+    // Not fatal: the handshake just won't be abbreviated.
+    LogSslError("SSL_set_session", 0);
+  }
+
+  // The TCP connect completes when the socket turns writable, and the
+  // ClientHello goes out then.
+  stream.wants_write_ = true;
+  *out_stream = std::move(stream);
+  return true;
+}
+
+TlsStream::TlsStream()
+  : fd_{-1},
+    ssl_{nullptr},
+    wants_write_{false},
+    handshake_rejected_{false},
+    write_call_count_{0} {}
+
+TlsStream::TlsStream(TlsStream &&other)
+  : fd_{-1},
+    ssl_{nullptr}
+{
+  StealResources(&other);
+}
+
+TlsStream &TlsStream::operator=(TlsStream &&other)
+{
+  if (this != &other)
+  {
+    CloseResources();
+    StealResources(&other);
+  }
+  return *this;
+}
+
+TlsStream::~TlsStream()
+{
+  CloseResources();
+}
+
+bool TlsStream::ContinueConnect(bool *out_connected)
+{
+  assert(ssl_);
+  assert(out_connected);
+
+  *out_connected = false;
+
+  errno = 0;
+  int ret = SSL_connect(ssl_);
+  if (ret == 1)
+  {
+    wants_write_ = false;
+    *out_connected = true;
+    return true;
+  }
+
+  int ssl_error = SSL_get_error(ssl_, ret);
+  if (ssl_error == SSL_ERROR_WANT_READ || ssl_error == SSL_ERROR_WANT_WRITE)
+  {
+    wants_write_ = ssl_error == SSL_ERROR_WANT_WRITE;
+    return true;
+  }
+
+  // A refused or unreachable TCP connect also surfaces here, as a syscall
+  // error from the first write. Only SSL_ERROR_SSL means the TLS exchange
+  // itself went wrong.
+  handshake_rejected_ = ssl_error == SSL_ERROR_SSL;
+  LogSslError("TLS handshake", ssl_error);
+  return false;
+}
+
+bool TlsStream::WantsWrite() const
+{
+  return wants_write_;
+}
+
+bool TlsStream::IsHandshakeRejected() const
+{
+  return handshake_rejected_;
+}
+
+bool TlsStream::Read(
+    uint8_t *buffer,
+    size_t size,
+    size_t *out_bytes_read,
+    bool *out_cxn_closed)
+{
+  assert(ssl_);
+  assert(buffer);
+  assert(out_bytes_read);
+  assert(out_cxn_closed);
+
+  *out_bytes_read = 0;
+  *out_cxn_closed = false;
+
+  errno = 0;
+  int ret = SSL_read(ssl_, buffer, static_cast<int>(size));
+  if (ret > 0)
+  {
+    wants_write_ = false;
+    *out_bytes_read = static_cast<size_t>(ret);
+    return true;
+  }
+
+  int ssl_error = SSL_get_error(ssl_, ret);
+  if (ssl_error == SSL_ERROR_WANT_READ || ssl_error == SSL_ERROR_WANT_WRITE)
+  {
+    // No whole record yet, or TLS has one of its own to send first.
+    wants_write_ = ssl_error == SSL_ERROR_WANT_WRITE;
+    return true;
+  }
+
+  if (IsClosedError(ssl_error))
+  {
+    ERR_clear_error();
+    *out_cxn_closed = true;
+    return false;
+  }
+
+  LogSslError("SSL_read", ssl_error);
+  return false;
+}
+
+bool TlsStream::Write(
+    const uint8_t *data,
+    size_t size,
+    size_t *out_bytes_written,
+    bool *out_cxn_closed)
+{
+  assert(ssl_);
+  assert(data);
+  assert(out_bytes_written);
+  assert(out_cxn_closed);
+
+  *out_bytes_written = 0;
+  *out_cxn_closed = false;
+  wants_write_ = false;
+
+  // With SSL_MODE_ENABLE_PARTIAL_WRITE each SSL_write returns once a record
+  // is out, so this is one call per 16 KiB record until the socket buffer
+  // fills.
+  size_t written = 0;
+  while (written < size)
+  {
+    errno = 0;
+    int ret = SSL_write(ssl_, data + written, static_cast<int>(size - written));
+    ++write_call_count_;
+    if (ret > 0)
+    {
+      written += static_cast<size_t>(ret);
+      continue;
+    }
+
+    int ssl_error = SSL_get_error(ssl_, ret);
+    if (ssl_error == SSL_ERROR_WANT_READ || ssl_error == SSL_ERROR_WANT_WRITE)
+    {
+      wants_write_ = ssl_error == SSL_ERROR_WANT_WRITE;
+      break;
+    }
+
+    if (ssl_error == SSL_ERROR_SYSCALL && errno == EINTR)
+    {
+      continue;
+    }
+
+    if (IsClosedError(ssl_error))
+    {
+      ERR_clear_error();
+      *out_cxn_closed = true;
+      return false;
+    }
+
+    LogSslError("SSL_write", ssl_error);
+    return false;
+  }
+
+  *out_bytes_written = written;
+  return true;
+}
+
+bool TlsStream::HasPendingData() const
+{
+  return ssl_ && SSL_pending(ssl_) > 0;
+}
+
+int TlsStream::GetFd() const
+{
+  return fd_;
+}
+
+SSL *TlsStream::GetSsl() const
+{
+  return ssl_;
+}
+
+size_t TlsStream::GetWriteCallCount() const
+{
+  return write_call_count_;
+}
+
+void TlsStream::CloseResources()
+{
+  if (ssl_)
+  {
+    // Best effort: the peer may already be gone, and on a non-blocking
+    // socket close_notify is sent only if it fits.
+    SSL_shutdown(ssl_);
+    SSL_free(ssl_);
+    ssl_ = nullptr;
+    ERR_clear_error();
+  }
+
+  if (fd_ >= 0)
+  {
+    close(fd_);
+    fd_ = -1;
+  }
+}
+
+void TlsStream::StealResources(TlsStream *other)
+{
+  assert(other);
+  fd_ = other->fd_;
+  other->fd_ = -1;
+  ssl_ = other->ssl_;
+  other->ssl_ = nullptr;
+  wants_write_ = other->wants_write_;
+  handshake_rejected_ = other->handshake_rejected_;
+  write_call_count_ = other->write_call_count_;
+}
+
+} // namespace organicdump
@@ -0,0 +1,102 @@
+#ifndef ORGANICDUMP_CLIENT_TLSSTREAM_H
+#define ORGANICDUMP_CLIENT_TLSSTREAM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include <openssl/ssl.h>
+
+#include "ByteStream.h"
+
+namespace organicdump
+{
+
+/**
+ * ByteStream over a TLS connection on a non-blocking TCP socket, so that it
+ * can share an event loop. The connect and handshake can also be run to
+ * completion in one blocking call.
+ */
+class TlsStream : public ByteStream
+{
+public:
+  /**
+   * Connects to |ipv4|:|port| and runs the handshake with |ssl_ctx|,
+   * offering |session| for resumption if it's non-null. On failure
+   * |out_stream| is left unusable, but IsHandshakeRejected() says whether
+   * the handshake itself failed.
+   */
+  static bool Connect(
+      SSL_CTX *ssl_ctx,
+      const std::string &ipv4,
+      int32_t port,
+      SSL_SESSION *session,
+      TlsStream *out_stream);
+
+  /**
+   * Like Connect(), but returns as soon as the TCP connect is under way.
+   * Finish with ContinueConnect().
+   */
+  static bool StartConnect(
+      SSL_CTX *ssl_ctx,
+      const std::string &ipv4,
+      int32_t port,
+      SSL_SESSION *session,
+      TlsStream *out_stream);
+
+public:
+  TlsStream();
+  TlsStream(TlsStream &&other);
+  TlsStream &operator=(TlsStream &&other);
+  ~TlsStream() override;
+
+  /**
+   * Advances a connect begun by StartConnect() as far as it will go without
+   * blocking. Once |out_connected| is set the stream is ready for use.
+   * Until then, call again when the fd is readable, or writable if
+   * WantsWrite().
+   */
+  bool ContinueConnect(bool *out_connected);
+  bool WantsWrite() const override;
+
+  /**
+   * True if the connect failed in the TLS handshake itself, on an alert from
+   * the server or a certificate that didn't verify, rather than in the TCP
+   * connect or the transport under the handshake.
+   */
+  bool IsHandshakeRejected() const;
+
+  bool Read(
+      uint8_t *buffer,
+      size_t size,
+      size_t *out_bytes_read,
+      bool *out_cxn_closed) override;
+  bool Write(
+      const uint8_t *data,
+      size_t size,
+      size_t *out_bytes_written,
+      bool *out_cxn_closed) override;
+  bool HasPendingData() const override;
+  int GetFd() const override;
+  SSL *GetSsl() const override;
+  size_t GetWriteCallCount() const override;
+
+private:
+  void CloseResources();
+  void StealResources(TlsStream *other);
+
+private:
+  TlsStream(const TlsStream &other) = delete;
+  TlsStream &operator=(const TlsStream &other) = delete;
+
+private:
+  int fd_;
+  SSL *ssl_;
+  bool wants_write_;
+  bool handshake_rejected_;
+  size_t write_call_count_;
+};
+
+} // namespace organicdump
+
+#endif // ORGANICDUMP_CLIENT_TLSSTREAM_H
@@ -0,0 +1,114 @@
+#include "UploadTracker.h"
+
+#include <cassert>
+#include <cstdint>
+
+namespace organicdump
+{
+
+UploadTracker::UploadTracker(MeasurementSpool *spool)
+  : spool_{spool},
+    next_post_seq_{0}
+{
+  assert(spool_);
+  Reset();
+}
+
+void UploadTracker::Reset()
+{
+  next_post_seq_ = spool_->GetHeadSeq();
+  in_flight_seqs_.clear();
+  completed_seqs_.clear();
+}
+
+bool UploadTracker::HasUnposted() const
+{
+  return next_post_seq_ < spool_->GetTailSeq();
+}
+
+uint64_t UploadTracker::GetNextSeq() const
+{
+  return next_post_seq_;
+}
+
+void UploadTracker::MarkPosted()
+{
+  assert(HasUnposted());
+  in_flight_seqs_.push_back(next_post_seq_);
+  ++next_post_seq_;
+}
+
+size_t UploadTracker::GetInFlightCount() const
+{
+  return in_flight_seqs_.size();
+}
+
+uint64_t UploadTracker::GetOldestInFlight() const
+{
+  assert(!in_flight_seqs_.empty());
+  return in_flight_seqs_.front();
+}
+
+uint64_t UploadTracker::PopInFlight()
+{
+  assert(!in_flight_seqs_.empty());
+  uint64_t seq = in_flight_seqs_.front();
+  in_flight_seqs_.pop_front();
+  return seq;
+}
+
+void UploadTracker::RewindInFlight()
+{
+  // In-flight readings were posted from the cursor in order and no handoff
+  // happens while any are in flight, so they are exactly the readings just
+  // before the cursor.
+  if (!in_flight_seqs_.empty())
+  {
+    assert(in_flight_seqs_.back() + 1 == next_post_seq_);
+    next_post_seq_ = in_flight_seqs_.front();
+    in_flight_seqs_.clear();
+  }
+}
+
+bool UploadTracker::CanHandOffBacklog(size_t threshold) const
+{
+  return in_flight_seqs_.empty() &&
+         spool_->GetTailSeq() - next_post_seq_ > threshold;
+}
+
+void UploadTracker::HandOffBacklog()
+{
+  assert(in_flight_seqs_.empty());
+  next_post_seq_ = spool_->GetTailSeq();
+}
+
+bool UploadTracker::Complete(uint64_t seq)
+{
+  // A reading below the head was released already. Keeping it would leave
+  // an entry that never reaches the head and blocks every release after it.
+  if (seq < spool_->GetHeadSeq())
+  {
+    return false;
+  }
+
+  if (seq != spool_->GetHeadSeq())
+  {
+    return completed_seqs_.insert(seq).second;
+  }
+
+  spool_->Ack(1);
+  while (!completed_seqs_.empty() &&
+         *completed_seqs_.begin() == spool_->GetHeadSeq())
+  {
+    completed_seqs_.erase(completed_seqs_.begin());
+    spool_->Ack(1);
+  }
+  return true;
+}
+
+size_t UploadTracker::GetPendingCompletionCount() const
+{
+  return completed_seqs_.size();
+}
+
+} // namespace organicdump
@@ -0,0 +1,93 @@
+#ifndef ORGANICDUMP_CLIENT_UPLOADTRACKER_H
+#define ORGANICDUMP_CLIENT_UPLOADTRACKER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <set>
+
+#include "MeasurementSpool.h"
+
+namespace organicdump
+{
+
+/**
+ * Upload bookkeeping for the spooled readings [head, tail) of a
+ * MeasurementSpool. The live session posts readings in order from a cursor
+ * and completes them in order; a backlog handed to the drainer is completed
+ * out of order. The spool head is released as soon as the oldest readings
+ * are all complete.
+ *
+ * Every reading is owned by exactly one of: the live cursor's unposted range,
+ * the live session's in-flight list, or the drainer, so no reading is ever
+ * uploaded by two sessions at once.
+ */
+class UploadTracker
+{
+public:
+  UploadTracker(MeasurementSpool *spool);
+
+  /**
+   * Forgets every post and completion and restarts the cursor at the spool
+   * head.
+   */
+  void Reset();
+
+  bool HasUnposted() const;
+  uint64_t GetNextSeq() const;
+
+  /**
+   * Records that the reading at GetNextSeq() was posted on the live session.
+   */
+  void MarkPosted();
+
+  size_t GetInFlightCount() const;
+  uint64_t GetOldestInFlight() const;
+
+  /**
+   * Takes the oldest in-flight reading off the live session once its
+   * response has arrived. Complete() it to release it from the spool.
+   */
+  uint64_t PopInFlight();
+
+  /**
+   * After the live session failed, moves its in-flight readings back in
+   * front of the cursor so they're posted again on the next session.
+   */
+  void RewindInFlight();
+
+  /**
+   * True if more than |threshold| readings wait for the live session and
+   * none are in flight. While requests are in flight, a handoff would leave
+   * them behind the drainer's range, and replaying them after a failure
+   * would upload the whole range a second time.
+   */
+  bool CanHandOffBacklog(size_t threshold) const;
+
+  /**
+   * Records that [GetNextSeq(), tail) was given to the drainer. The live
+   * cursor moves to the tail.
+   */
+  void HandOffBacklog();
+
+  /**
+   * Marks |seq| as uploaded and releases the spool head as far as the
+   * completed readings reach. Completions for readings already released are
+   * ignored. Returns false if |seq| had already completed.
+   */
+  bool Complete(uint64_t seq);
+
+  size_t GetPendingCompletionCount() const;
+
+private:
+  MeasurementSpool *spool_;
+  uint64_t next_post_seq_;
+  std::deque<uint64_t> in_flight_seqs_;
+  // Completed readings waiting for older ones before the spool can release
+  // them.
+  std::set<uint64_t> completed_seqs_;
+};
+
+} // namespace organicdump
+
+#endif // ORGANICDUMP_CLIENT_UPLOADTRACKER_H
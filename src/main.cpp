@@ -1,7 +1,12 @@
+#include <sysexits.h>
+
 #include <cassert>
 #include <cstdlib>
+#include <fstream>
 #include <iostream>
 #include <memory>
+#include <streambuf>
+#include <string>
 #include <utility>
 
 #include  <openssl/bio.h>
@@ -10,9 +15,14 @@
 
 #include <gflags/gflags.h>
 #include <glog/logging.h>
+#include <json/json.h>
 
 #include "Client.h"
+#include "ClientError.h"
 #include "CliConfig.h"
+#include "FileUtilities.h"
+#include "Provisioner.h"
+#include "ProvisioningManifest.h"
 
 #include "organic_dump.pb.h"
 
@@ -24,7 +34,12 @@
 namespace
 {
 using organicdump::Client;
+using organicdump::ClientError;
 using organicdump::CliConfig;
+using organicdump::Provisioner;
+using organicdump::ProvisioningManifest;
+using organicdump::SensorRegistration;
+using organicdump::WriteFileAtomically;
 
 using I2c::I2cException;
 using I2c::I2cClient;
@@ -41,11 +56,35 @@ void InitLibraries(const char *app_name)
   ERR_load_BIO_strings();
 }
 
+// Lets scripts tell a request worth retrying from one that never will
+// succeed.
+int GetExitCode(ClientError error)
+{
+  switch (error)
+  {
+    case ClientError::CONNECTION_CLOSED:
+    case ClientError::NETWORK:
+    case ClientError::SERVER:
+      return EX_TEMPFAIL;
+    case ClientError::PROTOCOL:
+      return EX_PROTOCOL;
+    case ClientError::REJECTED:
+      return EX_DATAERR;
+    case ClientError::NONE:
+    default:
+      return EXIT_FAILURE;
+  }
+}
+
 bool PerformServerAction(
     const CliConfig &config,
-    Client *client)
+    Client *client,
+    ClientError *out_error)
 {
   assert(client);
+  assert(out_error);
+
+  *out_error = ClientError::NONE;
 
   LOG(ERROR) << "Performing server action: "
              << organicdump_proto::MessageType_Name(config.GetServerAction());
@@ -60,7 +99,8 @@ bool PerformServerAction(
       return client->SendRegisterRpi(
           config.GetName(),
           config.GetLocation(),
-          &id);
+          &id,
+          out_error);
 
     case organicdump_proto::MessageType::REGISTER_SOIL_MOISTURE_SENSOR:
       assert(config.HasName());
@@ -73,7 +113,8 @@ bool PerformServerAction(
           config.GetLocation(),
           config.GetFloor(),
           config.GetCeiling(),
-          &id);
+          &id,
+          out_error);
 
     case organicdump_proto::MessageType::UPDATE_PERIPHERAL_OWNERSHIP:
       assert(config.HasId());
@@ -81,7 +122,8 @@ bool PerformServerAction(
 
       return client->SetPeripheralParent(
           config.GetId(),
-          config.GetParentId());
+          config.GetParentId(),
+          out_error);
 
     case organicdump_proto::MessageType::SEND_SOIL_MOISTURE_MEASUREMENT:
       assert(config.HasId());
@@ -89,7 +131,8 @@ bool PerformServerAction(
 
       return client->SendSoilMoistureMeasurement(
           config.GetId(),
-          config.GetMeasurement());
+          config.GetMeasurement(),
+          out_error);
 
     // TODO(bozkurtus): add more server action handlers
     default:
@@ -98,6 +141,113 @@ bool PerformServerAction(
   }
 }
 
+bool ReadManifest(
+    const std::string &manifest_path,
+    ProvisioningManifest *out_manifest)
+{
+  assert(out_manifest);
+
+  std::ifstream json_file{manifest_path};
+  if (!json_file.is_open())
+  {
+    LOG(ERROR) << "Failed to open manifest " << manifest_path;
+    return false;
+  }
+
+  std::string json_file_str(
+      (std::istreambuf_iterator<char>(json_file)),
+      std::istreambuf_iterator<char>());
+
+  Json::Value root;
+  Json::Reader reader;
+  if (!reader.parse(json_file_str, root))
+  {
+    LOG(ERROR) << "Failed to parse manifest " << manifest_path;
+    return false;
+  }
+
+  return ProvisioningManifest::Parse(std::move(root), out_manifest);
+}
+
+bool HasRegisteredAnything(const ProvisioningManifest &manifest)
+{
+  if (manifest.HasRpiId())
+  {
+    return true;
+  }
+
+  for (const SensorRegistration &sensor : manifest.GetSensors())
+  {
+    if (sensor.is_registered)
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Writes the ids assigned so far back into the manifest, so that running the
+// same command again picks up where this run stopped instead of registering
+// everything a second time.
+void SaveProgress(
+    const std::string &manifest_path,
+    const ProvisioningManifest &manifest)
+{
+  if (!HasRegisteredAnything(manifest))
+  {
+    return;
+  }
+
+  Json::Value root;
+  manifest.BuildManifest(&root);
+  if (!WriteFileAtomically(manifest_path, Json::StyledWriter{}.write(root), 0644))
+  {
+    LOG(ERROR) << "Failed to save provisioning progress to " << manifest_path;
+    return;
+  }
+
+  LOG(ERROR) << "Saved the ids assigned so far to " << manifest_path
+             << "; re-run with the same manifest to resume";
+}
+
+bool ProvisionRig(const CliConfig &config, Client *client)
+{
+  assert(client);
+
+  ProvisioningManifest manifest;
+  if (!ReadManifest(config.GetManifestFile(), &manifest))
+  {
+    return false;
+  }
+
+  LOG(INFO) << "Provisioning Pi " << manifest.GetRpiName() << " with "
+            << manifest.GetSensors().size() << " sensors";
+
+  client->SetPipelineWindow(config.GetPipelineWindow());
+  Provisioner provisioner{client};
+  if (!provisioner.Provision(&manifest))
+  {
+    SaveProgress(config.GetManifestFile(), manifest);
+    return false;
+  }
+
+  Json::Value monitor_config;
+  if (!manifest.BuildMonitorConfig(&monitor_config) ||
+      !WriteFileAtomically(
+          config.GetConfigFile(),
+          Json::StyledWriter{}.write(monitor_config),
+          0644))
+  {
+    LOG(ERROR) << "Registered Pi " << manifest.GetRpiId() << " but failed to "
+               << "write its monitor config";
+    SaveProgress(config.GetManifestFile(), manifest);
+    return false;
+  }
+
+  LOG(INFO) << "Wrote monitor config to " << config.GetConfigFile();
+  return true;
+}
+
 } // anonymous namespace
 
 int main(int argc, char **argv)
@@ -116,22 +266,35 @@ int main(int argc, char **argv)
   InitLibraries(argv[0]);
 
   Client client;
+  ClientError error;
   if (!Client::Create(
           config.GetIpv4(),
           config.GetPort(),
           config.GetCertFile(),
           config.GetKeyFile(),
           config.GetCaFile(),
-          &client))
+          &client,
+          &error))
   {
     LOG(ERROR) << "Failed to create client";
-    return EXIT_FAILURE;
+    return GetExitCode(error);
+  }
+
+  if (config.ShouldProvision())
+  {
+    if (!ProvisionRig(config, &client))
+    {
+      LOG(ERROR) << "Failed to provision rig";
+      return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
   }
 
-  if (!PerformServerAction(config, &client))
+  if (!PerformServerAction(config, &client, &error))
   {
-    LOG(ERROR) << "Failed to perform server action";
-    return EXIT_FAILURE;
+    LOG(ERROR) << "Failed to perform server action: "
+               << GetClientErrorName(error);
+    return GetExitCode(error);
   }
 
 
@@ -17,27 +17,34 @@
 
 #include "Client.h"
 #include "CliConfig.h"
+#include "ControlSocket.h"
+#include "HardwareBackend.h"
+#include "MeasurementSpool.h"
+#include "RpiHardwareBackend.h"
+#include "SensorTopology.h"
+#include "SimulatedHardwareBackend.h"
 #include "SoilMoistureMonitoringClient.h"
+#include "TlsContext.h"
+#include "TlsSessionCache.h"
 
 #include "organic_dump.pb.h"
 
-#include "I2c/Devices/Ads1115AnalogToDigitalConverter/Ads1115.h"
-#include "I2c/Devices/Ads1115AnalogToDigitalConverter/Ads1115Channel.h"
-#include "I2c/I2cException.h"
-#include "I2c/I2cClient.h"
-#include "I2c/RpiI2cContext.h"
-#include "System/RpiSystemContext.h"
-
 namespace
 {
-using I2c::Ads1115Channel;
 using organicdump::Client;
 using organicdump::CliConfig;
+using organicdump::ControlSocket;
+using organicdump::HardwareBackend;
+using organicdump::MeasurementSpool;
+using organicdump::RpiHardwareBackend;
+using organicdump::SensorChannel;
+using organicdump::SensorTopology;
+using organicdump::SimulatedHardwareBackend;
 using organicdump::SoilMoistureMonitoringClient;
+using organicdump::TlsContext;
+using organicdump::TlsSessionCache;
 
-constexpr size_t SOIL_MOISTURE_SENSOR_COUNT = 3;
 constexpr const char *RPI_ID_JSON_NAME = "rpi-id";
-constexpr const char *SOIL_MOISTURE_SENSOR_IDS = "soil-moisture-sensor-ids";
 
 void InitLibraries(const char *app_name)
 {
@@ -48,11 +55,12 @@ void InitLibraries(const char *app_name)
   ERR_load_BIO_strings();
 }
 
-bool ParseSoilMoistureSensorIds(
+bool ParseMonitorConfig(
     const std::string &config_path,
-    size_t *raspberry_pi_id,
-    std::vector<size_t> *out_soil_moisture_ids) {
-  assert(out_soil_moisture_ids);
+    size_t *out_raspberry_pi_id,
+    SensorTopology *out_topology) {
+  assert(out_raspberry_pi_id);
+  assert(out_topology);
 
   std::ifstream json_file{config_path};
   if (!json_file.is_open()) {
@@ -66,18 +74,13 @@ bool ParseSoilMoistureSensorIds(
 
   Json::Value root;
   Json::Reader reader;
-  reader.parse(json_file_str, root);
-
-  *raspberry_pi_id = root[RPI_ID_JSON_NAME].asUInt64();
-  Json::Value json_soil_moisture_sensor_ids = root[SOIL_MOISTURE_SENSOR_IDS];
-  out_soil_moisture_ids->clear();
-  for (size_t i = 0; i < json_soil_moisture_sensor_ids.size(); i++)
-  {
-    out_soil_moisture_ids->push_back(
-        json_soil_moisture_sensor_ids[static_cast<int>(i)].asUInt64());
+  if (!reader.parse(json_file_str, root)) {
+    LOG(ERROR) << "Failed to parse json config file";
+    return false;
   }
 
-  return true;
+  *out_raspberry_pi_id = root[RPI_ID_JSON_NAME].asUInt64();
+  return SensorTopology::Parse(root, out_topology);
 }
 
 } // anonymous namespace
@@ -96,40 +99,100 @@ int main(int argc, char **argv)
   assert(config.HasConfigFile());
 
   size_t raspberry_pi_id;
-  std::vector<size_t> soil_moisture_ids;
-
-  if (!ParseSoilMoistureSensorIds(
+  SensorTopology topology;
+  if (!ParseMonitorConfig(
         config.GetConfigFile(),
         &raspberry_pi_id,
-        &soil_moisture_ids))
+        &topology))
   {
-    LOG(ERROR) << "Failed to parse soil moisture sensor ids";
-    return false;
+    LOG(ERROR) << "Failed to parse sensor topology";
+    return EXIT_FAILURE;
   }
 
-  LOG(ERROR) << "Raspberry Pi Id: " << raspberry_pi_id;
-  for (size_t i = 0; i < soil_moisture_ids.size(); ++i)
+  LOG(INFO) << "Raspberry Pi Id: " << raspberry_pi_id;
+  for (const SensorChannel &channel : topology.GetChannels())
   {
-    LOG(ERROR) << "Soil moisture sensor[" << i << "]: " << soil_moisture_ids.at(i);
+    LOG(INFO) << "Soil moisture sensor " << channel.sensor_id << ": bus "
+              << channel.bus << ", address 0x" << std::hex
+              << static_cast<int>(channel.address) << std::dec
+              << ", channel " << static_cast<int>(channel.channel);
   }
 
-  assert(soil_moisture_ids.size() == SOIL_MOISTURE_SENSOR_COUNT);
-  std::unordered_map<Ads1115Channel, size_t> channel_to_sensor_table =
+  // A simulation only talks to the server when asked to, so that made-up
+  // readings can't end up among real ones, now or from the spool later.
+  bool upload = config.GetConnectionPolicy().upload;
+  if (!upload)
   {
-    {Ads1115Channel::CHANNEL_0, soil_moisture_ids.at(0)},
-    {Ads1115Channel::CHANNEL_1, soil_moisture_ids.at(1)},
-    {Ads1115Channel::CHANNEL_2, soil_moisture_ids.at(2)},
-  };
+    LOG(INFO) << "Simulated readings won't be uploaded or spooled to disk. "
+              << "Pass --sim_upload to send them to "
+              << config.GetIpv4() << ":" << config.GetPort();
+  }
+
+  TlsContext tls_context;
+  if (upload &&
+      !TlsContext::Create(
+        config.GetIpv4(),
+        config.GetPort(),
+        config.GetCertFile(),
+        config.GetKeyFile(),
+        config.GetCaFile(),
+        &tls_context))
+  {
+    LOG(ERROR) << "Failed to load TLS credentials";
+    return EXIT_FAILURE;
+  }
+
+  MeasurementSpool spool;
+  if (!MeasurementSpool::Open(
+        upload ? config.GetSpoolFile() : "",
+        config.GetSpoolCapacity(),
+        &spool))
+  {
+    LOG(ERROR) << "Failed to open measurement spool";
+    return EXIT_FAILURE;
+  }
+
+  ControlSocket control_socket;
+  if (!config.GetControlSocket().empty() &&
+      !ControlSocket::Open(config.GetControlSocket(), &control_socket))
+  {
+    LOG(ERROR) << "Failed to open control socket";
+    return EXIT_FAILURE;
+  }
+
+  std::unique_ptr<HardwareBackend> hardware_backend;
+  if (config.ShouldSimulateHardware())
+  {
+    LOG(INFO) << "Sampling simulated sensors";
+    hardware_backend.reset(
+        new SimulatedHardwareBackend{config.GetSimulationProfile(), topology});
+  }
+  else
+  {
+    hardware_backend.reset(
+        new RpiHardwareBackend{
+            config.GetFaultPolicy().i2c_timeout,
+            config.GetAdcPolicy()});
+  }
 
   SoilMoistureMonitoringClient client{
-      config.GetIpv4(),
-      config.GetPort(),
-      config.GetCertFile(),
-      config.GetKeyFile(),
-      config.GetCaFile(),
-      config.GetRetryConnectServerPeriod(),
+      std::move(tls_context),
+      config.GetReconnectPolicy(),
       config.GetMeasurementPeriod(),
-      std::move(channel_to_sensor_table)};
+      config.GetPipelineWindow(),
+      config.GetConnectionPolicy(),
+      config.GetDrainPolicy(),
+      config.GetSamplingPolicy(),
+      config.GetOversamplingPolicy(),
+      config.GetDeadbandPolicy(),
+      config.GetFaultPolicy(),
+      config.GetBusRecoveryPolicy(),
+      config.GetAdcPolicy(),
+      TlsSessionCache{config.GetTlsSessionCacheFile()},
+      std::move(control_socket),
+      std::move(spool),
+      std::move(topology),
+      std::move(hardware_backend)};
 
   if (!client.Run())
   {
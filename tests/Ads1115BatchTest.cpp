@@ -0,0 +1,214 @@
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "I2c/Devices/Ads1115AnalogToDigitalConverter/Ads1115Channel.h"
+
+#include "Ads1115Batch.h"
+#include "Ads1115Policy.h"
+#include "Ads1115Registers.h"
+#include "SimulatedI2cBus.h"
+
+namespace organicdump
+{
+namespace
+{
+
+using I2c::Ads1115Channel;
+
+constexpr uint8_t FIRST_ADDRESS = 0x48;
+constexpr size_t DEVICE_COUNT = 3;
+const Ads1115Policy POLICY{
+    ads1115::DEFAULT_FULL_SCALE_MV,
+    ads1115::DEFAULT_DATA_RATE_SPS};
+
+const Ads1115Channel CHANNELS[] = {
+  Ads1115Channel::CHANNEL_0,
+  Ads1115Channel::CHANNEL_1,
+  Ads1115Channel::CHANNEL_2,
+  Ads1115Channel::CHANNEL_3,
+};
+
+// Every input reads a value that names its device and channel, so a result
+// filed under the wrong conversion shows up.
+uint16_t GetExpectedValue(uint8_t address, size_t channel)
+{
+  return static_cast<uint16_t>(1000 * (address - FIRST_ADDRESS + 1) + channel);
+}
+
+class Ads1115BatchTest : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    for (size_t device = 0; device < DEVICE_COUNT; ++device)
+    {
+      uint8_t address = static_cast<uint8_t>(FIRST_ADDRESS + device);
+      bus_.AddAds1115(address);
+      for (size_t channel = 0; channel < 4; ++channel)
+      {
+        bus_.SetChannelValue(
+            address,
+            CHANNELS[channel],
+            GetExpectedValue(address, channel));
+      }
+    }
+  }
+
+  // One conversion of every channel of every device, in the order the
+  // sampler queues them.
+  std::vector<Ads1115Conversion> MakeSweep() const
+  {
+    std::vector<Ads1115Conversion> conversions;
+    for (size_t device = 0; device < DEVICE_COUNT; ++device)
+    {
+      for (Ads1115Channel channel : CHANNELS)
+      {
+        conversions.push_back(
+            Ads1115Conversion{
+                static_cast<uint8_t>(FIRST_ADDRESS + device),
+                channel,
+                0,
+                false});
+      }
+    }
+    return conversions;
+  }
+
+  static size_t GetChannelIndex(Ads1115Channel channel)
+  {
+    for (size_t i = 0; i < 4; ++i)
+    {
+      if (CHANNELS[i] == channel)
+      {
+        return i;
+      }
+    }
+    return 4;
+  }
+
+  SimulatedI2cBus bus_;
+};
+
+TEST_F(Ads1115BatchTest, SweepReadsEveryChannelInRoundsPlusOneTransactions)
+{
+  Ads1115Batch batch{&bus_, std::chrono::microseconds{0}, POLICY};
+  std::vector<Ads1115Conversion> conversions = MakeSweep();
+
+  ASSERT_TRUE(batch.Convert(&conversions));
+  for (const Ads1115Conversion &conversion : conversions)
+  {
+    EXPECT_TRUE(conversion.is_valid);
+    EXPECT_EQ(
+        GetExpectedValue(
+            conversion.address,
+            GetChannelIndex(conversion.channel)),
+        conversion.value);
+  }
+
+  // Four rounds of one conversion per device.
+  EXPECT_EQ(5u, bus_.GetTransferCount());
+  EXPECT_EQ(conversions.size(), bus_.GetConversionCount());
+}
+
+TEST_F(Ads1115BatchTest, FailedDeviceFallsBackAndIsIsolated)
+{
+  bus_.SetDeviceFailed(FIRST_ADDRESS + 1, true);
+  Ads1115Batch batch{&bus_, std::chrono::microseconds{0}, POLICY};
+  std::vector<Ads1115Conversion> conversions = MakeSweep();
+
+  EXPECT_FALSE(batch.Convert(&conversions));
+  for (const Ads1115Conversion &conversion : conversions)
+  {
+    if (conversion.address == FIRST_ADDRESS + 1)
+    {
+      EXPECT_FALSE(conversion.is_valid);
+      continue;
+    }
+
+    EXPECT_TRUE(conversion.is_valid);
+    EXPECT_EQ(
+        GetExpectedValue(
+            conversion.address,
+            GetChannelIndex(conversion.channel)),
+        conversion.value);
+  }
+
+  // The first round's combined write fails and is redone per device. From
+  // then on the failed device gets its own write each round and the others
+  // stay batched: 1 + 3, then 2 for each of the three later rounds, then the
+  // final read.
+  EXPECT_EQ(11u, bus_.GetTransferCount());
+}
+
+TEST_F(Ads1115BatchTest, NackedTransactionsNeverMislabelResults)
+{
+  // Instant conversions mean a config write that ran before a NACK has
+  // already replaced the result the fallback would read.
+  bus_.SetNackProbability(0.05, 7);
+  Ads1115Batch batch{&bus_, std::chrono::microseconds{0}, POLICY};
+
+  size_t valid_count = 0;
+  size_t invalid_count = 0;
+  for (size_t sweep = 0; sweep < 200; ++sweep)
+  {
+    std::vector<Ads1115Conversion> conversions = MakeSweep();
+    batch.Convert(&conversions);
+    for (const Ads1115Conversion &conversion : conversions)
+    {
+      if (!conversion.is_valid)
+      {
+        ++invalid_count;
+        continue;
+      }
+
+      ++valid_count;
+      ASSERT_EQ(
+          GetExpectedValue(
+              conversion.address,
+              GetChannelIndex(conversion.channel)),
+          conversion.value);
+    }
+  }
+
+  EXPECT_GT(bus_.GetNackCount(), 0u);
+  EXPECT_GT(invalid_count, 0u);
+  EXPECT_GT(valid_count, invalid_count);
+}
+
+TEST_F(Ads1115BatchTest, ConversionsUseThePolicyGainAndRate)
+{
+  Ads1115Batch batch{
+      &bus_,
+      std::chrono::microseconds{0},
+      Ads1115Policy{4096, 860}};
+  std::vector<Ads1115Conversion> conversions = MakeSweep();
+  ASSERT_TRUE(batch.Convert(&conversions));
+
+  uint8_t pointer = ads1115::CONFIG_REGISTER;
+  uint8_t config_bytes[2] = {};
+  I2cMessage read_config[] = {
+      I2cMessage{FIRST_ADDRESS, false, &pointer, 1},
+      I2cMessage{FIRST_ADDRESS, true, config_bytes, 2}};
+  ASSERT_TRUE(bus_.Transfer(read_config, 2));
+
+  uint16_t config = static_cast<uint16_t>((config_bytes[0] << 8) | config_bytes[1]);
+  EXPECT_EQ(0x1, (config >> ads1115::CONFIG_PGA_SHIFT) & 0x7);
+  EXPECT_EQ(0x7, (config >> ads1115::CONFIG_DR_SHIFT) & 0x7);
+}
+
+TEST(Ads1115RegistersTest, ConversionTimeAllowsForRateError)
+{
+  EXPECT_EQ(std::chrono::microseconds{8594}, ads1115::GetConversionTime(128));
+  EXPECT_EQ(std::chrono::microseconds{1280}, ads1115::GetConversionTime(860));
+  EXPECT_TRUE(ads1115::IsValidFullScale(2048));
+  EXPECT_FALSE(ads1115::IsValidFullScale(3300));
+  EXPECT_TRUE(ads1115::IsValidDataRate(475));
+  EXPECT_FALSE(ads1115::IsValidDataRate(100));
+}
+
+} // namespace
+} // namespace organicdump
@@ -0,0 +1,77 @@
+#include "AllocationCounter.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+std::atomic<bool> is_counting{false};
+std::atomic<size_t> allocation_count{0};
+
+void *Allocate(size_t size)
+{
+  if (is_counting.load(std::memory_order_relaxed))
+  {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  void *ptr = std::malloc(size == 0 ? 1 : size);
+  if (!ptr)
+  {
+    throw std::bad_alloc{};
+  }
+  return ptr;
+}
+} // namespace
+
+void *operator new(size_t size)
+{
+  return Allocate(size);
+}
+
+void *operator new[](size_t size)
+{
+  return Allocate(size);
+}
+
+void operator delete(void *ptr) noexcept
+{
+  std::free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept
+{
+  std::free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept
+{
+  std::free(ptr);
+}
+
+void operator delete[](void *ptr, size_t) noexcept
+{
+  std::free(ptr);
+}
+
+namespace organicdump
+{
+
+AllocationCounter::AllocationCounter()
+  : start_count_{allocation_count.load()}
+{
+  is_counting.store(true);
+}
+
+AllocationCounter::~AllocationCounter()
+{
+  is_counting.store(false);
+}
+
+size_t AllocationCounter::GetCount() const
+{
+  return allocation_count.load() - start_count_;
+}
+
+} // namespace organicdump
@@ -0,0 +1,31 @@
+#ifndef ORGANICDUMP_CLIENT_TESTS_ALLOCATIONCOUNTER_H
+#define ORGANICDUMP_CLIENT_TESTS_ALLOCATIONCOUNTER_H
+
+#include <cstddef>
+
+namespace organicdump
+{
+
+/**
+ * Counts calls to the global operator new made on any thread while it is in
+ * scope. The test binary replaces operator new to feed it.
+ */
+class AllocationCounter
+{
+public:
+  AllocationCounter();
+  ~AllocationCounter();
+
+  size_t GetCount() const;
+
+private:
+  AllocationCounter(const AllocationCounter &other) = delete;
+  AllocationCounter &operator=(const AllocationCounter &other) = delete;
+
+private:
+  size_t start_count_;
+};
+
+} // namespace organicdump
+
+#endif // ORGANICDUMP_CLIENT_TESTS_ALLOCATIONCOUNTER_H
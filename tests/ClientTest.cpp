@@ -0,0 +1,248 @@
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "organic_dump.pb.h"
+
+#include "AllocationCounter.h"
+#include "ByteStream.h"
+#include "Client.h"
+#include "ClientError.h"
+#include "FakeServerStream.h"
+#include "ProtobufServer.h"
+#include "SoilMoistureMeasurement.h"
+
+namespace organicdump
+{
+namespace
+{
+
+using organicdump_proto::ErrorCode;
+using organicdump_proto::MessageType;
+
+constexpr size_t PIPELINE_WINDOW = 8;
+
+class ClientTest : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    server_ = new FakeServerStream;
+    client_ = Client{ProtobufServer{std::unique_ptr<ByteStream>{server_}}};
+    client_.SetPipelineWindow(PIPELINE_WINDOW);
+  }
+
+  // One pass of the monitoring daemon's upload loop: fill the pipeline,
+  // flush once, then consume every response that arrived.
+  void RunUploadCycle(size_t *out_completed_count)
+  {
+    SoilMoistureMeasurement measurement{};
+    measurement.sensor_id = 7;
+    while (client_.CanPostRequest())
+    {
+      measurement.value += 1.0;
+      ASSERT_TRUE(client_.PostSoilMoistureMeasurement(measurement));
+    }
+    ASSERT_TRUE(client_.Flush());
+
+    while (client_.GetPendingRequestCount() > 0)
+    {
+      size_t id = 0;
+      bool completed = false;
+      ClientError error;
+      ASSERT_TRUE(client_.TryCompleteRequest(&id, &completed, &error));
+      ASSERT_TRUE(completed);
+      ASSERT_EQ(error, ClientError::NONE);
+      ++*out_completed_count;
+    }
+  }
+
+  FakeServerStream *server_;
+  Client client_;
+};
+
+TEST(ClientCreateTest, WritesHelloBeforeReturning)
+{
+  FakeServerStream *server = new FakeServerStream;
+  Client client;
+  ClientError error;
+  ASSERT_TRUE(Client::Create(
+      std::unique_ptr<ByteStream>{server},
+      nullptr,
+      &client,
+      &error));
+
+  EXPECT_EQ(error, ClientError::NONE);
+  EXPECT_EQ(server->GetFrameCount(MessageType::HELLO), 1u);
+  EXPECT_EQ(client.GetWriteCallCount(), 1u);
+}
+
+TEST(ClientCreateTest, FailsIfServerHangsUpBeforeHello)
+{
+  FakeServerStream *server = new FakeServerStream;
+  server->Close();
+
+  Client client;
+  ClientError error;
+  EXPECT_FALSE(Client::Create(
+      std::unique_ptr<ByteStream>{server},
+      nullptr,
+      &client,
+      &error));
+  EXPECT_EQ(error, ClientError::CONNECTION_CLOSED);
+  EXPECT_FALSE(client.IsConnected());
+}
+
+TEST_F(ClientTest, PipelinedResponsesMatchRequestsInOrder)
+{
+  std::vector<SoilMoistureMeasurement> measurements(20);
+  for (size_t i = 0; i < measurements.size(); ++i)
+  {
+    measurements[i].sensor_id = i;
+    measurements[i].value = static_cast<double>(i);
+  }
+
+  std::vector<size_t> ids;
+  ASSERT_TRUE(client_.SendSoilMoistureMeasurements(measurements, &ids));
+
+  ASSERT_EQ(ids.size(), measurements.size());
+  for (size_t i = 0; i < ids.size(); ++i)
+  {
+    EXPECT_EQ(ids[i], i + 1);
+  }
+  EXPECT_EQ(
+      server_->GetFrameCount(MessageType::SEND_SOIL_MOISTURE_MEASUREMENT),
+      measurements.size());
+}
+
+TEST_F(ClientTest, FlushWritesQueuedRequestsInOneCall)
+{
+  SoilMoistureMeasurement measurement{};
+  for (size_t i = 0; i < PIPELINE_WINDOW; ++i)
+  {
+    ASSERT_TRUE(client_.PostSoilMoistureMeasurement(measurement));
+  }
+  ASSERT_TRUE(client_.Flush());
+
+  // The count comes from the stream, so it is transport writes, not
+  // Flush() calls.
+  EXPECT_EQ(client_.GetWrittenFrameCount(), PIPELINE_WINDOW);
+  EXPECT_EQ(client_.GetWriteCallCount(), 1u);
+  EXPECT_EQ(server_->GetWriteCallCount(), 1u);
+
+  ASSERT_TRUE(client_.Flush());
+  EXPECT_EQ(client_.GetWriteCallCount(), 1u);
+}
+
+TEST_F(ClientTest, ShortWriteIsFinishedByLaterFlushes)
+{
+  server_->SetWriteLimit(5);
+
+  SoilMoistureMeasurement measurement{};
+  for (size_t i = 0; i < PIPELINE_WINDOW; ++i)
+  {
+    ASSERT_TRUE(client_.PostSoilMoistureMeasurement(measurement));
+  }
+  ASSERT_TRUE(client_.Flush());
+  EXPECT_TRUE(client_.WantsWrite());
+  EXPECT_EQ(client_.GetWrittenFrameCount(), 0u);
+
+  size_t flush_count = 1;
+  while (client_.WantsWrite())
+  {
+    ASSERT_TRUE(client_.Flush());
+    ++flush_count;
+  }
+  EXPECT_GT(flush_count, 2u);
+  EXPECT_EQ(client_.GetWrittenFrameCount(), PIPELINE_WINDOW);
+  EXPECT_EQ(
+      server_->GetFrameCount(MessageType::SEND_SOIL_MOISTURE_MEASUREMENT),
+      PIPELINE_WINDOW);
+
+  for (size_t i = 0; i < PIPELINE_WINDOW; ++i)
+  {
+    size_t id = 0;
+    ASSERT_TRUE(client_.CompleteRequest(&id));
+    EXPECT_EQ(id, i + 1);
+  }
+}
+
+TEST_F(ClientTest, RejectedRequestCompletesWithoutId)
+{
+  server_->SetResponseCode(ErrorCode::INVALID_ARGUMENT);
+
+  SoilMoistureMeasurement measurement{};
+  ASSERT_TRUE(client_.PostSoilMoistureMeasurement(measurement));
+
+  size_t id = 0;
+  bool completed = false;
+  ClientError error;
+  ASSERT_TRUE(client_.TryCompleteRequest(&id, &completed, &error));
+  EXPECT_TRUE(completed);
+  EXPECT_EQ(error, ClientError::REJECTED);
+  EXPECT_EQ(client_.GetPendingRequestCount(), 0u);
+}
+
+TEST_F(ClientTest, ServerErrorFailsRequest)
+{
+  server_->SetResponseCode(ErrorCode::SERVER_ERROR);
+
+  SoilMoistureMeasurement measurement{};
+  ASSERT_TRUE(client_.PostSoilMoistureMeasurement(measurement));
+
+  size_t id = 0;
+  bool completed = false;
+  ClientError error;
+  EXPECT_FALSE(client_.TryCompleteRequest(&id, &completed, &error));
+  EXPECT_EQ(error, ClientError::SERVER);
+}
+
+TEST_F(ClientTest, BlockingCallsReportWhyTheyFailed)
+{
+  size_t id = 0;
+  ClientError error;
+  ASSERT_TRUE(client_.SendRegisterRpi("pi", "shed", &id, &error));
+  EXPECT_EQ(error, ClientError::NONE);
+
+  server_->SetResponseCode(ErrorCode::INVALID_ARGUMENT);
+  EXPECT_FALSE(
+      client_.SendRegisterSoilMoistureSensor("probe", "bed", 0, 1, &id, &error));
+  EXPECT_EQ(error, ClientError::REJECTED);
+
+  server_->SetResponseCode(ErrorCode::SERVER_ERROR);
+  EXPECT_FALSE(client_.SetPeripheralParent(2, 1, &error));
+  EXPECT_EQ(error, ClientError::SERVER);
+
+  server_->Close();
+  EXPECT_FALSE(client_.SendSoilMoistureMeasurement(2, 0.5, &error));
+  EXPECT_EQ(error, ClientError::CONNECTION_CLOSED);
+}
+
+TEST_F(ClientTest, WarmUploadLoopDoesNotAllocate)
+{
+  // Let the send buffer, receive buffer and reused messages reach their
+  // working sizes.
+  size_t completed_count = 0;
+  for (int i = 0; i < 10; ++i)
+  {
+    RunUploadCycle(&completed_count);
+  }
+
+  size_t allocation_count;
+  {
+    AllocationCounter counter;
+    for (int i = 0; i < 1000; ++i)
+    {
+      RunUploadCycle(&completed_count);
+    }
+    allocation_count = counter.GetCount();
+  }
+
+  EXPECT_EQ(allocation_count, 0u);
+  EXPECT_EQ(completed_count, 1010 * PIPELINE_WINDOW);
+}
+
+} // namespace
+} // namespace organicdump
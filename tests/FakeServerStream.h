@@ -0,0 +1,326 @@
+#ifndef ORGANICDUMP_CLIENT_TESTS_FAKESERVERSTREAM_H
+#define ORGANICDUMP_CLIENT_TESTS_FAKESERVERSTREAM_H
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "organic_dump.pb.h"
+
+#include "ByteStream.h"
+#include "ProtobufFrame.h"
+
+namespace organicdump
+{
+
+/**
+ * A registration or ownership request as the server saw it, with the id it
+ * was answered with (0 if it was failed).
+ */
+struct FakeServerRequest
+{
+  organicdump_proto::MessageType type;
+  std::string name;
+  uint64_t peripheral_id;
+  uint64_t rpi_id;
+  uint64_t assigned_id;
+};
+
+/**
+ * In-memory server end of a session. Every request frame written to it is
+ * answered, in order, with a BASIC_RESPONSE carrying the next id. Buffers are
+ * sized up front so that the fake itself doesn't allocate once running;
+ * only registration and ownership requests are decoded and recorded.
+ */
+class FakeServerStream : public ByteStream
+{
+public:
+  static constexpr size_t BUFFER_SIZE = 1 << 16;
+
+public:
+  FakeServerStream()
+    : request_buffer_(BUFFER_SIZE),
+      request_size_{0},
+      write_limit_{0},
+      wants_write_{false},
+      response_buffer_(BUFFER_SIZE),
+      response_read_offset_{0},
+      response_size_{0},
+      next_id_{1},
+      response_code_{organicdump_proto::ErrorCode::OK},
+      request_count_{0},
+      fail_from_request_{0},
+      fail_code_{organicdump_proto::ErrorCode::OK},
+      is_closed_{false},
+      write_call_count_{0},
+      frame_counts_{} {}
+
+  bool Read(
+      uint8_t *buffer,
+      size_t size,
+      size_t *out_bytes_read,
+      bool *out_cxn_closed) override
+  {
+    *out_bytes_read = 0;
+    *out_cxn_closed = false;
+    if (is_closed_ || response_read_offset_ == response_size_)
+    {
+      // Waiting for a response that isn't coming would hang forever.
+      *out_cxn_closed = true;
+      return false;
+    }
+
+    size_t count = std::min(size, response_size_ - response_read_offset_);
+    std::memcpy(buffer, response_buffer_.data() + response_read_offset_, count);
+    response_read_offset_ += count;
+    if (response_read_offset_ == response_size_)
+    {
+      response_read_offset_ = 0;
+      response_size_ = 0;
+    }
+
+    *out_bytes_read = count;
+    return true;
+  }
+
+  bool Write(
+      const uint8_t *data,
+      size_t size,
+      size_t *out_bytes_written,
+      bool *out_cxn_closed) override
+  {
+    *out_bytes_written = 0;
+    *out_cxn_closed = false;
+    ++write_call_count_;
+    if (is_closed_)
+    {
+      *out_cxn_closed = true;
+      return false;
+    }
+
+    // A short write leaves the tail of a frame behind until the next one.
+    size_t count = size;
+    if (write_limit_ > 0 && count > write_limit_)
+    {
+      count = write_limit_;
+    }
+    wants_write_ = count < size;
+    std::memcpy(request_buffer_.data() + request_size_, data, count);
+    request_size_ += count;
+    *out_bytes_written = count;
+
+    size_t offset = 0;
+    while (request_size_ - offset >= FRAME_HEADER_SIZE)
+    {
+      FrameHeader header;
+      DecodeFrameHeader(request_buffer_.data() + offset, &header);
+      if (request_size_ - offset < FRAME_HEADER_SIZE + header.size)
+      {
+        break;
+      }
+
+      const uint8_t *body = request_buffer_.data() + offset + FRAME_HEADER_SIZE;
+      offset += FRAME_HEADER_SIZE + header.size;
+      ++frame_counts_[header.type];
+
+      if (header.type != organicdump_proto::MessageType::HELLO)
+      {
+        uint64_t id = QueueResponse();
+        RecordRequest(header, body, id);
+      }
+    }
+
+    std::memmove(
+        request_buffer_.data(),
+        request_buffer_.data() + offset,
+        request_size_ - offset);
+    request_size_ -= offset;
+    return true;
+  }
+
+  bool WantsWrite() const override
+  {
+    return wants_write_;
+  }
+
+  bool HasPendingData() const override
+  {
+    return false;
+  }
+
+  int GetFd() const override
+  {
+    return -1;
+  }
+
+  SSL *GetSsl() const override
+  {
+    return nullptr;
+  }
+
+  size_t GetWriteCallCount() const override
+  {
+    return write_call_count_;
+  }
+
+  /**
+   * Takes at most |limit| bytes per write, as a socket with a full send
+   * buffer would. 0 takes everything.
+   */
+  void SetWriteLimit(size_t limit)
+  {
+    write_limit_ = limit;
+  }
+
+  /**
+   * Answers later requests with |code| instead of OK.
+   */
+  void SetResponseCode(organicdump_proto::ErrorCode code)
+  {
+    response_code_ = code;
+  }
+
+  /**
+   * Makes |id| the next id handed out, as a server that had already
+   * registered other things would.
+   */
+  void SetNextId(uint64_t id)
+  {
+    next_id_ = id;
+  }
+
+  /**
+   * Answers the |request_number|th request (counting from 1) and every one
+   * after it with |code|.
+   */
+  void FailRequestsFrom(
+      size_t request_number,
+      organicdump_proto::ErrorCode code)
+  {
+    fail_from_request_ = request_number;
+    fail_code_ = code;
+  }
+
+  /**
+   * Makes the server hang up: later reads and writes fail as closed.
+   */
+  void Close()
+  {
+    is_closed_ = true;
+  }
+
+  size_t GetFrameCount(organicdump_proto::MessageType type) const
+  {
+    return frame_counts_[type];
+  }
+
+  const std::vector<FakeServerRequest> &GetRequests() const
+  {
+    return requests_;
+  }
+
+private:
+  // Returns the id the request was answered with, or 0 if it was failed.
+  uint64_t QueueResponse()
+  {
+    ++request_count_;
+    organicdump_proto::ErrorCode code = response_code_;
+    if (fail_from_request_ > 0 && request_count_ >= fail_from_request_)
+    {
+      code = fail_code_;
+    }
+
+    uint64_t id = 0;
+    response_.Clear();
+    response_.set_code(code);
+    if (code == organicdump_proto::ErrorCode::OK)
+    {
+      id = next_id_++;
+      response_.set_id(id);
+    }
+
+    size_t body_size = response_.ByteSizeLong();
+    FrameHeader header;
+    header.type = organicdump_proto::MessageType::BASIC_RESPONSE;
+    header.size = static_cast<uint32_t>(body_size);
+
+    uint8_t *frame = response_buffer_.data() + response_size_;
+    EncodeFrameHeader(header, frame);
+    response_.SerializeWithCachedSizesToArray(frame + FRAME_HEADER_SIZE);
+    response_size_ += FRAME_HEADER_SIZE + body_size;
+    return id;
+  }
+
+  void RecordRequest(
+      const FrameHeader &header,
+      const uint8_t *body,
+      uint64_t assigned_id)
+  {
+    FakeServerRequest request{
+        static_cast<organicdump_proto::MessageType>(header.type),
+        "",
+        0,
+        0,
+        assigned_id};
+    switch (header.type)
+    {
+      case organicdump_proto::MessageType::REGISTER_RPI:
+      {
+        organicdump_proto::RegisterRpi message;
+        message.ParseFromArray(body, header.size);
+        request.name = message.name();
+        break;
+      }
+
+      case organicdump_proto::MessageType::REGISTER_SOIL_MOISTURE_SENSOR:
+      {
+        organicdump_proto::RegisterSoilMoistureSensor message;
+        message.ParseFromArray(body, header.size);
+        request.name = message.meta().name();
+        break;
+      }
+
+      case organicdump_proto::MessageType::UPDATE_PERIPHERAL_OWNERSHIP:
+      {
+        organicdump_proto::UpdatePeripheralOwnership message;
+        message.ParseFromArray(body, header.size);
+        request.peripheral_id = message.peripheral_id();
+        request.rpi_id = message.rpi_id();
+        break;
+      }
+
+      default:
+        return;
+    }
+
+    requests_.push_back(std::move(request));
+  }
+
+private:
+  std::vector<uint8_t> request_buffer_;
+  size_t request_size_;
+  size_t write_limit_;
+  bool wants_write_;
+  std::vector<uint8_t> response_buffer_;
+  size_t response_read_offset_;
+  size_t response_size_;
+  organicdump_proto::BasicResponse response_;
+  uint64_t next_id_;
+  organicdump_proto::ErrorCode response_code_;
+  size_t request_count_;
+  size_t fail_from_request_;
+  organicdump_proto::ErrorCode fail_code_;
+  std::vector<FakeServerRequest> requests_;
+  bool is_closed_;
+  size_t write_call_count_;
+  std::array<size_t, 256> frame_counts_;
+};
+
+} // namespace organicdump
+
+#endif // ORGANICDUMP_CLIENT_TESTS_FAKESERVERSTREAM_H
@@ -0,0 +1,103 @@
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "MeasurementSpool.h"
+#include "SoilMoistureMeasurement.h"
+
+namespace organicdump
+{
+namespace
+{
+
+constexpr uint64_t SPOOL_MAGIC = 0x4c4f4f5053444f;
+
+// Leading fields of the on-disk header.
+struct SpoolHeader
+{
+  uint64_t magic;
+  uint32_t version;
+};
+
+class MeasurementSpoolTest : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    path_ = ::testing::TempDir() + "measurement_spool_test.spool";
+    std::remove(path_.c_str());
+  }
+
+  void TearDown() override
+  {
+    std::remove(path_.c_str());
+  }
+
+  std::string path_;
+};
+
+TEST_F(MeasurementSpoolTest, ReopenKeepsUnacknowledgedReadings)
+{
+  auto wall_time = std::chrono::system_clock::now();
+  {
+    MeasurementSpool spool;
+    ASSERT_TRUE(MeasurementSpool::Open(path_, 8, &spool));
+    for (size_t i = 0; i < 3; ++i)
+    {
+      SoilMoistureMeasurement measurement = {};
+      measurement.sensor_id = i;
+      measurement.value = 1.5 * i;
+      measurement.wall_time = wall_time;
+      measurement.conversion_latency = std::chrono::microseconds{900};
+      ASSERT_TRUE(spool.Append(measurement));
+    }
+    spool.Ack(1);
+    ASSERT_TRUE(spool.Sync());
+  }
+
+  MeasurementSpool spool;
+  ASSERT_TRUE(MeasurementSpool::Open(path_, 8, &spool));
+  ASSERT_EQ(2u, spool.GetSize());
+
+  SoilMoistureMeasurement measurement;
+  ASSERT_TRUE(spool.Get(spool.GetHeadSeq(), &measurement));
+  EXPECT_EQ(1u, measurement.sensor_id);
+  EXPECT_EQ(1.5, measurement.value);
+  EXPECT_EQ(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          wall_time.time_since_epoch()),
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          measurement.wall_time.time_since_epoch()));
+  EXPECT_EQ(std::chrono::microseconds{900}, measurement.conversion_latency);
+}
+
+TEST_F(MeasurementSpoolTest, UnknownVersionIsRejected)
+{
+  {
+    MeasurementSpool spool;
+    ASSERT_TRUE(MeasurementSpool::Open(path_, 8, &spool));
+    ASSERT_TRUE(spool.Append(SoilMoistureMeasurement{}));
+    ASSERT_TRUE(spool.Sync());
+  }
+
+  SpoolHeader header = {SPOOL_MAGIC, 2};
+  int fd = open(path_.c_str(), O_WRONLY);
+  ASSERT_GE(fd, 0);
+  ASSERT_EQ(
+      static_cast<ssize_t>(sizeof(header)),
+      pwrite(fd, &header, sizeof(header), 0));
+  close(fd);
+
+  MeasurementSpool spool;
+  EXPECT_FALSE(MeasurementSpool::Open(path_, 8, &spool));
+}
+
+} // namespace
+} // namespace organicdump
@@ -0,0 +1,228 @@
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <json/json.h>
+
+#include "organic_dump.pb.h"
+
+#include "ByteStream.h"
+#include "Client.h"
+#include "FakeServerStream.h"
+#include "ProtobufServer.h"
+#include "Provisioner.h"
+#include "ProvisioningManifest.h"
+
+namespace organicdump
+{
+namespace
+{
+
+using organicdump_proto::ErrorCode;
+using organicdump_proto::MessageType;
+
+constexpr size_t PIPELINE_WINDOW = 4;
+constexpr size_t SENSOR_COUNT = 5;
+
+// Five probes on two ADCs: more than one window of requests.
+constexpr const char *MANIFEST = R"({
+  "rpi": {"name": "pi", "location": "shed"},
+  "adcs": [
+    {
+      "bus": 1,
+      "address": "0x48",
+      "channels": [
+        {"channel": 0, "name": "bed-0", "floor": 1000, "ceiling": 20000},
+        {"channel": 1, "name": "bed-1", "floor": 1000, "ceiling": 20000},
+        {"channel": 2, "name": "bed-2", "floor": 1000, "ceiling": 20000},
+        {"channel": 3, "name": "bed-3", "floor": 1000, "ceiling": 20000}
+      ]
+    },
+    {
+      "bus": 1,
+      "address": "0x49",
+      "channels": [
+        {"channel": 0, "name": "bed-4", "floor": 1000, "ceiling": 20000}
+      ]
+    }
+  ]
+})";
+
+Json::Value ParseJson(const std::string &text)
+{
+  Json::Value root;
+  Json::Reader reader;
+  EXPECT_TRUE(reader.parse(text, root));
+  return root;
+}
+
+class ProvisionerTest : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    ASSERT_TRUE(ProvisioningManifest::Parse(ParseJson(MANIFEST), &manifest_));
+    ASSERT_EQ(manifest_.GetSensors().size(), SENSOR_COUNT);
+    Connect();
+  }
+
+  // Starts a new session on a new server, as a re-run would.
+  void Connect()
+  {
+    server_ = new FakeServerStream;
+    client_ = Client{ProtobufServer{std::unique_ptr<ByteStream>{server_}}};
+    client_.SetPipelineWindow(PIPELINE_WINDOW);
+  }
+
+  bool Provision()
+  {
+    Provisioner provisioner{&client_};
+    return provisioner.Provision(&manifest_);
+  }
+
+  // The id the server assigned each name it was asked to register.
+  std::map<std::string, uint64_t> GetRegisteredIds() const
+  {
+    std::map<std::string, uint64_t> ids;
+    for (const FakeServerRequest &request : server_->GetRequests())
+    {
+      if (request.type == MessageType::REGISTER_RPI ||
+          request.type == MessageType::REGISTER_SOIL_MOISTURE_SENSOR)
+      {
+        EXPECT_EQ(ids.count(request.name), 0u) << request.name;
+        ids[request.name] = request.assigned_id;
+      }
+    }
+    return ids;
+  }
+
+  // Checks that every probe was handed to the Pi exactly once this session.
+  void ExpectEverySensorOwned() const
+  {
+    ASSERT_TRUE(manifest_.IsRegistered());
+
+    std::multiset<uint64_t> owned;
+    for (const FakeServerRequest &request : server_->GetRequests())
+    {
+      if (request.type == MessageType::UPDATE_PERIPHERAL_OWNERSHIP)
+      {
+        EXPECT_EQ(request.rpi_id, manifest_.GetRpiId());
+        owned.insert(request.peripheral_id);
+      }
+    }
+
+    std::multiset<uint64_t> expected_owned;
+    for (const SensorRegistration &sensor : manifest_.GetSensors())
+    {
+      expected_owned.insert(sensor.sensor_id);
+    }
+    EXPECT_EQ(owned, expected_owned);
+  }
+
+  ProvisioningManifest manifest_;
+  FakeServerStream *server_;
+  Client client_;
+};
+
+TEST_F(ProvisionerTest, ResponsesAreMatchedToTheirRequests)
+{
+  ASSERT_TRUE(Provision());
+
+  // With registrations and ownership updates interleaved in the pipeline,
+  // each id must still land on the request it answered.
+  std::map<std::string, uint64_t> ids = GetRegisteredIds();
+  ASSERT_EQ(ids.size(), SENSOR_COUNT + 1);
+  EXPECT_EQ(manifest_.GetRpiId(), ids["pi"]);
+  for (const SensorRegistration &sensor : manifest_.GetSensors())
+  {
+    EXPECT_EQ(sensor.sensor_id, ids[sensor.name]) << sensor.name;
+  }
+  ExpectEverySensorOwned();
+
+  Json::Value config;
+  ASSERT_TRUE(manifest_.BuildMonitorConfig(&config));
+  EXPECT_EQ(config["rpi-id"].asUInt64(), manifest_.GetRpiId());
+  EXPECT_EQ(
+      config["adcs"][1]["channels"][0]["sensor-id"].asUInt64(),
+      manifest_.GetSensors()[4].sensor_id);
+}
+
+TEST_F(ProvisionerTest, RegisteredIdsInTheManifestAreNotRegisteredAgain)
+{
+  Json::Value root = ParseJson(MANIFEST);
+  root["rpi-id"] = 100;
+  root["adcs"][0]["channels"][0]["sensor-id"] = 200;
+  root["adcs"][1]["channels"][0]["sensor-id"] = 204;
+  ASSERT_TRUE(ProvisioningManifest::Parse(root, &manifest_));
+  ASSERT_FALSE(manifest_.IsRegistered());
+
+  ASSERT_TRUE(Provision());
+
+  std::map<std::string, uint64_t> ids = GetRegisteredIds();
+  EXPECT_EQ(ids.size(), 3u);
+  EXPECT_EQ(ids.count("pi"), 0u);
+  EXPECT_EQ(ids.count("bed-0"), 0u);
+  EXPECT_EQ(ids.count("bed-4"), 0u);
+
+  EXPECT_EQ(manifest_.GetRpiId(), 100u);
+  EXPECT_EQ(manifest_.GetSensors()[0].sensor_id, 200u);
+  EXPECT_EQ(manifest_.GetSensors()[4].sensor_id, 204u);
+  ExpectEverySensorOwned();
+}
+
+TEST_F(ProvisionerTest, FailedRunSavesItsIdsAndResumes)
+{
+  // The Pi and the first probes get ids before the server starts failing.
+  server_->FailRequestsFrom(5, ErrorCode::SERVER_ERROR);
+  ASSERT_FALSE(Provision());
+  ASSERT_TRUE(manifest_.HasRpiId());
+  ASSERT_FALSE(manifest_.IsRegistered());
+
+  std::map<std::string, uint64_t> first_ids = GetRegisteredIds();
+  std::set<std::string> unregistered;
+  for (const SensorRegistration &sensor : manifest_.GetSensors())
+  {
+    if (sensor.is_registered)
+    {
+      EXPECT_EQ(sensor.sensor_id, first_ids[sensor.name]) << sensor.name;
+    }
+    else
+    {
+      unregistered.insert(sensor.name);
+    }
+  }
+  ASSERT_FALSE(unregistered.empty());
+  ASSERT_LT(unregistered.size(), SENSOR_COUNT);
+
+  // What the CLI writes back to the manifest file.
+  Json::Value saved;
+  manifest_.BuildManifest(&saved);
+  size_t rpi_id = manifest_.GetRpiId();
+  ASSERT_TRUE(ProvisioningManifest::Parse(saved, &manifest_));
+  EXPECT_EQ(manifest_.GetRpiId(), rpi_id);
+
+  Connect();
+  server_->SetNextId(100);
+  ASSERT_TRUE(Provision());
+
+  std::map<std::string, uint64_t> second_ids = GetRegisteredIds();
+  std::set<std::string> registered;
+  for (const auto &entry : second_ids)
+  {
+    registered.insert(entry.first);
+  }
+  EXPECT_EQ(registered, unregistered);
+  EXPECT_EQ(manifest_.GetRpiId(), rpi_id);
+  ExpectEverySensorOwned();
+
+  Json::Value config;
+  EXPECT_TRUE(manifest_.BuildMonitorConfig(&config));
+}
+
+} // namespace
+} // namespace organicdump
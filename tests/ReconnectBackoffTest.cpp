@@ -0,0 +1,139 @@
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "ClientError.h"
+#include "ReconnectBackoff.h"
+#include "ReconnectPolicy.h"
+
+namespace organicdump
+{
+namespace
+{
+
+using std::chrono::milliseconds;
+
+constexpr milliseconds BASE_DELAY{500};
+constexpr milliseconds MAX_DELAY{60000};
+constexpr size_t BREAKER_THRESHOLD = 3;
+constexpr std::chrono::seconds BREAKER_COOLDOWN{300};
+constexpr size_t DRAW_COUNT = 2000;
+
+ReconnectPolicy MakePolicy(size_t breaker_threshold)
+{
+  return ReconnectPolicy{
+      BASE_DELAY,
+      MAX_DELAY,
+      breaker_threshold,
+      BREAKER_COOLDOWN};
+}
+
+TEST(ReconnectBackoffTest, FailureDelaysGrowWithinBaseAndCap)
+{
+  ReconnectBackoff backoff{MakePolicy(0), 1};
+
+  milliseconds previous = BASE_DELAY;
+  bool reached_cap = false;
+  for (size_t i = 0; i < DRAW_COUNT; ++i)
+  {
+    milliseconds delay = backoff.OnFailure(ClientError::NETWORK);
+    ASSERT_GE(delay, BASE_DELAY);
+    ASSERT_LE(delay, std::min(3 * previous, MAX_DELAY));
+    reached_cap = reached_cap || delay == MAX_DELAY;
+    previous = delay;
+  }
+  EXPECT_TRUE(reached_cap);
+
+  // Success starts the backoff over.
+  backoff.OnSuccess();
+  EXPECT_LE(backoff.OnFailure(ClientError::NETWORK), 3 * BASE_DELAY);
+}
+
+TEST(ReconnectBackoffTest, ClientsWithDifferentSeedsDecorrelate)
+{
+  ReconnectBackoff first{MakePolicy(0), 1};
+  ReconnectBackoff second{MakePolicy(0), 2};
+
+  size_t equal_count = 0;
+  for (size_t i = 0; i < 20; ++i)
+  {
+    if (first.OnFailure(ClientError::NETWORK) ==
+        second.OnFailure(ClientError::NETWORK))
+    {
+      ++equal_count;
+    }
+  }
+  EXPECT_LT(equal_count, 5u);
+}
+
+TEST(ReconnectBackoffTest, SessionClosedReconnectsWithinTheBaseDelay)
+{
+  ReconnectBackoff backoff{MakePolicy(0), 3};
+
+  std::vector<milliseconds> delays;
+  for (size_t i = 0; i < DRAW_COUNT; ++i)
+  {
+    milliseconds delay = backoff.OnSessionClosed();
+    ASSERT_GE(delay.count(), 0);
+    ASSERT_LE(delay, BASE_DELAY);
+    delays.push_back(delay);
+  }
+
+  // Jittered, so sessions closed together don't all reconnect at once.
+  std::sort(delays.begin(), delays.end());
+  EXPECT_LT(delays[DRAW_COUNT / 10], BASE_DELAY / 5);
+  EXPECT_GT(delays[DRAW_COUNT * 9 / 10], BASE_DELAY * 4 / 5);
+
+  // A clean close doesn't grow the failure backoff.
+  EXPECT_LE(backoff.OnFailure(ClientError::NETWORK), 3 * BASE_DELAY);
+}
+
+TEST(ReconnectBackoffTest, ServerErrorsTripTheBreakerUntilSuccess)
+{
+  ReconnectBackoff backoff{MakePolicy(BREAKER_THRESHOLD), 4};
+  auto cooldown = std::chrono::duration_cast<milliseconds>(BREAKER_COOLDOWN);
+
+  for (size_t i = 1; i < BREAKER_THRESHOLD; ++i)
+  {
+    EXPECT_LT(backoff.OnFailure(ClientError::SERVER), cooldown);
+    EXPECT_FALSE(backoff.IsBreakerOpen());
+  }
+
+  milliseconds delay = backoff.OnFailure(ClientError::SERVER);
+  EXPECT_TRUE(backoff.IsBreakerOpen());
+  EXPECT_GE(delay, cooldown);
+  EXPECT_LE(delay, cooldown + MAX_DELAY);
+  EXPECT_EQ(backoff.GetBreakerTripCount(), 1u);
+
+  // A failed trial connection holds off again without counting a new trip.
+  delay = backoff.OnFailure(ClientError::SERVER);
+  EXPECT_TRUE(backoff.IsBreakerOpen());
+  EXPECT_GE(delay, cooldown);
+  EXPECT_EQ(backoff.GetBreakerTripCount(), 1u);
+
+  // The network failing doesn't show the server is healthy again.
+  backoff.OnFailure(ClientError::NETWORK);
+  EXPECT_TRUE(backoff.IsBreakerOpen());
+
+  backoff.OnSuccess();
+  EXPECT_FALSE(backoff.IsBreakerOpen());
+  EXPECT_LT(backoff.OnFailure(ClientError::SERVER), cooldown);
+  EXPECT_EQ(backoff.GetBreakerTripCount(), 1u);
+}
+
+TEST(ReconnectBackoffTest, ZeroThresholdDisablesTheBreaker)
+{
+  ReconnectBackoff backoff{MakePolicy(0), 5};
+  for (size_t i = 0; i < 10 * BREAKER_THRESHOLD; ++i)
+  {
+    EXPECT_LE(backoff.OnFailure(ClientError::SERVER), MAX_DELAY);
+  }
+  EXPECT_FALSE(backoff.IsBreakerOpen());
+  EXPECT_EQ(backoff.GetBreakerTripCount(), 0u);
+}
+
+} // namespace
+} // namespace organicdump
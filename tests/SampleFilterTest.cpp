@@ -0,0 +1,52 @@
+#include <cstddef>
+#include <cstdint>
+
+#include <gtest/gtest.h>
+
+#include "OversamplingPolicy.h"
+#include "SampleFilter.h"
+
+namespace organicdump
+{
+namespace
+{
+
+OversamplingPolicy MakePolicy(SampleFilterType filter)
+{
+  return OversamplingPolicy{4, filter, 0.25, 0.5};
+}
+
+TEST(SampleFilterTest, MeanMedianAndTrimmedMean)
+{
+  const uint16_t samples[] = {10, 40, 20, 1000};
+
+  SampleFilter mean{MakePolicy(SampleFilterType::MEAN)};
+  EXPECT_DOUBLE_EQ(267.5, mean.Apply(1, samples, 4));
+
+  SampleFilter median{MakePolicy(SampleFilterType::MEDIAN)};
+  EXPECT_DOUBLE_EQ(30, median.Apply(1, samples, 4));
+  EXPECT_DOUBLE_EQ(20, median.Apply(1, samples, 3));
+
+  SampleFilter trimmed_mean{MakePolicy(SampleFilterType::TRIMMED_MEAN)};
+  EXPECT_DOUBLE_EQ(30, trimmed_mean.Apply(1, samples, 4));
+}
+
+TEST(SampleFilterTest, EwmaSeedsFromFirstConversionOnce)
+{
+  SampleFilter filter{MakePolicy(SampleFilterType::EWMA)};
+
+  // Seeded with 100, then 200 moves it halfway.
+  const uint16_t first[] = {100, 200};
+  EXPECT_DOUBLE_EQ(150, filter.Apply(1, first, 2));
+
+  // Later bursts fold in every conversion.
+  const uint16_t second[] = {250};
+  EXPECT_DOUBLE_EQ(200, filter.Apply(1, second, 1));
+
+  // Each sensor has its own average.
+  const uint16_t other[] = {8};
+  EXPECT_DOUBLE_EQ(8, filter.Apply(2, other, 1));
+}
+
+} // namespace
+} // namespace organicdump
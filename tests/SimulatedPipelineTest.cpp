@@ -0,0 +1,188 @@
+#include <poll.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "organic_dump.pb.h"
+
+#include "AdaptiveSamplingPolicy.h"
+#include "Ads1115Policy.h"
+#include "Ads1115Registers.h"
+#include "BusRecoveryPolicy.h"
+#include "ByteStream.h"
+#include "ChannelFaultPolicy.h"
+#include "Client.h"
+#include "ClientError.h"
+#include "FakeServerStream.h"
+#include "MeasurementSpool.h"
+#include "OversamplingPolicy.h"
+#include "ProtobufServer.h"
+#include "SensorTopology.h"
+#include "SimulatedHardwareBackend.h"
+#include "SimulationProfile.h"
+#include "SoilMoistureMeasurement.h"
+#include "SoilMoistureSampler.h"
+#include "SpscRingBuffer.h"
+#include "UploadTracker.h"
+
+namespace organicdump
+{
+namespace
+{
+
+using I2c::Ads1115Channel;
+using organicdump_proto::MessageType;
+
+constexpr int BUS = 1;
+constexpr double BASE_VALUE = 12000;
+constexpr double AMPLITUDE = 4000;
+constexpr double PI = 3.14159265358979323846;
+constexpr size_t PIPELINE_WINDOW = 4;
+constexpr int SWEEP_TIMEOUT_MS = 5000;
+
+// A frozen sine: with the clock scaled to zero, every input holds the value
+// of its own phase slot, so each sensor reads something different and any
+// mislabelled reading shows.
+SimulationProfile MakeFrozenProfile()
+{
+  return SimulationProfile{
+      SimulatedWaveform::SINE,
+      BASE_VALUE,
+      AMPLITUDE,
+      std::chrono::seconds{60},
+      0,
+      0,
+      std::chrono::microseconds{0},
+      0,
+      1};
+}
+
+double GetFrozenValue(uint8_t address, Ads1115Channel channel)
+{
+  size_t slot = (address - 0x48) * 4 + static_cast<size_t>(channel);
+  return std::lround(
+      BASE_VALUE + AMPLITUDE * std::sin(2 * PI * (slot % 16) / 16.0));
+}
+
+SensorChannel MakeChannel(
+    uint8_t address,
+    Ads1115Channel channel,
+    size_t sensor_id)
+{
+  return SensorChannel{
+      BUS,
+      address,
+      channel,
+      sensor_id,
+      std::chrono::milliseconds{0},
+      std::chrono::milliseconds{0}};
+}
+
+// The daemon's path for one bus, minus the event loop and TLS: a sampler on
+// the simulated backend feeds the spool, and the live session's bookkeeping
+// uploads from it to an in-memory server.
+TEST(SimulatedPipelineTest, UploadsOneCorrectlyLabelledReadingPerSensor)
+{
+  SensorTopology topology{std::vector<SensorChannel>{
+      MakeChannel(0x48, Ads1115Channel::CHANNEL_0, 10),
+      MakeChannel(0x48, Ads1115Channel::CHANNEL_2, 12),
+      MakeChannel(0x49, Ads1115Channel::CHANNEL_1, 21),
+      MakeChannel(0x4a, Ads1115Channel::CHANNEL_3, 33)}};
+  SimulatedHardwareBackend backend{MakeFrozenProfile(), topology};
+
+  I2cBus *bus = backend.OpenBus(BUS);
+  ASSERT_NE(bus, nullptr);
+
+  SpscRingBuffer<SoilMoistureMeasurement> ring{64};
+  SoilMoistureSampler sampler{
+      bus,
+      backend.GetConversionTime(),
+      Ads1115Policy{
+          ads1115::DEFAULT_FULL_SCALE_MV,
+          ads1115::DEFAULT_DATA_RATE_SPS},
+      topology.GetBusChannels(BUS),
+      std::chrono::seconds{60},
+      AdaptiveSamplingPolicy{
+          std::chrono::seconds{60},
+          std::chrono::seconds{60},
+          1.0},
+      OversamplingPolicy{3, SampleFilterType::MEDIAN, 0, 0.5},
+      ChannelFaultPolicy{
+          std::chrono::milliseconds{100},
+          1,
+          0,
+          std::chrono::seconds{1},
+          std::chrono::seconds{1}},
+      BusRecoveryPolicy{0, std::chrono::seconds{1}, std::chrono::seconds{1}},
+      &ring};
+
+  // Every channel is due at start, so the first sweep reads them all.
+  ASSERT_TRUE(sampler.Start());
+  struct pollfd poll_fd = {};
+  poll_fd.fd = sampler.GetNotifyFd();
+  poll_fd.events = POLLIN;
+  ASSERT_EQ(poll(&poll_fd, 1, SWEEP_TIMEOUT_MS), 1);
+  sampler.Stop();
+  sampler.ConsumeNotification();
+
+  MeasurementSpool spool;
+  ASSERT_TRUE(MeasurementSpool::Open("", 64, &spool));
+  SoilMoistureMeasurement measurement;
+  while (ring.TryPop(&measurement))
+  {
+    ASSERT_TRUE(spool.Append(measurement));
+  }
+  ASSERT_EQ(spool.GetSize(), topology.GetChannels().size());
+
+  FakeServerStream *server = new FakeServerStream;
+  Client client{ProtobufServer{std::unique_ptr<ByteStream>{server}}};
+  client.SetPipelineWindow(PIPELINE_WINDOW);
+  UploadTracker tracker{&spool};
+
+  std::map<size_t, double> uploaded;
+  while (tracker.HasUnposted() || client.GetPendingRequestCount() > 0)
+  {
+    while (tracker.HasUnposted() && client.CanPostRequest())
+    {
+      spool.Get(tracker.GetNextSeq(), &measurement);
+      ASSERT_TRUE(client.PostSoilMoistureMeasurement(measurement));
+      uploaded[measurement.sensor_id] = measurement.value;
+      tracker.MarkPosted();
+    }
+    ASSERT_TRUE(client.Flush());
+
+    while (client.GetPendingRequestCount() > 0)
+    {
+      size_t id = 0;
+      bool completed = false;
+      ClientError error;
+      ASSERT_TRUE(client.TryCompleteRequest(&id, &completed, &error));
+      ASSERT_TRUE(completed);
+      ASSERT_EQ(error, ClientError::NONE);
+      ASSERT_TRUE(tracker.Complete(tracker.PopInFlight()));
+    }
+  }
+
+  EXPECT_EQ(spool.GetSize(), 0u);
+  EXPECT_EQ(
+      server->GetFrameCount(MessageType::SEND_SOIL_MOISTURE_MEASUREMENT),
+      topology.GetChannels().size());
+  ASSERT_EQ(uploaded.size(), topology.GetChannels().size());
+  for (const SensorChannel &channel : topology.GetChannels())
+  {
+    EXPECT_EQ(
+        uploaded[channel.sensor_id],
+        GetFrozenValue(channel.address, channel.channel))
+        << "sensor " << channel.sensor_id;
+  }
+}
+
+} // namespace
+} // namespace organicdump
@@ -0,0 +1,301 @@
+#include <poll.h>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "AdaptiveSamplingPolicy.h"
+#include "Ads1115Policy.h"
+#include "Ads1115Registers.h"
+#include "BusRecoveryPolicy.h"
+#include "ChannelFaultPolicy.h"
+#include "OversamplingPolicy.h"
+#include "SensorTopology.h"
+#include "SimulatedI2cBus.h"
+#include "SoilMoistureMeasurement.h"
+#include "SoilMoistureSampler.h"
+#include "SpscRingBuffer.h"
+
+namespace organicdump
+{
+namespace
+{
+
+using I2c::Ads1115Channel;
+
+constexpr int BUS = 1;
+constexpr uint8_t HEALTHY_ADDRESS = 0x48;
+constexpr uint8_t FAILING_ADDRESS = 0x49;
+constexpr size_t HEALTHY_SENSOR_ID = 1;
+constexpr size_t FAILING_SENSOR_ID = 2;
+constexpr uint16_t HEALTHY_VALUE = 1000;
+constexpr uint16_t FAILING_VALUE = 2000;
+
+// Each channel keeps its own period while sampling is fixed, so the sweeps
+// can run far faster than the daemon's whole-second periods.
+constexpr std::chrono::milliseconds CHANNEL_PERIOD{20};
+constexpr size_t SAMPLE_COUNT = 2;
+constexpr size_t RETRY_COUNT = 1;
+constexpr size_t QUARANTINE_THRESHOLD = 3;
+constexpr int RECOVERY_TIMEOUT_MS = 2000;
+
+class SoilMoistureSamplerTest : public ::testing::Test
+{
+protected:
+  SoilMoistureSamplerTest()
+    : ring_{1024}
+  {
+    bus_.AddAds1115(HEALTHY_ADDRESS);
+    bus_.AddAds1115(FAILING_ADDRESS);
+    bus_.SetChannelValue(HEALTHY_ADDRESS, Ads1115Channel::CHANNEL_0, HEALTHY_VALUE);
+    bus_.SetChannelValue(FAILING_ADDRESS, Ads1115Channel::CHANNEL_0, FAILING_VALUE);
+  }
+
+  void CreateSampler(
+      ChannelFaultPolicy fault_policy,
+      BusRecoveryPolicy bus_recovery_policy)
+  {
+    std::vector<SensorChannel> channels = {
+        SensorChannel{
+            BUS,
+            HEALTHY_ADDRESS,
+            Ads1115Channel::CHANNEL_0,
+            HEALTHY_SENSOR_ID,
+            CHANNEL_PERIOD,
+            std::chrono::milliseconds{0}},
+        SensorChannel{
+            BUS,
+            FAILING_ADDRESS,
+            Ads1115Channel::CHANNEL_0,
+            FAILING_SENSOR_ID,
+            CHANNEL_PERIOD,
+            std::chrono::milliseconds{0}}};
+
+    sampler_.reset(
+        new SoilMoistureSampler{
+            &bus_,
+            std::chrono::microseconds{0},
+            Ads1115Policy{
+                ads1115::DEFAULT_FULL_SCALE_MV,
+                ads1115::DEFAULT_DATA_RATE_SPS},
+            channels,
+            std::chrono::seconds{60},
+            AdaptiveSamplingPolicy{
+                std::chrono::seconds{60},
+                std::chrono::seconds{60},
+                1.0},
+            OversamplingPolicy{SAMPLE_COUNT, SampleFilterType::MEAN, 0, 0.5},
+            fault_policy,
+            bus_recovery_policy,
+            &ring_});
+  }
+
+  // Runs the sampler thread for |duration|. The simulated bus isn't thread
+  // safe, so faults are only injected while the sampler is stopped.
+  void RunFor(std::chrono::milliseconds duration)
+  {
+    ASSERT_TRUE(sampler_->Start());
+    std::this_thread::sleep_for(duration);
+    sampler_->Stop();
+  }
+
+  // Runs the sampler until a reading for |sensor_id| arrives.
+  bool RunUntilReading(size_t sensor_id)
+  {
+    if (!sampler_->Start())
+    {
+      return false;
+    }
+
+    bool found = false;
+    auto deadline = std::chrono::steady_clock::now() +
+                    std::chrono::milliseconds{RECOVERY_TIMEOUT_MS};
+    while (!found && std::chrono::steady_clock::now() < deadline)
+    {
+      struct pollfd poll_fd = {};
+      poll_fd.fd = sampler_->GetNotifyFd();
+      poll_fd.events = POLLIN;
+      if (poll(&poll_fd, 1, RECOVERY_TIMEOUT_MS) != 1)
+      {
+        break;
+      }
+      sampler_->ConsumeNotification();
+
+      SoilMoistureMeasurement measurement;
+      while (ring_.TryPop(&measurement))
+      {
+        ++reading_counts_[measurement.sensor_id];
+        found = found || measurement.sensor_id == sensor_id;
+      }
+    }
+
+    sampler_->Stop();
+    DrainReadings();
+    return found;
+  }
+
+  void DrainReadings()
+  {
+    SoilMoistureMeasurement measurement;
+    while (ring_.TryPop(&measurement))
+    {
+      ++reading_counts_[measurement.sensor_id];
+      EXPECT_EQ(
+          measurement.value,
+          measurement.sensor_id == HEALTHY_SENSOR_ID ?
+              HEALTHY_VALUE : FAILING_VALUE);
+    }
+  }
+
+  SimulatedI2cBus bus_;
+  SpscRingBuffer<SoilMoistureMeasurement> ring_;
+  std::unique_ptr<SoilMoistureSampler> sampler_;
+  std::map<size_t, size_t> reading_counts_;
+};
+
+TEST_F(SoilMoistureSamplerTest, FailingChannelIsQuarantinedAndProbedWithBackoff)
+{
+  CreateSampler(
+      ChannelFaultPolicy{
+          std::chrono::milliseconds{100},
+          RETRY_COUNT,
+          QUARANTINE_THRESHOLD,
+          std::chrono::seconds{1},
+          std::chrono::seconds{4}},
+      BusRecoveryPolicy{0, std::chrono::seconds{1}, std::chrono::seconds{1}});
+  bus_.SetDeviceFailed(FAILING_ADDRESS, true);
+
+  // Quarantined after its third failed sweep at about 40 ms, probed once at
+  // about 1 s, which fails and doubles the wait past the end of the run.
+  RunFor(std::chrono::milliseconds{2500});
+  DrainReadings();
+
+  EXPECT_EQ(sampler_->GetQuarantinedCount(), 1u);
+  // A conversion that still fails after its retries counts once.
+  EXPECT_EQ(
+      sampler_->GetFailedReadCount(),
+      (QUARANTINE_THRESHOLD + 1) * SAMPLE_COUNT);
+
+  // The healthy channel kept its own cadence throughout.
+  EXPECT_EQ(reading_counts_[FAILING_SENSOR_ID], 0u);
+  EXPECT_GE(reading_counts_[HEALTHY_SENSOR_ID], 2500 / CHANNEL_PERIOD.count() / 2);
+}
+
+TEST_F(SoilMoistureSamplerTest, RecoveredChannelLeavesQuarantine)
+{
+  CreateSampler(
+      ChannelFaultPolicy{
+          std::chrono::milliseconds{100},
+          RETRY_COUNT,
+          QUARANTINE_THRESHOLD,
+          std::chrono::seconds{60},
+          std::chrono::seconds{60}},
+      BusRecoveryPolicy{0, std::chrono::seconds{1}, std::chrono::seconds{1}});
+  bus_.SetDeviceFailed(FAILING_ADDRESS, true);
+  RunFor(std::chrono::milliseconds{200});
+  ASSERT_EQ(sampler_->GetQuarantinedCount(), 1u);
+  size_t failed_reads = sampler_->GetFailedReadCount();
+
+  // A restarted sampler probes every channel at once, quarantined or not.
+  bus_.SetDeviceFailed(FAILING_ADDRESS, false);
+  ASSERT_TRUE(RunUntilReading(FAILING_SENSOR_ID));
+  EXPECT_EQ(sampler_->GetQuarantinedCount(), 0u);
+  EXPECT_EQ(sampler_->GetFailedReadCount(), failed_reads);
+}
+
+TEST_F(SoilMoistureSamplerTest, NextDueTracksTheEarliestChannel)
+{
+  CreateSampler(
+      ChannelFaultPolicy{
+          std::chrono::milliseconds{100},
+          RETRY_COUNT,
+          QUARANTINE_THRESHOLD,
+          std::chrono::seconds{60},
+          std::chrono::seconds{60}},
+      BusRecoveryPolicy{0, std::chrono::seconds{1}, std::chrono::seconds{1}});
+  bus_.SetDeviceFailed(FAILING_ADDRESS, true);
+
+  // The quarantined channel isn't due for a minute, but the healthy one
+  // still is within its own period.
+  auto start_time = std::chrono::steady_clock::now();
+  RunFor(std::chrono::milliseconds{200});
+  ASSERT_EQ(sampler_->GetQuarantinedCount(), 1u);
+
+  auto next_due = sampler_->GetNextDue();
+  EXPECT_GT(next_due, start_time);
+  EXPECT_LE(next_due, std::chrono::steady_clock::now() + CHANNEL_PERIOD);
+}
+
+TEST_F(SoilMoistureSamplerTest, WedgedBusIsReopenedAndQuarantinedChannelsProbed)
+{
+  CreateSampler(
+      ChannelFaultPolicy{
+          std::chrono::milliseconds{100},
+          RETRY_COUNT,
+          1,
+          std::chrono::seconds{60},
+          std::chrono::seconds{60}},
+      BusRecoveryPolicy{3, std::chrono::seconds{1}, std::chrono::seconds{1}});
+  bus_.SetWedged(true);
+
+  // One failed read would quarantine a channel for 60 s, but sweeps in which
+  // nothing reads are the bus's fault. The bus is reopened after three and
+  // every channel reads again at once.
+  ASSERT_TRUE(RunUntilReading(FAILING_SENSOR_ID));
+  EXPECT_EQ(sampler_->GetBusReopenCount(), 1u);
+  EXPECT_EQ(bus_.GetReopenCount(), 1u);
+  EXPECT_EQ(sampler_->GetQuarantinedCount(), 0u);
+  EXPECT_GT(reading_counts_[HEALTHY_SENSOR_ID], 0u);
+}
+
+TEST_F(SoilMoistureSamplerTest, OneBadProbeDoesNotReopenTheBus)
+{
+  CreateSampler(
+      ChannelFaultPolicy{
+          std::chrono::milliseconds{100},
+          RETRY_COUNT,
+          0,
+          std::chrono::seconds{1},
+          std::chrono::seconds{1}},
+      BusRecoveryPolicy{3, std::chrono::seconds{1}, std::chrono::seconds{1}});
+  bus_.SetDeviceFailed(FAILING_ADDRESS, true);
+
+  RunFor(std::chrono::milliseconds{300});
+  DrainReadings();
+
+  EXPECT_EQ(sampler_->GetBusReopenCount(), 0u);
+  EXPECT_EQ(bus_.GetReopenCount(), 0u);
+  EXPECT_GT(reading_counts_[HEALTHY_SENSOR_ID], 0u);
+}
+
+TEST_F(SoilMoistureSamplerTest, DeadBusReopensWithBackoff)
+{
+  CreateSampler(
+      ChannelFaultPolicy{
+          std::chrono::milliseconds{100},
+          RETRY_COUNT,
+          0,
+          std::chrono::seconds{1},
+          std::chrono::seconds{1}},
+      BusRecoveryPolicy{3, std::chrono::seconds{1}, std::chrono::seconds{4}});
+  bus_.SetDeviceFailed(HEALTHY_ADDRESS, true);
+  bus_.SetDeviceFailed(FAILING_ADDRESS, true);
+
+  // Reopened after the third dead sweep at about 40 ms, again 1 s later,
+  // and then not for another 2 s, past the end of the run.
+  RunFor(std::chrono::milliseconds{2500});
+  DrainReadings();
+
+  EXPECT_EQ(sampler_->GetBusReopenCount(), 2u);
+  EXPECT_EQ(bus_.GetReopenCount(), 2u);
+  EXPECT_TRUE(reading_counts_.empty());
+}
+
+} // namespace
+} // namespace organicdump
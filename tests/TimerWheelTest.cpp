@@ -0,0 +1,194 @@
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <random>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "TimerWheel.h"
+
+namespace organicdump
+{
+namespace
+{
+
+using Clock = std::chrono::steady_clock;
+
+constexpr std::chrono::milliseconds RESOLUTION{1};
+
+class TimerWheelTest : public ::testing::Test
+{
+protected:
+  TimerWheelTest()
+    : origin_{Clock::now()} {}
+
+  Clock::time_point At(Clock::duration offset) const
+  {
+    return origin_ + offset;
+  }
+
+  std::vector<size_t> AdvanceTo(TimerWheel *wheel, Clock::duration offset)
+  {
+    std::vector<size_t> expired;
+    wheel->Advance(At(offset), &expired);
+    std::sort(expired.begin(), expired.end());
+    return expired;
+  }
+
+  Clock::time_point origin_;
+};
+
+TEST_F(TimerWheelTest, FiresOnTheFirstTickAtOrAfterTheDeadline)
+{
+  TimerWheel wheel{2, RESOLUTION, origin_};
+  wheel.Schedule(0, At(std::chrono::microseconds{2500}));
+  wheel.Schedule(1, At(std::chrono::milliseconds{2}));
+
+  EXPECT_TRUE(AdvanceTo(&wheel, std::chrono::microseconds{1999}).empty());
+  EXPECT_EQ(AdvanceTo(&wheel, std::chrono::milliseconds{2}), std::vector<size_t>{1});
+  EXPECT_TRUE(AdvanceTo(&wheel, std::chrono::microseconds{2999}).empty());
+  EXPECT_EQ(AdvanceTo(&wheel, std::chrono::milliseconds{3}), std::vector<size_t>{0});
+  EXPECT_FALSE(wheel.IsScheduled(0));
+  EXPECT_FALSE(wheel.IsScheduled(1));
+
+  Clock::time_point wakeup;
+  EXPECT_FALSE(wheel.GetNextWakeup(&wakeup));
+}
+
+TEST_F(TimerWheelTest, CancelAndRescheduleReplaceTheDeadline)
+{
+  TimerWheel wheel{3, RESOLUTION, origin_};
+  wheel.Schedule(0, At(std::chrono::milliseconds{10}));
+  wheel.Schedule(1, At(std::chrono::milliseconds{10}));
+  wheel.Schedule(2, At(std::chrono::milliseconds{10}));
+  wheel.Cancel(1);
+  wheel.Schedule(2, At(std::chrono::milliseconds{500}));
+
+  EXPECT_EQ(AdvanceTo(&wheel, std::chrono::milliseconds{10}), std::vector<size_t>{0});
+  EXPECT_FALSE(wheel.IsScheduled(1));
+  EXPECT_TRUE(wheel.IsScheduled(2));
+  EXPECT_TRUE(AdvanceTo(&wheel, std::chrono::milliseconds{499}).empty());
+  EXPECT_EQ(AdvanceTo(&wheel, std::chrono::milliseconds{500}), std::vector<size_t>{2});
+}
+
+TEST_F(TimerWheelTest, TimersCascadeDownToTheirExactTick)
+{
+  // One deadline per level of the wheel, each off a slot boundary so that a
+  // timer fired at its slot's start rather than its own tick would show.
+  const std::vector<Clock::duration> deadlines = {
+      std::chrono::milliseconds{37},
+      std::chrono::milliseconds{64 * 5 + 3},
+      std::chrono::milliseconds{64 * 64 * 3 + 64 * 7 + 11},
+      std::chrono::milliseconds{64 * 64 * 64 * 2 + 5},
+      std::chrono::milliseconds{64ll * 64 * 64 * 64 + 1}};
+
+  TimerWheel wheel{deadlines.size(), RESOLUTION, origin_};
+  for (size_t i = 0; i < deadlines.size(); ++i)
+  {
+    wheel.Schedule(i, At(deadlines[i]));
+  }
+
+  for (size_t i = 0; i < deadlines.size(); ++i)
+  {
+    Clock::time_point wakeup;
+    ASSERT_TRUE(wheel.GetNextWakeup(&wakeup));
+    EXPECT_LE(wakeup, At(deadlines[i]));
+
+    EXPECT_TRUE(AdvanceTo(&wheel, deadlines[i] - RESOLUTION).empty())
+        << "timer " << i << " fired early";
+    EXPECT_EQ(AdvanceTo(&wheel, deadlines[i]), std::vector<size_t>{i});
+  }
+}
+
+TEST_F(TimerWheelTest, DeadlineBeyondTheHorizonFiresEarly)
+{
+  TimerWheel wheel{1, RESOLUTION, origin_};
+  auto horizon = RESOLUTION * (int64_t{1} << 36);
+  wheel.Schedule(0, At(horizon * 2));
+
+  EXPECT_TRUE(AdvanceTo(&wheel, horizon - 2 * RESOLUTION).empty());
+  EXPECT_EQ(AdvanceTo(&wheel, horizon), std::vector<size_t>{0});
+}
+
+// Random schedules, cancels and advances against a brute-force model: every
+// timer must fire on the first advance that reaches its rounded-up tick, and
+// the wakeup must never be later than the earliest deadline.
+TEST_F(TimerWheelTest, MatchesReferenceModelUnderRandomOperations)
+{
+  constexpr size_t TIMER_COUNT = 64;
+  constexpr size_t STEP_COUNT = 20000;
+
+  TimerWheel wheel{TIMER_COUNT, RESOLUTION, origin_};
+  std::map<size_t, int64_t> model;
+  std::mt19937 random{7};
+  std::uniform_int_distribution<size_t> pick_timer{0, TIMER_COUNT - 1};
+  std::uniform_int_distribution<int> pick_action{0, 9};
+  // Mostly near deadlines, with some reaching up the levels.
+  std::uniform_int_distribution<int> pick_level{0, 3};
+  std::uniform_int_distribution<int64_t> pick_step{0, 3000};
+
+  int64_t now_us = 0;
+  for (size_t step = 0; step < STEP_COUNT; ++step)
+  {
+    int action = pick_action(random);
+    size_t timer = pick_timer(random);
+    if (action < 5)
+    {
+      int64_t span_ms = int64_t{1} << (6 * pick_level(random) + 2);
+      int64_t offset_us =
+          std::uniform_int_distribution<int64_t>{0, span_ms * 1000}(random);
+      int64_t deadline_us = now_us + offset_us;
+      wheel.Schedule(timer, At(std::chrono::microseconds{deadline_us}));
+      model[timer] = std::max<int64_t>((deadline_us + 999) / 1000, now_us / 1000);
+    }
+    else if (action < 6)
+    {
+      wheel.Cancel(timer);
+      model.erase(timer);
+    }
+    else
+    {
+      now_us += pick_step(random);
+      std::vector<size_t> expired =
+          AdvanceTo(&wheel, std::chrono::microseconds{now_us});
+
+      std::vector<size_t> expected;
+      for (auto entry = model.begin(); entry != model.end();)
+      {
+        if (entry->second <= now_us / 1000)
+        {
+          expected.push_back(entry->first);
+          entry = model.erase(entry);
+        }
+        else
+        {
+          ++entry;
+        }
+      }
+      ASSERT_EQ(expired, expected) << "at step " << step;
+    }
+
+    for (size_t i = 0; i < TIMER_COUNT; ++i)
+    {
+      ASSERT_EQ(wheel.IsScheduled(i), model.count(i) == 1);
+    }
+
+    Clock::time_point wakeup;
+    ASSERT_EQ(wheel.GetNextWakeup(&wakeup), !model.empty());
+    if (!model.empty())
+    {
+      int64_t earliest = model.begin()->second;
+      for (const auto &entry : model)
+      {
+        earliest = std::min(earliest, entry.second);
+      }
+      ASSERT_LE(wakeup, At(RESOLUTION * earliest)) << "at step " << step;
+    }
+  }
+}
+
+} // namespace
+} // namespace organicdump
@@ -0,0 +1,171 @@
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "MeasurementSpool.h"
+#include "SoilMoistureMeasurement.h"
+#include "UploadTracker.h"
+
+namespace organicdump
+{
+namespace
+{
+
+constexpr size_t SPOOL_CAPACITY = 64;
+constexpr size_t BACKLOG_THRESHOLD = 4;
+
+class UploadTrackerTest : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    ASSERT_TRUE(MeasurementSpool::Open("", SPOOL_CAPACITY, &spool_));
+    first_seq_ = spool_.GetHeadSeq();
+  }
+
+  // The seq of the |index|th reading appended.
+  uint64_t Seq(uint64_t index) const
+  {
+    return first_seq_ + index;
+  }
+
+  std::vector<uint64_t> Seqs(std::initializer_list<uint64_t> indices) const
+  {
+    std::vector<uint64_t> seqs;
+    for (uint64_t index : indices)
+    {
+      seqs.push_back(Seq(index));
+    }
+    return seqs;
+  }
+
+  void AppendReadings(size_t count)
+  {
+    for (size_t i = 0; i < count; ++i)
+    {
+      SoilMoistureMeasurement measurement = {};
+      measurement.sensor_id = 1;
+      measurement.value = static_cast<double>(spool_.GetTailSeq());
+      ASSERT_TRUE(spool_.Append(measurement));
+    }
+  }
+
+  // Posts everything the live cursor has and returns the seqs, in order.
+  std::vector<uint64_t> PostAll(UploadTracker *tracker)
+  {
+    std::vector<uint64_t> posted;
+    while (tracker->HasUnposted())
+    {
+      posted.push_back(tracker->GetNextSeq());
+      tracker->MarkPosted();
+    }
+    return posted;
+  }
+
+  MeasurementSpool spool_;
+  uint64_t first_seq_;
+};
+
+TEST_F(UploadTrackerTest, InOrderCompletionsReleaseTheSpool)
+{
+  AppendReadings(3);
+  UploadTracker tracker{&spool_};
+
+  EXPECT_EQ(Seqs({0, 1, 2}), PostAll(&tracker));
+  while (tracker.GetInFlightCount() > 0)
+  {
+    EXPECT_TRUE(tracker.Complete(tracker.PopInFlight()));
+  }
+
+  EXPECT_EQ(Seq(3), spool_.GetHeadSeq());
+  EXPECT_EQ(0u, spool_.GetSize());
+}
+
+TEST_F(UploadTrackerTest, BacklogIsNotHandedOffWhileRequestsAreInFlight)
+{
+  AppendReadings(2);
+  UploadTracker tracker{&spool_};
+  PostAll(&tracker);
+
+  // A backlog builds up behind the two live requests.
+  AppendReadings(10);
+  EXPECT_FALSE(tracker.CanHandOffBacklog(BACKLOG_THRESHOLD));
+
+  // The live session fails. Its requests go back in front of the backlog,
+  // and the next session hands the whole lot over.
+  tracker.RewindInFlight();
+  EXPECT_EQ(Seq(0), tracker.GetNextSeq());
+  ASSERT_TRUE(tracker.CanHandOffBacklog(BACKLOG_THRESHOLD));
+  tracker.HandOffBacklog();
+  EXPECT_FALSE(tracker.HasUnposted());
+}
+
+TEST_F(UploadTrackerTest, LiveFailureAfterHandOffDoesNotReplayTheDrainRange)
+{
+  AppendReadings(10);
+  UploadTracker tracker{&spool_};
+
+  // Session connects with an empty pipeline and hands the backlog over.
+  ASSERT_TRUE(tracker.CanHandOffBacklog(BACKLOG_THRESHOLD));
+  uint64_t drain_begin = tracker.GetNextSeq();
+  uint64_t drain_end = spool_.GetTailSeq();
+  tracker.HandOffBacklog();
+
+  // New readings go out live, then the live session drops.
+  AppendReadings(3);
+  EXPECT_EQ(Seqs({10, 11, 12}), PostAll(&tracker));
+  tracker.RewindInFlight();
+
+  // Only the live readings are posted again, never the drainer's.
+  std::vector<uint64_t> reposted = PostAll(&tracker);
+  EXPECT_EQ(Seqs({10, 11, 12}), reposted);
+  for (uint64_t seq : reposted)
+  {
+    EXPECT_FALSE(seq >= drain_begin && seq < drain_end);
+  }
+}
+
+TEST_F(UploadTrackerTest, InterleavedDrainAndLiveCompletionsReleaseEverything)
+{
+  AppendReadings(10);
+  UploadTracker tracker{&spool_};
+  tracker.HandOffBacklog();
+
+  AppendReadings(2);
+  PostAll(&tracker);
+
+  // Live responses arrive before the drainer's.
+  EXPECT_TRUE(tracker.Complete(tracker.PopInFlight()));
+  EXPECT_TRUE(tracker.Complete(tracker.PopInFlight()));
+  EXPECT_EQ(Seq(0), spool_.GetHeadSeq());
+
+  // Drain sessions finish out of order, and one that failed after the
+  // server answered uploads a reading a second time.
+  for (uint64_t seq : Seqs({5, 6, 7, 8, 9, 0, 1, 2}))
+  {
+    EXPECT_TRUE(tracker.Complete(seq));
+  }
+  EXPECT_EQ(Seq(3), spool_.GetHeadSeq());
+  EXPECT_FALSE(tracker.Complete(Seq(1)));
+  EXPECT_FALSE(tracker.Complete(Seq(6)));
+  EXPECT_TRUE(tracker.Complete(Seq(3)));
+  EXPECT_TRUE(tracker.Complete(Seq(4)));
+
+  EXPECT_EQ(Seq(12), spool_.GetHeadSeq());
+  EXPECT_EQ(0u, tracker.GetPendingCompletionCount());
+
+  // A late duplicate below the head neither sticks nor blocks later
+  // releases.
+  EXPECT_FALSE(tracker.Complete(Seq(2)));
+  EXPECT_EQ(0u, tracker.GetPendingCompletionCount());
+  AppendReadings(1);
+  PostAll(&tracker);
+  EXPECT_TRUE(tracker.Complete(tracker.PopInFlight()));
+  EXPECT_EQ(Seq(13), spool_.GetHeadSeq());
+}
+
+} // namespace
+} // namespace organicdump